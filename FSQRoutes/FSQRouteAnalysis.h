@@ -0,0 +1,87 @@
+//
+//  FSQRouteAnalysis.h
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The Route Analysis class describes one route of a route map, as found by analyzing the compiled map: whether any
+ url can ever be routed to it, and how much work matching a url against it takes.
+
+ Analyses are created with FSQUrlRouter's `routeAnalysesForNativeScheme:` and `routeAnalysesForUniversalLinkHost:`,
+ or FSQRouteMatcher's `routeAnalyses`. Use them to catch routes hidden behind broader ones (eg "/venues/:venueId"
+ registered after "/venues/*"), and to check that reordering a map for speed doesn't change which route any url
+ goes to.
+
+ A route is reported as shadowed only if a single route with a lower index matches every url it matches. This is
+ conservative: a reported route can never be routed to, but a route covered only by several earlier routes together,
+ or by an unusual run of wildcards (eg "/ ** / *" covering "/ * / ** "), is not reported.
+ */
+@interface FSQRouteAnalysis : NSObject
+
+/**
+ The index of the route in its route map.
+ */
+@property (nonatomic, assign, readonly) NSUInteger routeIndex;
+
+/**
+ The route string, rebuilt from the compiled route. It is normalized (eg "//venues/" becomes "/venues"), and static
+ components which would otherwise read as a parameter or wildcard are percent-encoded.
+ */
+@property (nonatomic, copy, readonly) NSString *routeString;
+
+/**
+ The index of the lowest indexed route which matches every url this route matches, or NSNotFound if there is none.
+ */
+@property (nonatomic, assign, readonly) NSUInteger shadowingRouteIndex;
+
+/**
+ YES if `shadowingRouteIndex` is set, ie no url will ever be routed to this route.
+ */
+@property (nonatomic, assign, readonly, getter=isShadowed) BOOL shadowed;
+
+/**
+ YES if the shadowing route matches exactly the same urls as this one, ie their path components only differ in
+ parameter names or in a parameter in place of a single wildcard. These routes are leftover duplicates and can
+ simply be removed.
+ */
+@property (nonatomic, assign, readonly, getter=isRedundant) BOOL redundant;
+
+/**
+ The number of path components a url needs to match the route (native scheme hosts count as a path component).
+ */
+@property (nonatomic, assign, readonly) NSUInteger minimumPathLength;
+
+/**
+ The largest number of path components a url matching the route can have, or NSUIntegerMax if the route has an
+ unlimited wildcard.
+ */
+@property (nonatomic, assign, readonly) NSUInteger maximumPathLength;
+
+/**
+ The cost of matching the longest path the route accepts, or NSUIntegerMax if the route has an unlimited wildcard.
+ See `matchingCostForPathLength:`.
+ */
+@property (nonatomic, assign, readonly) NSUInteger worstCaseMatchingCost;
+
+/**
+ The cost of matching a path with the given number of components against the route, in steps of the path matcher.
+
+ The route map's trie only hands the matcher routes which can match a url's path, and the matcher fills in one table
+ entry per route token and path component (plus one of each). Routes with unlimited wildcards cost more as paths
+ get longer, and they also keep extra trie nodes active for every url which reaches them.
+
+ @return The number of steps, or 0 if no path of that length can match the route (the matcher never sees it).
+ */
+- (NSUInteger)matchingCostForPathLength:(NSUInteger)pathLength;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,56 @@
+//
+//  FSQRouteAnalysis.m
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+#import "FSQRouteAnalysis.h"
+
+#import "FSQRouteMatchingCore.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation FSQRouteAnalysis {
+    NSUInteger _numberOfTokens;
+}
+
+- (instancetype)initWithRouteIndex:(NSUInteger)routeIndex
+                       routeString:(NSString *)routeString
+               shadowingRouteIndex:(NSUInteger)shadowingRouteIndex
+                         redundant:(BOOL)redundant
+                    numberOfTokens:(NSUInteger)numberOfTokens
+        numberOfUnlimitedWildcards:(NSUInteger)numberOfUnlimitedWildcards {
+    self = [super init];
+    if (self) {
+        _routeIndex = routeIndex;
+        _routeString = [routeString copy];
+        _shadowingRouteIndex = shadowingRouteIndex;
+        _redundant = redundant;
+        _numberOfTokens = numberOfTokens;
+        _minimumPathLength = numberOfTokens - numberOfUnlimitedWildcards;
+        _maximumPathLength = (numberOfUnlimitedWildcards > 0) ? NSUIntegerMax : numberOfTokens;
+    }
+    return self;
+}
+
+- (BOOL)isShadowed {
+    return (self.shadowingRouteIndex != NSNotFound);
+}
+
+- (NSUInteger)worstCaseMatchingCost {
+    NSUInteger maximumPathLength = self.maximumPathLength;
+    return (maximumPathLength != NSUIntegerMax) ? [self matchingCostForPathLength:maximumPathLength] : NSUIntegerMax;
+}
+
+- (NSUInteger)matchingCostForPathLength:(NSUInteger)pathLength {
+    if (pathLength < self.minimumPathLength
+        || pathLength > self.maximumPathLength) {
+        return 0;
+    }
+    return (_numberOfTokens + 1) * (pathLength + 1);
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,40 @@
+//
+//  FSQRouteCancellationToken.h
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+@import Foundation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A Route Cancellation Token is passed to asynchronous content generators so they can find out when the content
+ they are generating is no longer needed.
+
+ FSQUrlRouter cancels the token of a route which is still being generated or presented as soon as a newer route
+ starts, and never presents the older route's content. Generators should check `isCancelled` (or add a cancellation
+ handler) to stop expensive work early, but must still call their completion block.
+ */
+@interface FSQRouteCancellationToken : NSObject
+
+/**
+ YES once `cancel` has been called. This can be read from any thread.
+ */
+@property (atomic, assign, readonly, getter=isCancelled) BOOL cancelled;
+
+/**
+ Cancels the token and calls its cancellation handlers. Calling this more than once does nothing.
+ */
+- (void)cancel;
+
+/**
+ Adds a block to be called when the token is cancelled, on the thread that cancels it. If the token has already
+ been cancelled, the block is called immediately on the current thread.
+ */
+- (void)addCancellationHandler:(void (^)(void))cancellationHandler;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,66 @@
+//
+//  FSQRouteCancellationToken.m
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+#import "FSQRouteCancellationToken.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface FSQRouteCancellationToken ()
+@property (atomic, assign, readwrite, getter=isCancelled) BOOL cancelled;
+@end
+
+@implementation FSQRouteCancellationToken {
+    NSLock *_lock;
+    NSMutableArray<void (^)(void)> *_cancellationHandlers;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _lock = [NSLock new];
+    }
+    return self;
+}
+
+- (void)cancel {
+    [_lock lock];
+    if (self.cancelled) {
+        [_lock unlock];
+        return;
+    }
+    self.cancelled = YES;
+    NSArray<void (^)(void)> *cancellationHandlers = _cancellationHandlers;
+    _cancellationHandlers = nil;
+    [_lock unlock];
+
+    /**
+     Handlers are called outside the lock so they can safely look at the token again.
+     */
+    for (void (^cancellationHandler)(void) in cancellationHandlers) {
+        cancellationHandler();
+    }
+}
+
+- (void)addCancellationHandler:(void (^)(void))cancellationHandler {
+    [_lock lock];
+    BOOL cancelled = self.cancelled;
+    if (!cancelled) {
+        if (_cancellationHandlers == nil) {
+            _cancellationHandlers = [NSMutableArray new];
+        }
+        [_cancellationHandlers addObject:[cancellationHandler copy]];
+    }
+    [_lock unlock];
+
+    if (cancelled) {
+        cancellationHandler();
+    }
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -12,6 +12,7 @@ NS_ASSUME_NONNULL_BEGIN
 
 @class FSQRouteContent;
 @class FSQRouteUrlData;
+@class FSQRouteViewControllerPool;
 
 /**
  This block type takes in a view controller that should be presented in some way, along with the view controller
@@ -75,6 +76,25 @@ typedef void (^FSQRouteContentBlock)(UIViewController *pushingController,
  */
 @property (nonatomic, strong, nullable) Class viewControllerClass;
 
+/**
+ If set along with `reusePool`, view controllers created from `viewControllerClass` are reused across content
+ objects with the same class and reuse identifier, instead of a new one being created every time. Set it from your
+ generator to whatever identifies the screen being shown, eg the venue id parameter of a venue route.
+
+ The view controller class must implement `prepareForReuseWithFSQRouteUrlData:`, which is called on a reused view
+ controller with this content's url data. See FSQRouteViewControllerPool for when view controllers are reused.
+ */
+@property (nonatomic, copy, nullable) NSString *reuseIdentifier;
+
+/**
+ The pool this content's view controller is taken from and returned to after presentation, if it has a
+ `reuseIdentifier`.
+
+ If this content object is being created by FSQUrlRouter and the content's reusePool is nil, the router will set
+ its value to its own viewControllerReusePool property.
+ */
+@property (nonatomic, strong, nullable) FSQRouteViewControllerPool *reusePool;
+
 /**
  This is the url date used to generate this content object, if any.
  */
@@ -165,6 +185,17 @@ typedef void (^FSQRouteContentBlock)(UIViewController *pushingController,
  */
 + (UIViewController *)viewControllerForFSQRouteUrlData:(nullable FSQRouteUrlData *)urlData;
 
+@optional
+
+/**
+ If implemented, view controllers of this class can be reused by route content objects with a `reuseIdentifier`
+ and a `reusePool`. This is called on a view controller taken from the pool, before it is presented again, with
+ the url data of the new content object. Update the view controller for the new url data here.
+
+ @param urlData The url data used to create the route content object which is reusing this view controller.
+ */
+- (void)prepareForReuseWithFSQRouteUrlData:(nullable FSQRouteUrlData *)urlData;
+
 @end
 
 NS_ASSUME_NONNULL_END
\ No newline at end of file
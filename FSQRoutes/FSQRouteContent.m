@@ -8,6 +8,8 @@
 
 #import "FSQRouteContent.h"
 
+#import "FSQRouteViewControllerPool.h"
+
 NS_ASSUME_NONNULL_BEGIN
 
 @implementation FSQRouteContent
@@ -61,10 +63,29 @@ NS_ASSUME_NONNULL_BEGIN
     self.viewControllerClass = viewController.class;
 }
 
+/**
+ @return YES if view controllers of this content's class are taken from and returned to its reuse pool.
+ */
+- (BOOL)reusesViewControllers {
+    return (self.reusePool != nil
+            && self.reuseIdentifier != nil
+            && [self.viewControllerClass instancesRespondToSelector:@selector(prepareForReuseWithFSQRouteUrlData:)]);
+}
+
 - (nullable UIViewController *)viewControllerToPresent {
     if (self.viewController == nil
         && self.viewControllerClass != Nil) {
-        if ([self.viewControllerClass respondsToSelector:@selector(viewControllerForFSQRouteUrlData:)]) {
+        UIViewController *reusedViewController = nil;
+        if ([self reusesViewControllers]) {
+            reusedViewController = [self.reusePool dequeueViewControllerOfClass:self.viewControllerClass
+                                                                reuseIdentifier:(NSString *)self.reuseIdentifier];
+            [(id<FSQRouteContentViewControllerProtocol>)reusedViewController prepareForReuseWithFSQRouteUrlData:self.urlData];
+        }
+        
+        if (reusedViewController != nil) {
+            self.viewController = reusedViewController;
+        }
+        else if ([self.viewControllerClass respondsToSelector:@selector(viewControllerForFSQRouteUrlData:)]) {
             self.viewController = [self.viewControllerClass viewControllerForFSQRouteUrlData:self.urlData];
         }
         else {
@@ -96,6 +117,13 @@ NS_ASSUME_NONNULL_BEGIN
         UIViewController *viewController = [self viewControllerToPresent];
         if (viewController != nil) {
             presentation(viewController, presentingViewController, self.urlData);
+            
+            /**
+             The pool keeps the view controller while it is on screen, but only hands it out again once it is not.
+             */
+            if ([self reusesViewControllers]) {
+                [self.reusePool addViewController:viewController reuseIdentifier:(NSString *)self.reuseIdentifier];
+            }
         }
     }
 }
@@ -10,6 +10,7 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+@class FSQRouteCancellationToken;
 @class FSQRouteContent;
 @class FSQRouteUrlData;
 
@@ -22,6 +23,26 @@ NS_ASSUME_NONNULL_BEGIN
  */
 typedef FSQRouteContent *_Nullable(^FSQRoutesContentGeneratorBlock)(FSQRouteUrlData *urlData);
 
+/**
+ The completion block of an asynchronous content generator.
+
+ @param routeContent The generated route content, or nil to cancel the routing.
+ */
+typedef void (^FSQRoutesContentGeneratorCompletionBlock)(FSQRouteContent *_Nullable routeContent);
+
+/**
+ This block type takes in a url data object and generates a new route content object for that data asynchronously,
+ eg after loading the object the url refers to from disk or the network.
+
+ @param urlData           Incoming url data to generate the content from.
+ @param cancellationToken Cancelled if the content is no longer needed (eg because a newer url was routed).
+                          Generators can check it to stop early.
+ @param completion        Must be called exactly once, on any thread, even if the token was cancelled.
+ */
+typedef void (^FSQRoutesAsyncContentGeneratorBlock)(FSQRouteUrlData *urlData,
+                                                    FSQRouteCancellationToken *cancellationToken,
+                                                    FSQRoutesContentGeneratorCompletionBlock completion);
+
 /**
  The Route Content Generator class takes a url data object and generates a new route content object from it.
  
@@ -40,6 +61,14 @@ typedef FSQRouteContent *_Nullable(^FSQRoutesContentGeneratorBlock)(FSQRouteUrlD
  */
 @property (nonatomic, copy) FSQRoutesContentGeneratorBlock generatorBlock;
 
+/**
+ If set, this block is used to generate content instead of generatorBlock.
+
+ FSQUrlRouter never blocks while waiting for an asynchronous generator. The completion block can be called on any
+ thread; the routing delegate callbacks which follow content generation are always made on the main queue.
+ */
+@property (nonatomic, copy, nullable) FSQRoutesAsyncContentGeneratorBlock asyncGeneratorBlock;
+
 /**
  This is the designated initializer for the class. You must provide a generatorBlock for all
  FSQRouteContentGenerator instances.
@@ -50,16 +79,41 @@ typedef FSQRouteContent *_Nullable(^FSQRoutesContentGeneratorBlock)(FSQRouteUrlD
  */
 - (instancetype)initWithBlock:(FSQRoutesContentGeneratorBlock)generatorBlock NS_DESIGNATED_INITIALIZER; 
 
+/**
+ Creates a generator which generates its content asynchronously.
+
+ @param asyncGeneratorBlock The asynchronous generator block for this instance.
+
+ @return An initialized generator object with the passed in block.
+ */
+- (instancetype)initWithAsyncBlock:(FSQRoutesAsyncContentGeneratorBlock)asyncGeneratorBlock;
+
 /**
  This method is used to actually create content objects and should be used instead of directly
  calling the block property.
  
+ For generators with an asyncGeneratorBlock this blocks the calling thread until the generator completes, which
+ deadlocks if the generator completes on the calling thread's queue. Prefer the method with a completion block.
+
  @param urlData The url data for which you wish to generate a new content object.
  
  @return A new FSQRouteContent object.
  */
 - (nullable FSQRouteContent *)generateRouteContentFromUrlData:(FSQRouteUrlData *)urlData;
 
+/**
+ Generates a content object using the generator's async block if it has one, or its synchronous block otherwise.
+
+ @param urlData           The url data for which you wish to generate a new content object.
+ @param cancellationToken Passed through to the async generator block. If nil, a token which is never cancelled
+                          is passed instead.
+ @param completion        Called exactly once with the new content object. Synchronous generators call it before
+                          this method returns.
+ */
+- (void)generateRouteContentFromUrlData:(FSQRouteUrlData *)urlData
+                      cancellationToken:(nullable FSQRouteCancellationToken *)cancellationToken
+                             completion:(FSQRoutesContentGeneratorCompletionBlock)completion;
+
 @end
 
 NS_ASSUME_NONNULL_END
\ No newline at end of file
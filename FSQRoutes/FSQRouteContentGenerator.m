@@ -8,6 +8,7 @@
 
 #import "FSQRouteContentGenerator.h"
 
+#import "FSQRouteCancellationToken.h"
 #import "FSQRouteContent.h"
 
 NS_ASSUME_NONNULL_BEGIN
@@ -28,7 +29,32 @@ NS_ASSUME_NONNULL_BEGIN
     return self;
 }
 
+- (instancetype)initWithAsyncBlock:(FSQRoutesAsyncContentGeneratorBlock)asyncGeneratorBlock {
+    self = [self init];
+    if (self) {
+        self.asyncGeneratorBlock = asyncGeneratorBlock;
+    }
+    return self;
+}
+
 - (nullable FSQRouteContent *)generateRouteContentFromUrlData:(FSQRouteUrlData *)urlData {
+    if (self.asyncGeneratorBlock) {
+        /**
+         Callers of the synchronous method have to wait for async generators. This deadlocks if the generator
+         completes on the queue that is waiting, which is why FSQUrlRouter never calls this for async generators.
+         */
+        __block FSQRouteContent *routeContent = nil;
+        dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+        [self generateRouteContentFromUrlData:urlData
+                            cancellationToken:nil
+                                   completion:^(FSQRouteContent *_Nullable generatedRouteContent) {
+                                       routeContent = generatedRouteContent;
+                                       dispatch_semaphore_signal(semaphore);
+                                   }];
+        dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+        return routeContent;
+    }
+    
     if (self.generatorBlock) {
         FSQRouteContent *routeContent = self.generatorBlock(urlData);
         routeContent.urlData = urlData;
@@ -37,6 +63,22 @@ NS_ASSUME_NONNULL_BEGIN
     return nil;
 }
 
+- (void)generateRouteContentFromUrlData:(FSQRouteUrlData *)urlData
+                      cancellationToken:(nullable FSQRouteCancellationToken *)cancellationToken
+                             completion:(FSQRoutesContentGeneratorCompletionBlock)completion {
+    FSQRoutesAsyncContentGeneratorBlock asyncGeneratorBlock = self.asyncGeneratorBlock;
+    
+    if (asyncGeneratorBlock) {
+        asyncGeneratorBlock(urlData, cancellationToken ?: [FSQRouteCancellationToken new], ^(FSQRouteContent *_Nullable routeContent) {
+            routeContent.urlData = urlData;
+            completion(routeContent);
+        });
+    }
+    else {
+        completion([self generateRouteContentFromUrlData:urlData]);
+    }
+}
+
 @end
 
 NS_ASSUME_NONNULL_END
\ No newline at end of file
@@ -0,0 +1,86 @@
+//
+//  FSQRouteMatch.h
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+@import Foundation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class FSQRouteContentGenerator;
+@class FSQRouteUrlData;
+
+/**
+ The Route Match class describes the result of matching a single url against the route maps registered on a 
+ FSQUrlRouter, without generating or presenting any content for it.
+ 
+ Match objects are returned by FSQUrlRouter's batch matching methods. Urls which did not match any route still get a
+ match object (with `matched` set to NO) so that results always line up with the urls that were passed in.
+ */
+@interface FSQRouteMatch : NSObject
+
+/**
+ The url that was matched.
+ */
+@property (nonatomic, strong, readonly) NSURL *url;
+
+/**
+ YES if the url matched a route in a registered route map.
+ */
+@property (nonatomic, assign, readonly, getter=isMatched) BOOL matched;
+
+/**
+ NO if the url was a universal link (https scheme), YES otherwise.
+ */
+@property (nonatomic, assign, readonly) BOOL isNativeScheme;
+
+/**
+ The content generator paired with the matching route, or nil if the url did not match.
+ */
+@property (nonatomic, strong, readonly, nullable) FSQRouteContentGenerator *contentGenerator;
+
+/**
+ The url data for the match, including the parsed out parameters, or nil if the url did not match.
+ */
+@property (nonatomic, strong, readonly, nullable) FSQRouteUrlData *urlData;
+
+/**
+ The index of the matching route in the route map it was registered with, or NSNotFound if the url did not match.
+ 
+ Route indexes are stable: routes added individually after registration get increasing indexes, and removing 
+ a route does not renumber the routes after it.
+ */
+@property (nonatomic, assign, readonly) NSUInteger routeIndex;
+
+/**
+ The generation of the router's route table that this match was made against. See FSQUrlRouter's 
+ `routeTableGeneration`.
+ */
+@property (nonatomic, assign, readonly) NSUInteger routeTableGeneration;
+
+/**
+ This is the designated initializer for the class.
+ 
+ @param url              The url that was matched.
+ @param isNativeScheme   Whether or not the url is a native scheme url.
+ @param contentGenerator The generator of the matching route (if any).
+ @param urlData          The url data of the match (if any).
+ @param routeIndex       The index of the matching route in its route map, or NSNotFound.
+ @param routeTableGeneration The generation of the route table the url was matched against.
+ 
+ @return A new match object. `matched` will be YES if contentGenerator is not nil.
+ */
+- (instancetype)initWithUrl:(NSURL *)url
+             isNativeScheme:(BOOL)isNativeScheme
+           contentGenerator:(nullable FSQRouteContentGenerator *)contentGenerator
+                    urlData:(nullable FSQRouteUrlData *)urlData
+                 routeIndex:(NSUInteger)routeIndex
+       routeTableGeneration:(NSUInteger)routeTableGeneration NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
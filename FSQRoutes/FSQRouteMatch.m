@@ -0,0 +1,44 @@
+//
+//  FSQRouteMatch.m
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+#import "FSQRouteMatch.h"
+
+#import "FSQRouteUrlData.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation FSQRouteMatch
+
+- (instancetype)initWithUrl:(NSURL *)url
+             isNativeScheme:(BOOL)isNativeScheme
+           contentGenerator:(nullable FSQRouteContentGenerator *)contentGenerator
+                    urlData:(nullable FSQRouteUrlData *)urlData
+                 routeIndex:(NSUInteger)routeIndex
+       routeTableGeneration:(NSUInteger)routeTableGeneration {
+    self = [super init];
+    if (self) {
+        _url = url;
+        _isNativeScheme = isNativeScheme;
+        _contentGenerator = contentGenerator;
+        _urlData = urlData;
+        _routeIndex = routeIndex;
+        _routeTableGeneration = routeTableGeneration;
+        _matched = (contentGenerator != nil);
+    }
+    return self;
+}
+
+- (NSString *)debugDescription {
+    return [NSString stringWithFormat:@"<%@: %p, url: %@, routeIndex: %@, parameters: %@>", 
+            self.class, self, self.url, 
+            (self.matched ? @(self.routeIndex) : @"none"), 
+            self.urlData.parameters];
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,126 @@
+//
+//  FSQRouteMatcher.h
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "FSQRouteAnalysis.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The error domain for errors returned by FSQUrlRouter and FSQRouteMatcher.
+ */
+extern NSString *const FSQUrlRouterErrorDomain;
+
+typedef NS_ENUM(NSInteger, FSQUrlRouterErrorCode) {
+    /**
+     The compiled route map data is malformed, truncated, or from an incompatible version of FSQRoutes.
+     */
+    FSQUrlRouterErrorCodeInvalidCompiledRouteMap = 1,
+    /**
+     The number of generators passed in does not match the number of routes in the compiled route map.
+     */
+    FSQUrlRouterErrorCodeGeneratorCountMismatch,
+    /**
+     The file is not a route trace, or was written by an incompatible version of FSQRoutes. See FSQRouteTraceRecorder.
+     */
+    FSQUrlRouterErrorCodeInvalidTrace,
+};
+
+/**
+ Options for how the static components of a route map's routes are compared with url path components. Parameters
+ always capture the url's path components exactly as they were in the url.
+ */
+typedef NS_OPTIONS(NSUInteger, FSQRouteMatchingOptions) {
+    FSQRouteMatchingOptionsNone = 0,
+    /**
+     Static components match regardless of case, so "/venues" matches both "app://venues" and "app://Venues".
+     */
+    FSQRouteMatchingOptionsCaseInsensitive = 1 << 0,
+    /**
+     Static components are compared in Unicode normalization form C, so precomposed and decomposed accented
+     characters match each other.
+     */
+    FSQRouteMatchingOptionsUnicodeNormalized = 1 << 1,
+};
+
+/**
+ The Route Matcher class matches urls against a single route map, using the same tokenizer, compiled tries and
+ matching rules as FSQUrlRouter, but without content generation or presentation.
+
+ It only depends on Foundation, so it can be used outside of apps: for example to check server side which route a
+ link will open, or to run large link logs through a route map (see Tools/fsqroutes-match, which is meant to build on
+ Linux with GNUstep, though that build is untested).
+
+ Matchers don't look at the scheme or host of the urls they match. Like the router, the host of a native scheme url
+ is treated as its first path component, and the host of an https url is ignored.
+
+ Matchers are immutable and can be used from any thread.
+ */
+@interface FSQRouteMatcher : NSObject
+
+@property (nonatomic, assign, readonly) NSUInteger numberOfRoutes;
+
+/**
+ Creates a matcher from route strings, in the same format as the route strings of a route map registered on a
+ FSQUrlRouter. A route's index is its position in the array. Empty route strings keep their index but never match
+ anything, and are left out of `routeAnalyses`.
+ */
+- (instancetype)initWithRouteStrings:(NSArray<NSString *> *)routeStrings;
+
+/**
+ Creates a matcher from route strings which compares static components using the given options.
+ */
+- (instancetype)initWithRouteStrings:(NSArray<NSString *> *)routeStrings options:(FSQRouteMatchingOptions)options;
+
+/**
+ Creates a matcher from compiled route map data (see `+[FSQUrlRouter compiledRouteMapDataWithRouteStrings:]`).
+
+ @return The new matcher, or nil if the data is not valid compiled route map data (with an error in the
+ FSQUrlRouterErrorDomain).
+ */
+- (nullable instancetype)initWithCompiledRouteMapData:(NSData *)data error:(NSError **)error;
+
+/**
+ Creates a matcher from compiled route map data which compares static components using the given options. The data
+ doesn't need to have been compiled with the same options.
+ */
+- (nullable instancetype)initWithCompiledRouteMapData:(NSData *)data
+                                              options:(FSQRouteMatchingOptions)options
+                                                error:(NSError **)error;
+
+/**
+ Matches a url against the routes. When several routes match, the one with the lowest index wins.
+
+ @param url        The url to match.
+ @param parameters If not NULL, set to the url's path and query parameters when a route matched, or nil otherwise.
+
+ @return The index of the matching route, or NSNotFound if no route matched.
+ */
+- (NSUInteger)indexOfRouteMatchingUrl:(NSURL *)url
+                           parameters:(NSDictionary<NSString *, NSString *> *_Nullable *_Nullable)parameters;
+
+/**
+ Matches a url against every route, not just until the first match.
+
+ @return The indexes of all the routes the url matches. The lowest one is the index `indexOfRouteMatchingUrl:parameters:`
+ returns.
+ */
+- (NSIndexSet *)indexesOfRoutesMatchingUrl:(NSURL *)url;
+
+/**
+ Analyzes the routes for shadowed and redundant routes and their matching cost. See FSQRouteAnalysis.
+
+ @return One analysis per route, in route index order.
+ */
+- (NSArray<FSQRouteAnalysis *> *)routeAnalyses;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,101 @@
+//
+//  FSQRouteMatcher.m
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+#import "FSQRouteMatcher.h"
+
+#import "FSQRouteMatchingCore.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation FSQRouteMatcher {
+    FSQCompiledRouteMap *_routeMap;
+}
+
+- (instancetype)initWithRouteStrings:(NSArray<NSString *> *)routeStrings {
+    return [self initWithRouteStrings:routeStrings options:FSQRouteMatchingOptionsNone];
+}
+
+- (instancetype)initWithRouteStrings:(NSArray<NSString *> *)routeStrings options:(FSQRouteMatchingOptions)options {
+    self = [super init];
+    if (self) {
+        /**
+         Matchers only report route indexes, so every route gets NSNull in place of a content generator.
+         */
+        NSMutableArray<NSArray *> *tokenizedRouteMap = [NSMutableArray arrayWithCapacity:routeStrings.count];
+        for (NSString *routeString in routeStrings) {
+            /**
+             An empty string would tokenize to a route with no tokens, which matches root and query-only urls. It
+             keeps its index but never matches instead, the same as in compiled route map data.
+             */
+            id tokens = (routeString.length > 0) ? FSQTokenizedRouteStringWithOptions(routeString, options) : [NSNull null];
+            [tokenizedRouteMap addObject:@[tokens, [NSNull null]]];
+        }
+
+        _routeMap = [[FSQCompiledRouteMap alloc] initWithTokenizedRouteMap:tokenizedRouteMap options:options];
+    }
+    return self;
+}
+
+- (nullable instancetype)initWithCompiledRouteMapData:(NSData *)data error:(NSError **)error {
+    return [self initWithCompiledRouteMapData:data options:FSQRouteMatchingOptionsNone error:error];
+}
+
+- (nullable instancetype)initWithCompiledRouteMapData:(NSData *)data
+                                              options:(FSQRouteMatchingOptions)options
+                                                error:(NSError **)error {
+    FSQCompiledRouteMap *routeMap = [[FSQCompiledRouteMap alloc] initWithCompiledRouteMapData:data
+                                                                                   generators:nil
+                                                                                      options:options
+                                                                                        error:error];
+    if (routeMap == nil) {
+        return nil;
+    }
+
+    self = [super init];
+    if (self) {
+        _routeMap = routeMap;
+    }
+    return self;
+}
+
+- (NSUInteger)numberOfRoutes {
+    return _routeMap.numberOfRoutes;
+}
+
+- (NSUInteger)indexOfRouteMatchingUrl:(NSURL *)url
+                           parameters:(NSDictionary<NSString *, NSString *> *_Nullable *_Nullable)parameters {
+    FSQParsedRouteUrl *parsedUrl = [[FSQParsedRouteUrl alloc] initWithUrl:url];
+
+    NSMutableDictionary<NSString *, NSString *> *pathParameters = nil;
+    FSQCompiledRoute *route = [_routeMap routeMatchingParsedUrl:parsedUrl
+                                                 pathParameters:&pathParameters
+                                            numberOfRoutesTried:NULL];
+
+    if (parameters != NULL) {
+        [pathParameters addEntriesFromDictionary:parsedUrl.queryParameters];
+        *parameters = pathParameters;
+    }
+
+    return (route != nil) ? route.routeIndex : NSNotFound;
+}
+
+- (NSIndexSet *)indexesOfRoutesMatchingUrl:(NSURL *)url {
+    NSMutableIndexSet *routeIndexes = [NSMutableIndexSet new];
+    for (FSQCompiledRoute *route in [_routeMap routesMatchingParsedUrl:[[FSQParsedRouteUrl alloc] initWithUrl:url]
+                                                         pathParameters:NULL]) {
+        [routeIndexes addIndex:route.routeIndex];
+    }
+    return routeIndexes;
+}
+
+- (NSArray<FSQRouteAnalysis *> *)routeAnalyses {
+    return [_routeMap routeAnalyses];
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
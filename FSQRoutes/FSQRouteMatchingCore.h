@@ -0,0 +1,494 @@
+//
+//  FSQRouteMatchingCore.h
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "FSQRouteAnalysis.h"
+#import "FSQRouteMatcher.h"
+
+/**
+ Not every gnustep-base version defines this.
+ */
+#ifndef FOUNDATION_EXPORT
+#define FOUNDATION_EXPORT extern
+#endif
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The url matching core of FSQRoutes: the route tokenizer, the route string pool, compiled route maps and the
+ matcher.
+
+ Nothing in here uses UIKit or the router, only Foundation, so it also builds with GNUstep (see
+ Tools/fsqroutes-match). FSQUrlRouter and FSQRouteMatcher are both built on top of it.
+
+ Routes keep the object they were registered with as their contentGenerator without ever looking at it. For the
+ router this is the route's FSQRouteContentGenerator.
+ */
+
+@class FSQParsedRouteUrl;
+
+typedef NS_ENUM(NSInteger, FSQRouteUrlTokenType) {
+    FSQRouteUrlTokenTypeString,
+    FSQRouteUrlTokenTypeParameter,
+    FSQRouteUrlTokenTypeSingleComponentWildcard,
+    FSQRouteUrlTokenTypeUnlimitedComponentWildcard,
+    FSQRouteUrlTokenTypeIntegerParameter
+};
+
+/**
+ @return YES for the token types which capture their path component as a parameter.
+ */
+static inline BOOL FSQRouteUrlTokenTypeIsParameter(FSQRouteUrlTokenType type) {
+    return (type == FSQRouteUrlTokenTypeParameter
+            || type == FSQRouteUrlTokenTypeIntegerParameter);
+}
+
+/**
+ The string index of wildcard tokens, and of url path components which are not used by any route.
+ */
+static const uint32_t kFSQRouteStringNotInterned = UINT32_MAX;
+
+/**
+ An immutable copy of the string pool's indexes at one point in time.
+
+ Matching looks url path components up in a snapshot instead of the pool itself, so it never takes the pool's lock
+ and is never held up by routes being interned on another thread. Indexes never change, so a snapshot agrees with
+ the pool on every string it has.
+ */
+@interface FSQRouteStringPoolSnapshot : NSObject
+
+/**
+ The number of strings in the pool when the snapshot was taken.
+ */
+@property (nonatomic, assign, readonly) NSUInteger count;
+
+/**
+ Looks up the index of every string in the array.
+
+ @param indexes Filled in with the index of each string, or kFSQRouteStringNotInterned if it was not in the pool
+                when the snapshot was taken.
+ */
+- (void)getIndexes:(uint32_t *)indexes ofStrings:(NSArray<NSString *> *)strings;
+@end
+
+/**
+ The pool of every static path component and parameter name used by a route, shared by all routers, schemes and
+ hosts.
+
+ Each distinct string is stored once and identified by a 32 bit index, so routes only need to store indexes and
+ static components can be matched by comparing integers. Strings are never removed, so indexes stay valid for the
+ life of the process. This means the pool only grows with the number of distinct strings ever registered, including
+ those of routes that have since been removed or replaced. Url path components are only looked up, never added, so
+ matching urls doesn't grow the pool.
+ */
+@interface FSQRouteStringPool : NSObject
+@property (nonatomic, assign, readonly) NSUInteger count;
+
+/**
+ A snapshot of the pool's current strings. The same snapshot is returned until another string is interned.
+ */
+@property (nonatomic, strong, readonly) FSQRouteStringPoolSnapshot *snapshot;
+
++ (instancetype)sharedPool;
+
+/**
+ @return The index of the string, adding it to the pool if it isn't there yet.
+ */
+- (uint32_t)indexForInterningString:(NSString *)string;
+- (NSString *)stringAtIndex:(uint32_t)index;
+
+@end
+
+@interface FSQRouteUrlToken : NSObject 
+@property (nonatomic, assign, readonly) FSQRouteUrlTokenType type;
+
+/**
+ The static string or parameter name of the token. This is the pool's copy of the string, so every token with the
+ same string shares it.
+ */
+@property (nonatomic, copy, nullable, readonly) NSString *stringOrParameterName;
+
+/**
+ The string pool index of stringOrParameterName, or kFSQRouteStringNotInterned for wildcards.
+ */
+@property (nonatomic, assign, readonly) uint32_t stringIndex;
+
++ (instancetype)withString:(NSString *)string;
++ (instancetype)withParameterName:(NSString *)parameterName;
+
+/**
+ A parameter which only matches path components that are decimal integers (see `FSQIntegerValueOfString`).
+ */
++ (instancetype)withIntegerParameterName:(NSString *)parameterName;
++ (instancetype)singleComponentWildCard;
++ (instancetype)unlimitedComponentWildCard;
+@end
+
+/**
+ A single route of a compiled route map.
+
+ Tokens are stored as two parallel arrays in a single allocation: one byte for each token's type and the string pool
+ index of each token's string (kFSQRouteStringNotInterned for wildcards). The only string objects a route keeps are
+ its parameter names, so building the parameters of a match never has to go back to the string pool.
+ */
+@interface FSQCompiledRoute : NSObject
+@property (nonatomic, assign, readonly) NSUInteger numberOfTokens;
+@property (nonatomic, assign, readonly) const uint8_t *tokenTypes;
+@property (nonatomic, assign, readonly) const uint32_t *tokenStringIndexes;
+@property (nonatomic, strong, readonly) id contentGenerator;
+
+/**
+ The names of the route's parameters, in the order they appear in the route.
+ */
+@property (nonatomic, copy, readonly) NSArray<NSString *> *parameterNames;
+
+/**
+ The position of the route in its map. Routes with lower indexes take precedence. Indexes are never reused or 
+ renumbered when routes are added or removed.
+ */
+@property (nonatomic, assign, readonly) NSUInteger routeIndex;
+
+- (instancetype)initWithTokens:(NSArray<FSQRouteUrlToken *> *)tokens
+              contentGenerator:(id)contentGenerator
+                    routeIndex:(NSUInteger)routeIndex;
+
+/**
+ A copy of the route with a different content generator.
+ */
+- (instancetype)initWithRoute:(FSQCompiledRoute *)route contentGenerator:(id)contentGenerator;
+
+/**
+ @return YES if the route's tokens are the same as the given ones, including parameter names.
+ */
+- (BOOL)hasTokens:(NSArray<FSQRouteUrlToken *> *)tokens;
+
+/**
+ Matches a url's path against the route's tokens.
+
+ @return The route's path parameters, or nil if the path doesn't match. Query parameters are not included.
+ */
+- (nullable NSMutableDictionary<NSString *, NSString *> *)pathParametersForParsedUrl:(FSQParsedRouteUrl *)parsedUrl;
+@end
+
+/**
+ A node in the prefix trie that a route map is compiled into at registration time.
+ 
+ Each edge out of a node consumes one route token. Static string edges are looked up by string pool index, while
+ parameter, single wildcard and unlimited wildcard edges are stored separately since they match any path component. 
+ Integer parameters get their own edge, which is only followed by path components that are integers.
+ Parameter names are not part of the trie (all parameters of the same type at the same position share a node),
+ they are only needed once a route has been picked and its parameters are extracted.
+ 
+ Nodes are only mutated while a map is being built. Once a map has been published, updates copy the nodes on the
+ path to the changed route and share everything else with the previous version of the map.
+ */
+@interface FSQRouteTrieNode : NSObject <NSCopying>
+@property (nonatomic, strong, readonly) NSMutableDictionary<NSNumber *, FSQRouteTrieNode *> *stringChildren;
+@property (nonatomic, strong, nullable) FSQRouteTrieNode *parameterChild;
+@property (nonatomic, strong, nullable) FSQRouteTrieNode *integerParameterChild;
+@property (nonatomic, strong, nullable) FSQRouteTrieNode *singleComponentWildcardChild;
+@property (nonatomic, strong, nullable) FSQRouteTrieNode *unlimitedComponentWildcardChild;
+
+/**
+ YES if the edge leading to this node was an unlimited wildcard. These nodes can consume any number of 
+ path components while staying on the same node.
+ */
+@property (nonatomic, assign, readonly) BOOL isUnlimitedComponentWildcard;
+
+/**
+ Every route whose tokens end at this node, in ascending route index order.
+ */
+@property (nonatomic, strong, readonly) NSMutableArray<FSQCompiledRoute *> *routes;
+
+/**
+ YES if there are no routes on this node or any of its children.
+ */
+@property (nonatomic, assign, readonly) BOOL isEmpty;
+
++ (instancetype)nodeForToken:(FSQRouteUrlToken *)token;
+
+- (nullable FSQRouteTrieNode *)childForToken:(FSQRouteUrlToken *)token;
+- (void)setChild:(nullable FSQRouteTrieNode *)child forToken:(FSQRouteUrlToken *)token;
+- (FSQRouteTrieNode *)childForAddingToken:(FSQRouteUrlToken *)token;
+
+/**
+ Adds a route with the given tokens below this node, mutating the trie in place. Only for use while a map is being
+ built.
+ */
+- (void)insertRoute:(FSQCompiledRoute *)route tokens:(NSArray<FSQRouteUrlToken *> *)tokens;
+- (void)addToActiveNodes:(NSMutableSet<FSQRouteTrieNode *> *)activeNodes;
+
+/**
+ Returns a copy of this node where the node at the end of `tokens` has been replaced by the result of `update`.
+ Only the nodes between this one and the updated node are copied. Nodes left empty by the update are pruned.
+ 
+ @return The updated copy, or nil if `update` returned nil (meaning nothing needed to change).
+ */
+- (nullable FSQRouteTrieNode *)nodeByUpdatingNodeForTokens:(NSArray<FSQRouteUrlToken *> *)tokens
+                                                tokenIndex:(NSUInteger)tokenIndex
+                                                usingBlock:(FSQRouteTrieNode *_Nullable (^)(FSQRouteTrieNode *node))update;
+@end
+
+/**
+ A route map compiled into a trie.
+ 
+ Compiled maps are immutable once created. Adding, removing or replacing a route returns a new map which shares
+ all the untouched parts of the trie with this one, so the cost of an update depends on the route that changed
+ and not on the size of the map.
+ */
+@interface FSQCompiledRouteMap : NSObject
+@property (nonatomic, strong, readonly) FSQRouteTrieNode *trieRoot;
+@property (nonatomic, assign, readonly) NSUInteger numberOfRoutes;
+
+/**
+ How the map's static route components are compared with url path components. The static components in the trie
+ are already folded with these options, so matching only has to fold the url's path components (once per url).
+ */
+@property (nonatomic, assign, readonly) FSQRouteMatchingOptions options;
+
+/**
+ A snapshot of the string pool taken once the map's trie was built, so it has every string the map's routes use.
+ Urls are looked up in it when they are matched against the map, which keeps matching off the pool's lock. Reading
+ this builds the trie of a map created from compiled route map data.
+ */
+@property (nonatomic, strong, readonly) FSQRouteStringPoolSnapshot *stringPoolSnapshot;
+
+/**
+ The route index that the next added route will get.
+ */
+@property (nonatomic, assign, readonly) NSUInteger nextRouteIndex;
+
+/**
+ Builds a new map from a tokenized route map. Routes get indexes matching their position in the array.
+
+ A route whose tokens are NSNull keeps its index but is left out of the trie, so it never matches (like an empty
+ route string in compiled route map data).
+ */
+- (instancetype)initWithTokenizedRouteMap:(NSArray<NSArray *> *)tokenizedRouteMap;
+
+/**
+ Builds a new map from a tokenized route map whose routes were tokenized with `FSQTokenizedRouteStringWithOptions`
+ using the same options.
+ */
+- (instancetype)initWithTokenizedRouteMap:(NSArray<NSArray *> *)tokenizedRouteMap options:(FSQRouteMatchingOptions)options;
+
+/**
+ Creates a map from compiled route map data (see `+[FSQUrlRouter compiledRouteMapDataWithRouteStrings:]`).
+
+ Only the layout of the data is checked here. Strings, tokens and the trie are not created until the trie is first
+ needed, so registering a compiled map does no tokenization or trie building.
+
+ @param generators One generator per route in the data, in route index order, or nil to give every route NSNull
+                   as its generator.
+ @param options    The map's matching options. Static components in the data are folded when the trie is built.
+ */
+- (nullable instancetype)initWithCompiledRouteMapData:(NSData *)data
+                                           generators:(nullable NSArray *)generators
+                                              options:(FSQRouteMatchingOptions)options
+                                                error:(NSError **)error;
+
+- (FSQCompiledRouteMap *)routeMapByAddingRouteWithTokens:(NSArray<FSQRouteUrlToken *> *)tokens
+                                        contentGenerator:(id)contentGenerator;
+
+/**
+ @return A new map without any routes that have the given tokens, or nil if there were no such routes.
+ */
+- (nullable FSQCompiledRouteMap *)routeMapByRemovingRoutesWithTokens:(NSArray<FSQRouteUrlToken *> *)tokens;
+
+/**
+ @return A new map where the routes that have the given tokens use a new generator (keeping their precedence), 
+ or nil if there were no such routes.
+ */
+- (nullable FSQCompiledRouteMap *)routeMapByReplacingContentGenerator:(id)contentGenerator
+                                                   forRoutesWithTokens:(NSArray<FSQRouteUrlToken *> *)tokens;
+
+/**
+ @return YES if the map has a route with exactly the given tokens.
+ */
+- (BOOL)containsRouteWithTokens:(NSArray<FSQRouteUrlToken *> *)tokens;
+
+/**
+ Walks the trie with the string pool indexes of a url's path components and returns all routes that could match
+ them, in ascending route index order.
+ 
+ The walk keeps a set of active nodes and advances all of them together one path component at a time, so the cost
+ depends on the depth of the path and not on the number of routes in the map.
+
+ @param pathComponentIndexes The url's path component indexes, folded with the map's options.
+ @param parsedUrl            The url itself, which is only asked which of its path components are integers once the
+                             walk reaches an integer parameter edge.
+ */
+- (NSArray<FSQCompiledRoute *> *)routesMatchingPathComponentIndexes:(const uint32_t *)pathComponentIndexes
+                                                        ofParsedUrl:(FSQParsedRouteUrl *)parsedUrl;
+
+/**
+ Finds the route a url matches: of the routes whose tokens match the url's path, the one with the lowest index.
+ Routes with no tokens only match urls which have query parameters, so "scheme://?foo=bar" can be routed but
+ "scheme://" can't.
+
+ @param pathParameters      Set to the path parameters of the matching route. Query parameters are not included.
+ @param numberOfRoutesTried Set to the number of routes whose tokens were matched against the path.
+
+ @return The matching route, or nil if no route matched.
+ */
+- (nullable FSQCompiledRoute *)routeMatchingParsedUrl:(FSQParsedRouteUrl *)parsedUrl
+                                       pathParameters:(NSMutableDictionary<NSString *, NSString *> *_Nullable *_Nullable)pathParameters
+                                  numberOfRoutesTried:(nullable NSUInteger *)numberOfRoutesTried;
+
+/**
+ Finds every route a url matches, in ascending route index order, so the first one is the route that
+ `routeMatchingParsedUrl:pathParameters:numberOfRoutesTried:` picks. Routes with no tokens follow the same rule.
+
+ @param pathParameters Set to the path parameters of each matching route, in the same order as the routes.
+ */
+- (NSArray<FSQCompiledRoute *> *)routesMatchingParsedUrl:(FSQParsedRouteUrl *)parsedUrl
+                                          pathParameters:(NSArray<NSMutableDictionary<NSString *, NSString *> *> *_Nullable *_Nullable)pathParameters;
+
+/**
+ Analyzes every route in the map (see FSQRouteAnalysis). This walks the trie once per route, so it is meant to be
+ run after registration when checking a map, not on every launch.
+
+ @return One analysis per route, in ascending route index order.
+ */
+- (NSArray<FSQRouteAnalysis *> *)routeAnalyses;
+@end
+
+@interface FSQRouteAnalysis (Compiling)
+- (instancetype)initWithRouteIndex:(NSUInteger)routeIndex
+                       routeString:(NSString *)routeString
+               shadowingRouteIndex:(NSUInteger)shadowingRouteIndex
+                         redundant:(BOOL)redundant
+                    numberOfTokens:(NSUInteger)numberOfTokens
+        numberOfUnlimitedWildcards:(NSUInteger)numberOfUnlimitedWildcards;
+@end
+
+/**
+ An incoming url, parsed and normalized once per routing call so that every candidate route can be matched against
+ it without redoing that work.
+ */
+@interface FSQParsedRouteUrl : NSObject
+@property (nonatomic, strong, readonly) NSURL *url;
+@property (nonatomic, copy, readonly, nullable) NSString *scheme;
+@property (nonatomic, copy, readonly, nullable) NSString *host;
+
+/**
+ The url's host in lowercase, which is how universal link hosts are registered. Only lowercased the first time this
+ property is read.
+ */
+@property (nonatomic, copy, readonly, nullable) NSString *lowercaseHost;
+
+/**
+ NO if this is a universal link (https scheme), YES otherwise.
+ */
+@property (nonatomic, assign, readonly) BOOL isNativeScheme;
+
+/**
+ The unescaped path components of the url, with the host prepended for native scheme urls.
+ */
+@property (nonatomic, copy, readonly) NSArray<NSString *> *pathComponents;
+
+/**
+ The string pool index of each path component, or kFSQRouteStringNotInterned for components no route uses, looked
+ up in the pool's current snapshot.
+ */
+@property (nonatomic, assign, readonly) const uint32_t *pathComponentStringIndexes;
+
+/**
+ The string pool indexes of the path components after folding them with the given options, for matching against a
+ route map with those options.
+
+ Each set of options is only folded and looked up the first time it is asked for. The indexes are looked up again
+ only if a snapshot with more strings than the one they came from is passed in.
+
+ @param snapshot The snapshot of the route map the url will be matched against (see
+                 `FSQCompiledRouteMap.stringPoolSnapshot`).
+ */
+- (const uint32_t *)pathComponentStringIndexesWithOptions:(FSQRouteMatchingOptions)options
+                                       stringPoolSnapshot:(FSQRouteStringPoolSnapshot *)snapshot;
+
+/**
+ For each path component, YES if it is a decimal integer (see `FSQIntegerValueOfString`). These are only checked
+ the first time this property is read, which matching only does for route maps with integer parameters.
+ */
+@property (nonatomic, assign, readonly) const BOOL *integerPathComponents;
+
+/**
+ The labels of the url's host, lowercased and in reverse order (eg "com", "example", "www"). The host is only split
+ the first time this property is read, so urls whose host is registered exactly never pay for it.
+ */
+@property (nonatomic, copy, readonly) NSArray<NSString *> *reversedHostLabels;
+
+/**
+ The query items of the url, as NSURLComponents gives them (not unescaped with `FSQUnescapedString` yet). These are
+ only parsed the first time this property is read.
+ */
+@property (nonatomic, copy, readonly, nullable) NSArray<NSURLQueryItem *> *queryItems;
+
+/**
+ The unescaped query items of the url. These are only decoded the first time this property is read, so urls which
+ do not match any route never pay for it. The router doesn't read this, it hands `queryItems` to the url data which
+ only decodes the ones a content generator asks for.
+ */
+@property (nonatomic, copy, readonly) NSDictionary<NSString *, NSString *> *queryParameters;
+
+- (instancetype)initWithUrl:(NSURL *)url;
+@end
+
+/**
+ Unescapes a path component or query item the way urls are normalized for matching: plus signs become spaces and
+ percent escapes are removed.
+ */
+FOUNDATION_EXPORT NSString *_Nullable FSQUnescapedString(NSString *_Nullable string);
+
+/**
+ Parses a decimal integer: an optional minus sign followed by ASCII digits, with nothing else around them, which fits
+ in 64 bits. This is what an integer parameter (eg ":venueId<int>") matches.
+
+ @param value Set to the integer if the string is one. May be NULL.
+
+ @return YES if the string is a decimal integer.
+ */
+FOUNDATION_EXPORT BOOL FSQIntegerValueOfString(NSString *_Nullable string, int64_t *_Nullable value);
+
+/**
+ @return The path components with empty components and slashes removed, each one unescaped.
+ */
+FOUNDATION_EXPORT NSArray<NSString *> *FSQNormalizedPathComponents(NSArray<NSString *> *pathComponents);
+
+/**
+ @return The labels of the host, lowercased and in reverse order.
+ */
+FOUNDATION_EXPORT NSArray<NSString *> *FSQReversedHostLabels(NSString *host);
+
+/**
+ Folds a path component (or static route component) with the given matching options.
+
+ Most components are plain ASCII, which needs no Unicode normalization and only has its uppercase letters lowered,
+ so those skip Foundation's folding entirely and are returned as is when nothing changes.
+ */
+FOUNDATION_EXPORT NSString *FSQFoldedString(NSString *string, FSQRouteMatchingOptions options);
+
+/**
+ Splits a route string into tokens, interning its static components and parameter names in the shared string pool.
+ Parameters can be typed with a suffix, eg ":venueId<int>". `int` is the only type.
+ */
+FOUNDATION_EXPORT NSArray<FSQRouteUrlToken *> *FSQTokenizedRouteString(NSString *routeString);
+
+/**
+ Like `FSQTokenizedRouteString`, but with static components folded with the given options before they are
+ interned. Parameter names are never folded.
+ */
+FOUNDATION_EXPORT NSArray<FSQRouteUrlToken *> *FSQTokenizedRouteStringWithOptions(NSString *routeString,
+                                                                                  FSQRouteMatchingOptions options);
+
+/**
+ See `+[FSQUrlRouter compiledRouteMapDataWithRouteStrings:]`.
+ */
+FOUNDATION_EXPORT NSData *FSQCompiledRouteMapDataWithRouteStrings(NSArray<NSString *> *routeStrings);
+
+NS_ASSUME_NONNULL_END
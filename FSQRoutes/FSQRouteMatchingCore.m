@@ -0,0 +1,1817 @@
+//
+//  FSQRouteMatchingCore.m
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+#import "FSQRouteMatchingCore.h"
+
+#import "FSQRouteMatcher.h"
+
+#import <dispatch/dispatch.h>
+#import <pthread.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+NSString *_Nullable FSQUnescapedString(NSString *_Nullable string) {
+    static NSCharacterSet *escapeCharacters = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        escapeCharacters = [NSCharacterSet characterSetWithCharactersInString:@"+%"];
+    });
+    
+    /**
+     Most names and values have nothing to unescape, and those are returned as is without any copying.
+     */
+    if (string == nil
+        || [string rangeOfCharacterFromSet:escapeCharacters].location == NSNotFound) {
+        return string;
+    }
+    
+    NSMutableString *mutableString = [string mutableCopy];
+    [mutableString replaceOccurrencesOfString:@"+" 
+                                   withString:@" " 
+                                      options:NSLiteralSearch 
+                                        range:NSMakeRange(0, mutableString.length)];
+    
+    return [mutableString stringByRemovingPercentEncoding];
+}
+
+/**
+ The longest decimal representation of a 64 bit integer, "-9223372036854775808".
+ */
+static const NSUInteger kFSQMaximumIntegerStringLength = 20;
+
+BOOL FSQIntegerValueOfString(NSString *_Nullable string, int64_t *_Nullable value) {
+    NSUInteger length = string.length;
+    if (length == 0
+        || length > kFSQMaximumIntegerStringLength) {
+        return NO;
+    }
+    
+    unichar characters[kFSQMaximumIntegerStringLength];
+    [string getCharacters:characters range:NSMakeRange(0, length)];
+    
+    BOOL isNegative = (characters[0] == '-');
+    NSUInteger characterIndex = (isNegative ? 1 : 0);
+    if (characterIndex == length) {
+        return NO;
+    }
+    
+    /**
+     Accumulated as a positive number, with room for the magnitude of INT64_MIN.
+     */
+    uint64_t limit = (isNegative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX);
+    uint64_t magnitude = 0;
+    for (; characterIndex < length; characterIndex++) {
+        unichar character = characters[characterIndex];
+        if (character < '0' || character > '9') {
+            return NO;
+        }
+        
+        uint64_t digit = (uint64_t)(character - '0');
+        if (magnitude > (limit - digit) / 10) {
+            return NO;
+        }
+        magnitude = magnitude * 10 + digit;
+    }
+    
+    if (value != NULL) {
+        *value = (isNegative ? (int64_t)(0 - magnitude) : (int64_t)magnitude);
+    }
+    return YES;
+}
+
+NSArray<NSString *> *FSQNormalizedPathComponents(NSArray<NSString *> *pathComponents) {
+    NSMutableArray<NSString *> *normalizedComponents = [NSMutableArray new];
+    for (NSString *component in pathComponents) {
+        if (component.length > 0
+            && ![component isEqualToString:@"/"]) {
+            [normalizedComponents addObject:FSQUnescapedString(component)];
+        }
+    }
+    return normalizedComponents.copy;
+}
+
+NSArray<NSString *> *FSQReversedHostLabels(NSString *host) {
+    NSArray<NSString *> *labels = [host.lowercaseString componentsSeparatedByString:@"."];
+    return labels.reverseObjectEnumerator.allObjects;
+}
+
+/**
+ Path components longer than this are folded without the ASCII fast path.
+ */
+static const NSUInteger kFSQMaximumFastFoldedStringLength = 64;
+
+NSString *FSQFoldedString(NSString *string, FSQRouteMatchingOptions options) {
+    NSUInteger length = string.length;
+    if (options == FSQRouteMatchingOptionsNone
+        || length == 0) {
+        return string;
+    }
+    
+    if (length <= kFSQMaximumFastFoldedStringLength) {
+        unichar characters[kFSQMaximumFastFoldedStringLength];
+        [string getCharacters:characters range:NSMakeRange(0, length)];
+        
+        BOOL isAscii = YES;
+        BOOL hasUppercase = NO;
+        for (NSUInteger characterIndex = 0; characterIndex < length; characterIndex++) {
+            unichar character = characters[characterIndex];
+            if (character >= 0x80) {
+                isAscii = NO;
+                break;
+            }
+            if (character >= 'A' && character <= 'Z') {
+                hasUppercase = YES;
+            }
+        }
+        
+        if (isAscii) {
+            /**
+             ASCII is always in normalization form C, so case is the only thing left to fold.
+             */
+            if (!hasUppercase
+                || !(options & FSQRouteMatchingOptionsCaseInsensitive)) {
+                return string;
+            }
+            
+            for (NSUInteger characterIndex = 0; characterIndex < length; characterIndex++) {
+                if (characters[characterIndex] >= 'A' && characters[characterIndex] <= 'Z') {
+                    characters[characterIndex] += 'a' - 'A';
+                }
+            }
+            return [[NSString alloc] initWithCharacters:characters length:length];
+        }
+    }
+    
+    NSString *foldedString = string;
+    if (options & FSQRouteMatchingOptionsCaseInsensitive) {
+        foldedString = [foldedString stringByFoldingWithOptions:NSCaseInsensitiveSearch locale:nil];
+    }
+    if (options & FSQRouteMatchingOptionsUnicodeNormalized) {
+        foldedString = [foldedString precomposedStringWithCanonicalMapping];
+    }
+    return foldedString;
+}
+
+NSString *const FSQUrlRouterErrorDomain = @"FSQUrlRouterErrorDomain";
+
+/**
+ Compiled route map data is a flat little endian blob of uint32_t values, laid out as:
+
+ Header:      magic, version, number of routes, number of tokens, number of strings, string data length
+ Routes:      (index of first token, number of tokens) for each route, in route index order. A route which can
+              never match is written as (UINT32_MAX, 0).
+ Tokens:      (token type, string index) for each token. Wildcard tokens have no string.
+ Strings:     (offset, length) into the string data for each distinct string
+ String data: The UTF-8 bytes of every string, already normalized and unescaped
+
+ Everything is fixed size, so the data can be memory mapped and read in place without any parsing.
+ */
+static const uint32_t kFSQCompiledRouteMapMagic = 0x52515346; // "FSQR"
+static const uint32_t kFSQCompiledRouteMapVersion = 1;
+static const uint32_t kFSQCompiledRouteMapNoString = UINT32_MAX;
+static const uint32_t kFSQCompiledRouteMapNeverMatchingRoute = UINT32_MAX;
+static const NSUInteger kFSQCompiledRouteMapHeaderCount = 6;
+
+typedef struct {
+    uint32_t numberOfRoutes;
+    uint32_t numberOfTokens;
+    uint32_t numberOfStrings;
+    uint32_t stringDataLength;
+    const uint32_t *routes;
+    const uint32_t *tokens;
+    const uint32_t *strings;
+    const uint8_t *stringData;
+} FSQCompiledRouteMapLayout;
+
+static inline uint32_t FSQReadLittleEndian(uint32_t value) {
+    return NSSwapLittleIntToHost(value);
+}
+
+static void FSQAppendLittleEndian(NSMutableData *data, uint32_t value) {
+    uint32_t littleEndianValue = NSSwapHostIntToLittle(value);
+    [data appendBytes:&littleEndianValue length:sizeof(littleEndianValue)];
+}
+
+/**
+ Reads the header of compiled route map data and checks that every table and every index in them is in bounds,
+ so the data can be read later without any further checks.
+
+ @return NO if the data is not valid compiled route map data for this version.
+ */
+static BOOL FSQReadCompiledRouteMapLayout(NSData *data, FSQCompiledRouteMapLayout *layout) {
+    const uint32_t *header = data.bytes;
+    uint64_t length = data.length;
+    
+    if (length < kFSQCompiledRouteMapHeaderCount * sizeof(uint32_t)
+        || ((uintptr_t)header % sizeof(uint32_t)) != 0
+        || FSQReadLittleEndian(header[0]) != kFSQCompiledRouteMapMagic
+        || FSQReadLittleEndian(header[1]) != kFSQCompiledRouteMapVersion) {
+        return NO;
+    }
+    
+    layout->numberOfRoutes = FSQReadLittleEndian(header[2]);
+    layout->numberOfTokens = FSQReadLittleEndian(header[3]);
+    layout->numberOfStrings = FSQReadLittleEndian(header[4]);
+    layout->stringDataLength = FSQReadLittleEndian(header[5]);
+    
+    uint64_t expectedLength = (kFSQCompiledRouteMapHeaderCount
+                               + 2 * (uint64_t)layout->numberOfRoutes
+                               + 2 * (uint64_t)layout->numberOfTokens
+                               + 2 * (uint64_t)layout->numberOfStrings) * sizeof(uint32_t)
+                              + layout->stringDataLength;
+    if (length != expectedLength) {
+        return NO;
+    }
+    
+    layout->routes = header + kFSQCompiledRouteMapHeaderCount;
+    layout->tokens = layout->routes + 2 * (NSUInteger)layout->numberOfRoutes;
+    layout->strings = layout->tokens + 2 * (NSUInteger)layout->numberOfTokens;
+    layout->stringData = (const uint8_t *)(layout->strings + 2 * (NSUInteger)layout->numberOfStrings);
+    
+    for (uint32_t routeIndex = 0; routeIndex < layout->numberOfRoutes; routeIndex++) {
+        uint32_t firstTokenIndex = FSQReadLittleEndian(layout->routes[routeIndex * 2]);
+        uint32_t numberOfTokens = FSQReadLittleEndian(layout->routes[routeIndex * 2 + 1]);
+        if (firstTokenIndex == kFSQCompiledRouteMapNeverMatchingRoute
+            && numberOfTokens == 0) {
+            continue;
+        }
+        if ((uint64_t)firstTokenIndex + numberOfTokens > layout->numberOfTokens) {
+            return NO;
+        }
+    }
+    
+    for (uint32_t tokenIndex = 0; tokenIndex < layout->numberOfTokens; tokenIndex++) {
+        uint32_t type = FSQReadLittleEndian(layout->tokens[tokenIndex * 2]);
+        uint32_t stringIndex = FSQReadLittleEndian(layout->tokens[tokenIndex * 2 + 1]);
+        
+        if (type == FSQRouteUrlTokenTypeString
+            || FSQRouteUrlTokenTypeIsParameter(type)) {
+            if (stringIndex >= layout->numberOfStrings) {
+                return NO;
+            }
+        }
+        else if (type != FSQRouteUrlTokenTypeSingleComponentWildcard
+                 && type != FSQRouteUrlTokenTypeUnlimitedComponentWildcard) {
+            return NO;
+        }
+    }
+    
+    for (uint32_t stringIndex = 0; stringIndex < layout->numberOfStrings; stringIndex++) {
+        uint64_t endOffset = (uint64_t)FSQReadLittleEndian(layout->strings[stringIndex * 2])
+                             + FSQReadLittleEndian(layout->strings[stringIndex * 2 + 1]);
+        if (endOffset > layout->stringDataLength) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+/**
+ Makes the token for a parameter component (without its colon), which may end with a type, eg "venueId<int>".
+ Unknown types assert and leave the whole component as the name of an untyped parameter.
+ */
+static FSQRouteUrlToken *FSQParameterToken(NSString *component, NSString *urlString) {
+    NSRange typeRange = [component rangeOfString:@"<"];
+    if (![component hasSuffix:@">"]
+        || typeRange.location == NSNotFound
+        || typeRange.location == 0) {
+        return [FSQRouteUrlToken withParameterName:component];
+    }
+    
+    NSString *parameterName = [component substringToIndex:typeRange.location];
+    NSString *typeName = [component substringWithRange:NSMakeRange(typeRange.location + 1,
+                                                                   component.length - typeRange.location - 2)];
+    if ([typeName isEqualToString:@"int"]) {
+        return [FSQRouteUrlToken withIntegerParameterName:parameterName];
+    }
+    
+    NSCAssert(0, @"Unknown parameter type <%@> in route. path = %@", typeName, urlString);
+    return [FSQRouteUrlToken withParameterName:component];
+}
+
+NSArray<FSQRouteUrlToken *> *FSQTokenizedRouteString(NSString *urlString) {
+    return FSQTokenizedRouteStringWithOptions(urlString, FSQRouteMatchingOptionsNone);
+}
+
+NSArray<FSQRouteUrlToken *> *FSQTokenizedRouteStringWithOptions(NSString *urlString, FSQRouteMatchingOptions options) {
+    NSMutableArray<FSQRouteUrlToken *> *tokenizedURL = [NSMutableArray new];
+    
+    FSQRouteUrlToken *lastAddedToken = nil;
+    
+    NSArray *pathComponents = FSQNormalizedPathComponents([urlString pathComponents]);
+    for (NSString *string in pathComponents) {
+        FSQRouteUrlToken *token = nil;
+        if ([string isEqualToString:@"*"]) {
+            token = [FSQRouteUrlToken singleComponentWildCard];
+        }
+        else if ([string isEqualToString:@"**"]) {
+            if (lastAddedToken.type == FSQRouteUrlTokenTypeUnlimitedComponentWildcard) {
+                /**
+                 Don't add a multiple unlimited wildcards in a row because it is redundant
+                 */
+            }
+            else if (FSQRouteUrlTokenTypeIsParameter(lastAddedToken.type)) {
+                /**
+                 We shouldn't completely wrap a parameter token with unlimited wildcard tokens, because parsing
+                 that is ambigious. eg matching against @"/ ** / :aParameter / ** /" can't work because we
+                 won't know which path component the parameter should match to.
+                 
+                 If we think we might be in this case, do some checking to see if we are surrounding a 
+                 parameter token and if we are, assert and skip adding this route.
+                 
+                 There are other ambiguous cases, but we won't bother trying to catch them all.
+                 */
+                
+                NSUInteger possibleOtherWildcardIndex = tokenizedURL.count - 2;
+                if (possibleOtherWildcardIndex > 0) {
+                    if (tokenizedURL[possibleOtherWildcardIndex].type == FSQRouteUrlTokenTypeUnlimitedComponentWildcard) {
+                        NSCAssert(0, @"Tried to add a route where a parameter component was surrounded by "
+                                  @"unlimited wildcard components. path = %@", urlString);
+                        continue;
+                    }
+                }
+                
+                /**
+                 If we made it through the above check without continue'ing, then we are fine.
+                 */
+                token = [FSQRouteUrlToken unlimitedComponentWildCard];
+            }
+            else {
+                token = [FSQRouteUrlToken unlimitedComponentWildCard];
+            }
+        }
+        else if ([string hasPrefix:@":"]
+                 && string.length > 1) {
+            token = FSQParameterToken([string substringFromIndex:1], urlString);
+        }
+        else if (string.length > 0) {
+            token = [FSQRouteUrlToken withString:FSQFoldedString(string, options)];
+        }
+        
+        if (token != nil) {
+            lastAddedToken = token;
+            [tokenizedURL addObject:token];                
+        }
+    }
+    
+    return [tokenizedURL copy];
+    
+}
+
+NSData *FSQCompiledRouteMapDataWithRouteStrings(NSArray<NSString *> *routeStrings) {
+    NSMutableDictionary<NSString *, NSNumber *> *stringIndexes = [NSMutableDictionary new];
+    NSMutableData *routeTable = [NSMutableData new];
+    NSMutableData *tokenTable = [NSMutableData new];
+    NSMutableData *stringTable = [NSMutableData new];
+    NSMutableData *stringData = [NSMutableData new];
+    uint32_t numberOfTokens = 0;
+    
+    for (NSString *routeString in routeStrings) {
+        /**
+         Unlike route maps, empty route strings are kept (as routes which can never match) so that route indexes
+         keep lining up with the generators passed in at registration. They can't be written as routes with no
+         tokens, since those match the root url.
+         */
+        if (routeString.length == 0) {
+            FSQAppendLittleEndian(routeTable, kFSQCompiledRouteMapNeverMatchingRoute);
+            FSQAppendLittleEndian(routeTable, 0);
+            continue;
+        }
+        
+        NSArray<FSQRouteUrlToken *> *tokens = FSQTokenizedRouteString(routeString);
+        
+        FSQAppendLittleEndian(routeTable, numberOfTokens);
+        FSQAppendLittleEndian(routeTable, (uint32_t)tokens.count);
+        
+        for (FSQRouteUrlToken *token in tokens) {
+            uint32_t stringIndex = kFSQCompiledRouteMapNoString;
+            NSString *string = token.stringOrParameterName;
+            
+            if (string != nil) {
+                NSNumber *existingIndex = stringIndexes[string];
+                if (existingIndex == nil) {
+                    NSData *utf8Data = [string dataUsingEncoding:NSUTF8StringEncoding];
+                    existingIndex = @(stringIndexes.count);
+                    stringIndexes[string] = existingIndex;
+                    
+                    FSQAppendLittleEndian(stringTable, (uint32_t)stringData.length);
+                    FSQAppendLittleEndian(stringTable, (uint32_t)utf8Data.length);
+                    [stringData appendData:utf8Data];
+                }
+                stringIndex = existingIndex.unsignedIntValue;
+            }
+            
+            FSQAppendLittleEndian(tokenTable, (uint32_t)token.type);
+            FSQAppendLittleEndian(tokenTable, stringIndex);
+            numberOfTokens++;
+        }
+    }
+    
+    NSMutableData *data = [NSMutableData new];
+    FSQAppendLittleEndian(data, kFSQCompiledRouteMapMagic);
+    FSQAppendLittleEndian(data, kFSQCompiledRouteMapVersion);
+    FSQAppendLittleEndian(data, (uint32_t)routeStrings.count);
+    FSQAppendLittleEndian(data, numberOfTokens);
+    FSQAppendLittleEndian(data, (uint32_t)stringIndexes.count);
+    FSQAppendLittleEndian(data, (uint32_t)stringData.length);
+    [data appendData:routeTable];
+    [data appendData:tokenTable];
+    [data appendData:stringTable];
+    [data appendData:stringData];
+    
+    return [data copy];
+}
+
+
+@implementation FSQRouteUrlToken
+
++ (instancetype)withType:(FSQRouteUrlTokenType)type internedString:(nullable NSString *)string {
+    FSQRouteUrlToken *token = [self new];
+    token->_type = type;
+    
+    if (string != nil) {
+        FSQRouteStringPool *stringPool = [FSQRouteStringPool sharedPool];
+        token->_stringIndex = [stringPool indexForInterningString:string];
+        token->_stringOrParameterName = [stringPool stringAtIndex:token->_stringIndex];
+    }
+    else {
+        token->_stringIndex = kFSQRouteStringNotInterned;
+    }
+    
+    return token;
+}
+
++ (instancetype)withString:(NSString *)string {
+    return [self withType:FSQRouteUrlTokenTypeString internedString:string];
+}
+
++ (instancetype)withParameterName:(NSString *)parameterName {
+    return [self withType:FSQRouteUrlTokenTypeParameter internedString:parameterName];
+}
+
++ (instancetype)withIntegerParameterName:(NSString *)parameterName {
+    return [self withType:FSQRouteUrlTokenTypeIntegerParameter internedString:parameterName];
+}
+
++ (instancetype)singleComponentWildCard {
+    static FSQRouteUrlToken *token;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        token = [self withType:FSQRouteUrlTokenTypeSingleComponentWildcard internedString:nil];
+    });
+    
+    return token;
+}
+
++ (instancetype)unlimitedComponentWildCard {
+    static FSQRouteUrlToken *token;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        token = [self withType:FSQRouteUrlTokenTypeUnlimitedComponentWildcard internedString:nil];
+    });
+    
+    return token;
+}
+
+- (NSString *)stringForType:(FSQRouteUrlTokenType)type {
+    switch (type) {
+        case FSQRouteUrlTokenTypeString:
+            return @"string";
+        case FSQRouteUrlTokenTypeParameter:
+            return @"parameter";
+        case FSQRouteUrlTokenTypeSingleComponentWildcard:
+            return @"*";
+        case FSQRouteUrlTokenTypeUnlimitedComponentWildcard:
+            return  @"**";
+        case FSQRouteUrlTokenTypeIntegerParameter:
+            return @"integer parameter";
+    }
+}
+
+- (NSString *)debugDescription {
+    return [NSString stringWithFormat:@"%@, (%@)", [self stringForType:self.type], self.stringOrParameterName];
+}
+
+- (BOOL)isEqual:(id)object {
+    if (object == self) {
+        return YES;
+    }
+    if (![object isKindOfClass:[FSQRouteUrlToken class]]) {
+        return NO;
+    }
+    
+    FSQRouteUrlToken *token = object;
+    return (token.type == self.type
+            && token.stringIndex == self.stringIndex);
+}
+
+- (NSUInteger)hash {
+    return ((NSUInteger)self.stringIndex << 2) ^ (NSUInteger)self.type;
+}
+
+@end
+
+
+@implementation FSQRouteStringPoolSnapshot {
+    NSDictionary<NSString *, NSNumber *> *_indexesByString;
+}
+
+- (instancetype)initWithIndexesByString:(NSDictionary<NSString *, NSNumber *> *)indexesByString {
+    self = [super init];
+    if (self) {
+        _indexesByString = indexesByString;
+        _count = indexesByString.count;
+    }
+    return self;
+}
+
+- (void)getIndexes:(uint32_t *)indexes ofStrings:(NSArray<NSString *> *)strings {
+    NSUInteger i = 0;
+    for (NSString *string in strings) {
+        NSNumber *index = _indexesByString[string];
+        indexes[i++] = (index != nil) ? index.unsignedIntValue : kFSQRouteStringNotInterned;
+    }
+}
+
+@end
+
+
+@implementation FSQRouteStringPool {
+    /**
+     Only registration uses the pool directly (matching uses snapshots), so the read-write lock is just there to let
+     routes registered on different threads find strings that are already interned at the same time.
+     */
+    pthread_rwlock_t _lock;
+    NSMutableDictionary<NSString *, NSNumber *> *_indexesByString;
+    NSMutableArray<NSString *> *_strings;
+    
+    /**
+     Nil whenever a string has been interned since the last snapshot was taken.
+     */
+    FSQRouteStringPoolSnapshot *_snapshot;
+}
+
++ (instancetype)sharedPool {
+    static FSQRouteStringPool *sharedPool;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedPool = [self new];
+    });
+    
+    return sharedPool;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        pthread_rwlock_init(&_lock, NULL);
+        _indexesByString = [NSMutableDictionary new];
+        _strings = [NSMutableArray new];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    pthread_rwlock_destroy(&_lock);
+}
+
+- (uint32_t)indexForInterningString:(NSString *)string {
+    pthread_rwlock_rdlock(&_lock);
+    NSNumber *index = _indexesByString[string];
+    pthread_rwlock_unlock(&_lock);
+    
+    if (index == nil) {
+        pthread_rwlock_wrlock(&_lock);
+        index = _indexesByString[string];
+        if (index == nil) {
+            NSAssert(_strings.count < kFSQRouteStringNotInterned, @"Route string pool is full");
+            NSString *internedString = [string copy];
+            index = @(_strings.count);
+            [_strings addObject:internedString];
+            _indexesByString[internedString] = index;
+            _snapshot = nil;
+        }
+        pthread_rwlock_unlock(&_lock);
+    }
+    
+    return index.unsignedIntValue;
+}
+
+- (NSUInteger)count {
+    pthread_rwlock_rdlock(&_lock);
+    NSUInteger count = _strings.count;
+    pthread_rwlock_unlock(&_lock);
+    return count;
+}
+
+- (NSString *)stringAtIndex:(uint32_t)index {
+    pthread_rwlock_rdlock(&_lock);
+    NSString *string = _strings[index];
+    pthread_rwlock_unlock(&_lock);
+    return string;
+}
+
+- (FSQRouteStringPoolSnapshot *)snapshot {
+    /**
+     Taking a snapshot copies the whole index, so it takes the write lock to make sure only one copy is made for
+     each new set of strings. This only happens when a route map is built, never while matching.
+     */
+    pthread_rwlock_wrlock(&_lock);
+    if (_snapshot == nil) {
+        _snapshot = [[FSQRouteStringPoolSnapshot alloc] initWithIndexesByString:[_indexesByString copy]];
+    }
+    FSQRouteStringPoolSnapshot *snapshot = _snapshot;
+    pthread_rwlock_unlock(&_lock);
+    return snapshot;
+}
+
+@end
+
+
+/**
+ The number of distinct sets of FSQRouteMatchingOptions.
+ */
+static const NSUInteger kFSQRouteMatchingOptionsCount = 4;
+
+@implementation FSQParsedRouteUrl {
+    NSURLComponents *_urlComponents;
+    
+    /**
+     Indexed by options. Index 0 (no options) is the unfolded `pathComponentStringIndexes`.
+     */
+    uint32_t *_pathComponentStringIndexes[kFSQRouteMatchingOptionsCount];
+    
+    /**
+     The count of the snapshot each entry of `_pathComponentStringIndexes` was looked up in.
+     */
+    NSUInteger _pathComponentStringPoolCounts[kFSQRouteMatchingOptionsCount];
+    BOOL *_integerPathComponents;
+    BOOL _hasParsedQueryItems;
+}
+
+@synthesize lowercaseHost = _lowercaseHost;
+@synthesize reversedHostLabels = _reversedHostLabels;
+@synthesize queryItems = _queryItems;
+@synthesize queryParameters = _queryParameters;
+
+- (instancetype)initWithUrl:(NSURL *)url {
+    self = [super init];
+    if (self) {
+        _url = url;
+        _scheme = [url.scheme copy];
+        _host = [url.host copy];
+        _isNativeScheme = ![_scheme isEqualToString:@"https"];
+        _urlComponents = [[NSURLComponents alloc] initWithURL:url resolvingAgainstBaseURL:YES];
+        
+        NSArray<NSString *> *pathComponents = [_urlComponents.path pathComponents];
+        
+        if (![_urlComponents.scheme isEqualToString:@"https"]
+            && _urlComponents.host.length > 0) {
+            pathComponents = [@[_urlComponents.host] arrayByAddingObjectsFromArray:pathComponents];
+        }
+        
+        _pathComponents = FSQNormalizedPathComponents(pathComponents);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    for (NSUInteger optionsIndex = 0; optionsIndex < kFSQRouteMatchingOptionsCount; optionsIndex++) {
+        free(_pathComponentStringIndexes[optionsIndex]);
+    }
+    free(_integerPathComponents);
+}
+
+- (const uint32_t *)pathComponentStringIndexes {
+    return [self pathComponentStringIndexesWithOptions:FSQRouteMatchingOptionsNone
+                                    stringPoolSnapshot:[FSQRouteStringPool sharedPool].snapshot];
+}
+
+- (const uint32_t *)pathComponentStringIndexesWithOptions:(FSQRouteMatchingOptions)options
+                                       stringPoolSnapshot:(FSQRouteStringPoolSnapshot *)snapshot {
+    NSUInteger optionsIndex = options & (kFSQRouteMatchingOptionsCount - 1);
+    
+    /**
+     The pool only grows and indexes never change, so indexes looked up in a snapshot at least as large as this one
+     are still right for it.
+     */
+    if (_pathComponentStringIndexes[optionsIndex] == NULL
+        || _pathComponentStringPoolCounts[optionsIndex] < snapshot.count) {
+        NSArray<NSString *> *pathComponents = _pathComponents;
+        if (optionsIndex != FSQRouteMatchingOptionsNone) {
+            NSMutableArray<NSString *> *foldedPathComponents = [NSMutableArray arrayWithCapacity:pathComponents.count];
+            for (NSString *pathComponent in pathComponents) {
+                [foldedPathComponents addObject:FSQFoldedString(pathComponent, optionsIndex)];
+            }
+            pathComponents = foldedPathComponents;
+        }
+        
+        if (_pathComponentStringIndexes[optionsIndex] == NULL) {
+            _pathComponentStringIndexes[optionsIndex] = malloc(MAX(pathComponents.count, (NSUInteger)1) * sizeof(uint32_t));
+        }
+        [snapshot getIndexes:_pathComponentStringIndexes[optionsIndex] ofStrings:pathComponents];
+        _pathComponentStringPoolCounts[optionsIndex] = snapshot.count;
+    }
+    return _pathComponentStringIndexes[optionsIndex];
+}
+
+- (const BOOL *)integerPathComponents {
+    if (_integerPathComponents == NULL) {
+        _integerPathComponents = malloc(MAX(_pathComponents.count, (NSUInteger)1) * sizeof(BOOL));
+        
+        NSUInteger pathIndex = 0;
+        for (NSString *pathComponent in _pathComponents) {
+            _integerPathComponents[pathIndex++] = FSQIntegerValueOfString(pathComponent, NULL);
+        }
+    }
+    return _integerPathComponents;
+}
+
+- (nullable NSString *)lowercaseHost {
+    if (_lowercaseHost == nil) {
+        _lowercaseHost = _host.lowercaseString;
+    }
+    return _lowercaseHost;
+}
+
+- (NSArray<NSString *> *)reversedHostLabels {
+    if (_reversedHostLabels == nil) {
+        _reversedHostLabels = FSQReversedHostLabels(self.lowercaseHost ?: @"");
+    }
+    return _reversedHostLabels;
+}
+
+- (nullable NSArray<NSURLQueryItem *> *)queryItems {
+    if (!_hasParsedQueryItems) {
+        _queryItems = _urlComponents.queryItems;
+        _hasParsedQueryItems = YES;
+    }
+    return _queryItems;
+}
+
+- (NSDictionary<NSString *, NSString *> *)queryParameters {
+    if (_queryParameters == nil) {
+        NSMutableDictionary<NSString *, NSString *> *mutableParameters = [NSMutableDictionary new];
+        
+        for (NSURLQueryItem *item in self.queryItems) {
+            mutableParameters[FSQUnescapedString(item.name)] = FSQUnescapedString(item.value);
+        }
+        
+        _queryParameters = mutableParameters.copy;
+    }
+    return _queryParameters;
+}
+
+@end
+
+
+/**
+ Routes with more tokens than this need a heap buffer for their capture ranges.
+ */
+static const NSUInteger kFSQStackCaptureRangeCount = 32;
+
+@interface FSQCompiledRoute ()
+- (BOOL)matchPathComponentIndexes:(const uint32_t *)urlPathComponentIndexes
+                      ofParsedUrl:(FSQParsedRouteUrl *)parsedUrl
+                    captureRanges:(NSRange *)captureRanges;
+- (NSMutableDictionary<NSString *, NSString *> *)parametersForUrlPathComponents:(NSArray<NSString *> *)urlPathComponents
+                                                                  captureRanges:(const NSRange *)captureRanges;
+@end
+
+@implementation FSQCompiledRoute {
+    /**
+     The string indexes come first in the allocation so they stay aligned, followed by the type bytes.
+     */
+    uint32_t *_tokenStorage;
+}
+
+- (instancetype)initWithNumberOfTokens:(NSUInteger)numberOfTokens
+                      contentGenerator:(id)contentGenerator
+                            routeIndex:(NSUInteger)routeIndex {
+    self = [super init];
+    if (self) {
+        _numberOfTokens = numberOfTokens;
+        _contentGenerator = contentGenerator;
+        _routeIndex = routeIndex;
+        
+        if (numberOfTokens > 0) {
+            _tokenStorage = malloc(numberOfTokens * (sizeof(uint32_t) + sizeof(uint8_t)));
+            _tokenStringIndexes = _tokenStorage;
+            _tokenTypes = (const uint8_t *)(_tokenStorage + numberOfTokens);
+        }
+    }
+    return self;
+}
+
+- (instancetype)initWithTokens:(NSArray<FSQRouteUrlToken *> *)tokens
+              contentGenerator:(id)contentGenerator
+                    routeIndex:(NSUInteger)routeIndex {
+    self = [self initWithNumberOfTokens:tokens.count contentGenerator:contentGenerator routeIndex:routeIndex];
+    if (self) {
+        uint8_t *tokenTypes = (uint8_t *)_tokenTypes;
+        
+        NSMutableArray<NSString *> *parameterNames = [NSMutableArray new];
+        
+        for (NSUInteger tokenIndex = 0; tokenIndex < _numberOfTokens; tokenIndex++) {
+            FSQRouteUrlToken *token = tokens[tokenIndex];
+            tokenTypes[tokenIndex] = (uint8_t)token.type;
+            _tokenStorage[tokenIndex] = token.stringIndex;
+            
+            if (FSQRouteUrlTokenTypeIsParameter(token.type)) {
+                [parameterNames addObject:token.stringOrParameterName];
+            }
+        }
+        
+        _parameterNames = [parameterNames copy];
+    }
+    return self;
+}
+
+- (instancetype)initWithRoute:(FSQCompiledRoute *)route contentGenerator:(id)contentGenerator {
+    self = [self initWithNumberOfTokens:route.numberOfTokens contentGenerator:contentGenerator routeIndex:route.routeIndex];
+    if (self) {
+        if (_numberOfTokens > 0) {
+            memcpy(_tokenStorage, route->_tokenStorage, _numberOfTokens * (sizeof(uint32_t) + sizeof(uint8_t)));
+        }
+        _parameterNames = route.parameterNames;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    free(_tokenStorage);
+}
+
+- (BOOL)hasTokens:(NSArray<FSQRouteUrlToken *> *)tokens {
+    if (tokens.count != _numberOfTokens) {
+        return NO;
+    }
+    
+    for (NSUInteger tokenIndex = 0; tokenIndex < _numberOfTokens; tokenIndex++) {
+        FSQRouteUrlToken *token = tokens[tokenIndex];
+        if (token.type != _tokenTypes[tokenIndex]
+            || token.stringIndex != _tokenStringIndexes[tokenIndex]) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+- (nullable NSMutableDictionary<NSString *, NSString *> *)pathParametersForParsedUrl:(FSQParsedRouteUrl *)parsedUrl {
+    NSRange stackCaptureRanges[kFSQStackCaptureRangeCount];
+    NSRange *captureRanges = (_numberOfTokens <= kFSQStackCaptureRangeCount) ? stackCaptureRanges : malloc(_numberOfTokens * sizeof(NSRange));
+    
+    NSMutableDictionary<NSString *, NSString *> *parameters = nil;
+    if ([self matchPathComponentIndexes:parsedUrl.pathComponentStringIndexes
+                            ofParsedUrl:parsedUrl
+                          captureRanges:captureRanges]) {
+        parameters = [self parametersForUrlPathComponents:parsedUrl.pathComponents captureRanges:captureRanges];
+    }
+    
+    if (captureRanges != stackCaptureRanges) {
+        free(captureRanges);
+    }
+    
+    return parameters;
+}
+
+/**
+ Matches a url's path components (given as string pool indexes) against the route's tokens. If they match, the range
+ of path components consumed by each token is written to `captureRanges` (which must have room for one range per
+ token).
+ 
+ Unlimited wildcards are the only tokens which can match a variable number of components, so instead of searching
+ forwards and backwards from each possible split we fill in a table where `suffixMatches[t][p]` says whether
+ `tokens[t...]` can match `urlPathComponents[p...]`. It is built back to front in one pass, so the cost is linear in 
+ the number of path components times the number of tokens, with no recursion.
+ 
+ Once we know the url matches, we walk forward through the tokens to record what each one consumed. Wildcards are left-weighted:
+ each unlimited wildcard swallows as few components as possible while still letting the rest of the route match.
+ 
+ Examples:
+ 
+ "/ ** / b / :param / ** /" matched against "urlscheme://b/a/b/c" gives param = "a"
+ "/ ** / :param / a / b / ** /" matched against "urlscheme://d/c/a/b/a/b" gives param = "c"
+ "/ ** / :param /" matched against "urlscheme://a/b/c/d" gives param = "d"
+ 
+ Nothing is allocated here unless the table doesn't fit on the stack, so candidate routes which fail to match 
+ cost no allocations. Parameters are only turned into strings in a dictionary for the route that wins.
+
+ `urlPathComponentIndexes` are the url's path components folded with the options of the route's map. The parsed url
+ is only asked which of its components are integers if the route has an integer parameter.
+ */
+- (BOOL)matchPathComponentIndexes:(const uint32_t *)urlPathComponentIndexes
+                      ofParsedUrl:(FSQParsedRouteUrl *)parsedUrl
+                    captureRanges:(NSRange *)captureRanges {
+    
+    NSUInteger numberOfUrlPathComponents = parsedUrl.pathComponents.count;
+    NSUInteger numberOfTokens = _numberOfTokens;
+    const uint8_t *tokenTypes = _tokenTypes;
+    const uint32_t *tokenStringIndexes = _tokenStringIndexes;
+    NSUInteger rowLength = numberOfUrlPathComponents + 1;
+    NSUInteger tableSize = (numberOfTokens + 1) * rowLength;
+    
+    /**
+     Almost every real url/route pair fits in the stack buffer.
+     */
+    BOOL stackTable[256];
+    BOOL *suffixMatches = (tableSize <= sizeof(stackTable) / sizeof(BOOL)) ? stackTable : malloc(tableSize * sizeof(BOOL));
+    
+    /**
+     With no tokens left, we only match if there are also no path components left.
+     */
+    BOOL *lastRow = suffixMatches + numberOfTokens * rowLength;
+    for (NSUInteger pathIndex = 0; pathIndex <= numberOfUrlPathComponents; pathIndex++) {
+        lastRow[pathIndex] = (pathIndex == numberOfUrlPathComponents);
+    }
+    
+    for (NSInteger tokenIndex = (NSInteger)numberOfTokens - 1; tokenIndex >= 0; tokenIndex--) {
+        FSQRouteUrlTokenType tokenType = tokenTypes[tokenIndex];
+        uint32_t tokenStringIndex = tokenStringIndexes[tokenIndex];
+        BOOL *row = suffixMatches + tokenIndex * rowLength;
+        BOOL *nextRow = row + rowLength;
+        
+        if (tokenType == FSQRouteUrlTokenTypeUnlimitedComponentWildcard) {
+            /**
+             Either the wildcard matches zero components here, or it swallows this component and we try again 
+             from the next one.
+             */
+            row[numberOfUrlPathComponents] = nextRow[numberOfUrlPathComponents];
+            for (NSInteger pathIndex = (NSInteger)numberOfUrlPathComponents - 1; pathIndex >= 0; pathIndex--) {
+                row[pathIndex] = nextRow[pathIndex] || row[pathIndex + 1];
+            }
+        }
+        else {
+            /**
+             Every other token type consumes exactly one component. Parameters and single wildcards match 
+             anything, integer parameters only integers, and static strings have to be the same pooled string.
+             Components that aren't in the pool never equal a token's index.
+             */
+            const BOOL *integerPathComponents = ((tokenType == FSQRouteUrlTokenTypeIntegerParameter)
+                                                 ? parsedUrl.integerPathComponents
+                                                 : NULL);
+            row[numberOfUrlPathComponents] = NO;
+            for (NSUInteger pathIndex = 0; pathIndex < numberOfUrlPathComponents; pathIndex++) {
+                row[pathIndex] = (nextRow[pathIndex + 1]
+                                  && (tokenType != FSQRouteUrlTokenTypeString
+                                      || tokenStringIndex == urlPathComponentIndexes[pathIndex])
+                                  && (integerPathComponents == NULL
+                                      || integerPathComponents[pathIndex]));
+            }
+        }
+    }
+    
+    BOOL matched = suffixMatches[0];
+    
+    if (matched) {
+        NSUInteger pathIndex = 0;
+        for (NSUInteger tokenIndex = 0; tokenIndex < numberOfTokens; tokenIndex++) {
+            BOOL *nextRow = suffixMatches + (tokenIndex + 1) * rowLength;
+            NSUInteger startIndex = pathIndex;
+            
+            if (tokenTypes[tokenIndex] == FSQRouteUrlTokenTypeUnlimitedComponentWildcard) {
+                /**
+                 The table guarantees one of the remaining positions lets the rest of the route match, 
+                 so take the first one.
+                 */
+                while (!nextRow[pathIndex]) {
+                    pathIndex++;
+                }
+            }
+            else {
+                pathIndex++;
+            }
+            
+            captureRanges[tokenIndex] = NSMakeRange(startIndex, pathIndex - startIndex);
+        }
+    }
+    
+    if (suffixMatches != stackTable) {
+        free(suffixMatches);
+    }
+    
+    return matched;
+}
+
+/**
+ Builds the parameter dictionary of a matched route from the capture ranges filled in by 
+ `matchPathComponentIndexes:ofParsedUrl:captureRanges:`. Integer parameters are passed on as the url's string,
+ the matcher has only checked that they parse.
+ */
+- (NSMutableDictionary<NSString *, NSString *> *)parametersForUrlPathComponents:(NSArray<NSString *> *)urlPathComponents
+                                                                  captureRanges:(const NSRange *)captureRanges {
+    NSMutableDictionary<NSString *, NSString *> *parameters = [NSMutableDictionary new];
+    NSUInteger parameterIndex = 0;
+    
+    for (NSUInteger tokenIndex = 0; tokenIndex < _numberOfTokens; tokenIndex++) {
+        if (FSQRouteUrlTokenTypeIsParameter(_tokenTypes[tokenIndex])) {
+            parameters[_parameterNames[parameterIndex++]] = urlPathComponents[captureRanges[tokenIndex].location];
+        }
+    }
+    
+    return parameters;
+}
+
+@end
+
+
+@implementation FSQRouteTrieNode
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _stringChildren = [NSMutableDictionary new];
+        _routes = [NSMutableArray new];
+    }
+    return self;
+}
+
++ (instancetype)nodeForToken:(FSQRouteUrlToken *)token {
+    FSQRouteTrieNode *node = [self new];
+    node->_isUnlimitedComponentWildcard = (token.type == FSQRouteUrlTokenTypeUnlimitedComponentWildcard);
+    return node;
+}
+
+- (id)copyWithZone:(nullable NSZone *)zone {
+    FSQRouteTrieNode *copy = [[self class] new];
+    copy->_stringChildren = [self.stringChildren mutableCopy];
+    copy->_routes = [self.routes mutableCopy];
+    copy->_isUnlimitedComponentWildcard = self.isUnlimitedComponentWildcard;
+    copy.parameterChild = self.parameterChild;
+    copy.integerParameterChild = self.integerParameterChild;
+    copy.singleComponentWildcardChild = self.singleComponentWildcardChild;
+    copy.unlimitedComponentWildcardChild = self.unlimitedComponentWildcardChild;
+    return copy;
+}
+
+- (BOOL)isEmpty {
+    return (self.routes.count == 0
+            && self.stringChildren.count == 0
+            && self.parameterChild == nil
+            && self.integerParameterChild == nil
+            && self.singleComponentWildcardChild == nil
+            && self.unlimitedComponentWildcardChild == nil);
+}
+
+- (nullable FSQRouteTrieNode *)childForToken:(FSQRouteUrlToken *)token {
+    switch (token.type) {
+        case FSQRouteUrlTokenTypeString:
+            return self.stringChildren[@(token.stringIndex)];
+        case FSQRouteUrlTokenTypeParameter:
+            return self.parameterChild;
+        case FSQRouteUrlTokenTypeSingleComponentWildcard:
+            return self.singleComponentWildcardChild;
+        case FSQRouteUrlTokenTypeUnlimitedComponentWildcard:
+            return self.unlimitedComponentWildcardChild;
+        case FSQRouteUrlTokenTypeIntegerParameter:
+            return self.integerParameterChild;
+    }
+}
+
+- (void)setChild:(nullable FSQRouteTrieNode *)child forToken:(FSQRouteUrlToken *)token {
+    switch (token.type) {
+        case FSQRouteUrlTokenTypeString: {
+            self.stringChildren[@(token.stringIndex)] = child;
+        }
+            break;
+        case FSQRouteUrlTokenTypeParameter: {
+            self.parameterChild = child;
+        }
+            break;
+        case FSQRouteUrlTokenTypeSingleComponentWildcard: {
+            self.singleComponentWildcardChild = child;
+        }
+            break;
+        case FSQRouteUrlTokenTypeUnlimitedComponentWildcard: {
+            self.unlimitedComponentWildcardChild = child;
+        }
+            break;
+        case FSQRouteUrlTokenTypeIntegerParameter: {
+            self.integerParameterChild = child;
+        }
+            break;
+    }
+}
+
+- (FSQRouteTrieNode *)childForAddingToken:(FSQRouteUrlToken *)token {
+    FSQRouteTrieNode *child = [self childForToken:token];
+    if (child == nil) {
+        child = [FSQRouteTrieNode nodeForToken:token];
+        [self setChild:child forToken:token];
+    }
+    return child;
+}
+
+- (void)insertRoute:(FSQCompiledRoute *)route tokens:(NSArray<FSQRouteUrlToken *> *)tokens {
+    FSQRouteTrieNode *node = self;
+    for (FSQRouteUrlToken *token in tokens) {
+        node = [node childForAddingToken:token];
+    }
+    [node.routes addObject:route];
+}
+
+- (nullable FSQRouteTrieNode *)nodeByUpdatingNodeForTokens:(NSArray<FSQRouteUrlToken *> *)tokens
+                                                tokenIndex:(NSUInteger)tokenIndex
+                                                usingBlock:(FSQRouteTrieNode *_Nullable (^)(FSQRouteTrieNode *node))update {
+    if (tokenIndex == tokens.count) {
+        return update(self);
+    }
+    
+    FSQRouteUrlToken *token = tokens[tokenIndex];
+    FSQRouteTrieNode *child = [self childForToken:token] ?: [FSQRouteTrieNode nodeForToken:token];
+    FSQRouteTrieNode *updatedChild = [child nodeByUpdatingNodeForTokens:tokens 
+                                                             tokenIndex:tokenIndex + 1 
+                                                             usingBlock:update];
+    if (updatedChild == nil) {
+        return nil;
+    }
+    
+    FSQRouteTrieNode *updatedNode = [self copy];
+    [updatedNode setChild:(updatedChild.isEmpty ? nil : updatedChild) forToken:token];
+    return updatedNode;
+}
+
+/**
+ Adds this node and every node reachable from it through unlimited wildcard edges (which can match zero components)
+ to the set of active nodes.
+ */
+- (void)addToActiveNodes:(NSMutableSet<FSQRouteTrieNode *> *)activeNodes {
+    FSQRouteTrieNode *node = self;
+    while (node != nil 
+           && ![activeNodes containsObject:node]) {
+        [activeNodes addObject:node];
+        node = node.unlimitedComponentWildcardChild;
+    }
+}
+
+@end
+
+
+static void FSQAddRoutesBelowNode(FSQRouteTrieNode *node, NSMutableArray<FSQCompiledRoute *> *routes) {
+    [routes addObjectsFromArray:node.routes];
+    for (FSQRouteTrieNode *child in node.stringChildren.objectEnumerator) {
+        FSQAddRoutesBelowNode(child, routes);
+    }
+    if (node.parameterChild != nil) {
+        FSQAddRoutesBelowNode(node.parameterChild, routes);
+    }
+    if (node.integerParameterChild != nil) {
+        FSQAddRoutesBelowNode(node.integerParameterChild, routes);
+    }
+    if (node.singleComponentWildcardChild != nil) {
+        FSQAddRoutesBelowNode(node.singleComponentWildcardChild, routes);
+    }
+    if (node.unlimitedComponentWildcardChild != nil) {
+        FSQAddRoutesBelowNode(node.unlimitedComponentWildcardChild, routes);
+    }
+}
+
+/**
+ Parameters match the same path components as single wildcards, they just capture them. Integer parameters match
+ fewer components, so they are kept apart.
+ */
+static inline FSQRouteUrlTokenType FSQMatchingTokenType(uint8_t tokenType) {
+    return (tokenType == FSQRouteUrlTokenTypeParameter) ? FSQRouteUrlTokenTypeSingleComponentWildcard : tokenType;
+}
+
+/**
+ @return YES if the routes match exactly the same paths because their tokens only differ in parameter names, or in 
+ untyped parameters in place of single wildcards.
+ */
+static BOOL FSQRoutesHaveSamePathComponents(FSQCompiledRoute *route1, FSQCompiledRoute *route2) {
+    if (route1.numberOfTokens != route2.numberOfTokens) {
+        return NO;
+    }
+    
+    for (NSUInteger tokenIndex = 0; tokenIndex < route1.numberOfTokens; tokenIndex++) {
+        FSQRouteUrlTokenType tokenType = FSQMatchingTokenType(route1.tokenTypes[tokenIndex]);
+        if (tokenType != FSQMatchingTokenType(route2.tokenTypes[tokenIndex])
+            || (tokenType == FSQRouteUrlTokenTypeString
+                && route1.tokenStringIndexes[tokenIndex] != route2.tokenStringIndexes[tokenIndex])) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+/**
+ Rebuilds a route string from a compiled route. Static components are percent-encoded, with colons and asterisks
+ escaped too so they can't be read back as a parameter or wildcard.
+ */
+static NSString *FSQRouteStringForRoute(FSQCompiledRoute *route) {
+    static NSCharacterSet *allowedCharacters = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSMutableCharacterSet *characters = [[NSCharacterSet URLPathAllowedCharacterSet] mutableCopy];
+        [characters removeCharactersInString:@"/:*+"];
+        allowedCharacters = [characters copy];
+    });
+    
+    FSQRouteStringPool *stringPool = [FSQRouteStringPool sharedPool];
+    NSMutableString *routeString = [NSMutableString new];
+    
+    for (NSUInteger tokenIndex = 0; tokenIndex < route.numberOfTokens; tokenIndex++) {
+        [routeString appendString:@"/"];
+        
+        switch ((FSQRouteUrlTokenType)route.tokenTypes[tokenIndex]) {
+            case FSQRouteUrlTokenTypeString: {
+                NSString *string = [stringPool stringAtIndex:route.tokenStringIndexes[tokenIndex]];
+                [routeString appendString:[string stringByAddingPercentEncodingWithAllowedCharacters:allowedCharacters]];
+            }
+                break;
+            case FSQRouteUrlTokenTypeParameter: {
+                [routeString appendFormat:@":%@", [stringPool stringAtIndex:route.tokenStringIndexes[tokenIndex]]];
+            }
+                break;
+            case FSQRouteUrlTokenTypeSingleComponentWildcard: {
+                [routeString appendString:@"*"];
+            }
+                break;
+            case FSQRouteUrlTokenTypeUnlimitedComponentWildcard: {
+                [routeString appendString:@"**"];
+            }
+                break;
+            case FSQRouteUrlTokenTypeIntegerParameter: {
+                [routeString appendFormat:@":%@<int>", [stringPool stringAtIndex:route.tokenStringIndexes[tokenIndex]]];
+            }
+                break;
+        }
+    }
+    
+    return (routeString.length > 0) ? [routeString copy] : @"/";
+}
+
+
+@interface FSQCompiledRouteMap ()
+/**
+ Nil until the trie of a map created from compiled route map data has been built.
+ */
+@property (atomic, strong, nullable) FSQRouteTrieNode *loadedTrieRoot;
+@property (atomic, strong, nullable) FSQRouteStringPoolSnapshot *loadedStringPoolSnapshot;
+@end
+
+@implementation FSQCompiledRouteMap {
+    NSData *_compiledRouteMapData;
+    NSArray *_compiledRouteMapGenerators;
+}
+
+- (instancetype)initWithTrieRoot:(FSQRouteTrieNode *)trieRoot
+                  numberOfRoutes:(NSUInteger)numberOfRoutes
+                  nextRouteIndex:(NSUInteger)nextRouteIndex
+                         options:(FSQRouteMatchingOptions)options {
+    self = [super init];
+    if (self) {
+        _loadedTrieRoot = trieRoot;
+        _loadedStringPoolSnapshot = [FSQRouteStringPool sharedPool].snapshot;
+        _numberOfRoutes = numberOfRoutes;
+        _nextRouteIndex = nextRouteIndex;
+        _options = options;
+    }
+    return self;
+}
+
+- (nullable instancetype)initWithCompiledRouteMapData:(NSData *)data
+                                           generators:(nullable NSArray *)generators
+                                              options:(FSQRouteMatchingOptions)options
+                                                error:(NSError **)error {
+    FSQCompiledRouteMapLayout layout;
+    if (!FSQReadCompiledRouteMapLayout(data, &layout)) {
+        if (error) {
+            *error = [NSError errorWithDomain:FSQUrlRouterErrorDomain
+                                         code:FSQUrlRouterErrorCodeInvalidCompiledRouteMap
+                                     userInfo:@{NSLocalizedDescriptionKey : @"The compiled route map data is invalid or was made by an incompatible version of FSQRoutes."}];
+        }
+        return nil;
+    }
+    
+    if (generators != nil
+        && generators.count != layout.numberOfRoutes) {
+        if (error) {
+            NSString *description = [NSString stringWithFormat:@"The compiled route map has %lu routes but %lu generators were given.",
+                                     (unsigned long)layout.numberOfRoutes, (unsigned long)generators.count];
+            *error = [NSError errorWithDomain:FSQUrlRouterErrorDomain
+                                         code:FSQUrlRouterErrorCodeGeneratorCountMismatch
+                                     userInfo:@{NSLocalizedDescriptionKey : description}];
+        }
+        return nil;
+    }
+    
+    self = [super init];
+    if (self) {
+        _compiledRouteMapData = data;
+        _compiledRouteMapGenerators = [generators copy];
+        _numberOfRoutes = layout.numberOfRoutes;
+        _nextRouteIndex = layout.numberOfRoutes;
+        _options = options;
+    }
+    return self;
+}
+
+- (FSQRouteTrieNode *)trieRoot {
+    FSQRouteTrieNode *trieRoot = self.loadedTrieRoot;
+    
+    if (trieRoot == nil) {
+        @synchronized (self) {
+            trieRoot = self.loadedTrieRoot;
+            if (trieRoot == nil) {
+                trieRoot = [self trieRootFromCompiledRouteMapData];
+                self.loadedStringPoolSnapshot = [FSQRouteStringPool sharedPool].snapshot;
+                self.loadedTrieRoot = trieRoot;
+                _compiledRouteMapData = nil;
+                _compiledRouteMapGenerators = nil;
+            }
+        }
+    }
+    
+    return trieRoot;
+}
+
+- (FSQRouteStringPoolSnapshot *)stringPoolSnapshot {
+    (void)self.trieRoot;
+    return self.loadedStringPoolSnapshot;
+}
+
+/**
+ Builds the trie of a map created from compiled route map data. Strings in the data are already normalized and
+ unescaped, and each one is only turned into an NSString once no matter how many routes use it. Static components
+ are folded with the map's options here, since the data itself is compiled without any.
+ */
+- (FSQRouteTrieNode *)trieRootFromCompiledRouteMapData {
+    FSQCompiledRouteMapLayout layout;
+    FSQReadCompiledRouteMapLayout(_compiledRouteMapData, &layout);
+    
+    NSMutableArray<NSString *> *strings = [NSMutableArray arrayWithCapacity:layout.numberOfStrings];
+    for (uint32_t stringIndex = 0; stringIndex < layout.numberOfStrings; stringIndex++) {
+        const uint32_t *entry = layout.strings + stringIndex * 2;
+        NSString *string = [[NSString alloc] initWithBytes:layout.stringData + FSQReadLittleEndian(entry[0])
+                                                    length:FSQReadLittleEndian(entry[1])
+                                                  encoding:NSUTF8StringEncoding];
+        NSAssert(string != nil, @"Invalid UTF-8 in compiled route map data");
+        [strings addObject:(string ?: @"")];
+    }
+    
+    FSQRouteTrieNode *trieRoot = [FSQRouteTrieNode new];
+    
+    for (uint32_t routeIndex = 0; routeIndex < layout.numberOfRoutes; routeIndex++) {
+        const uint32_t *routeEntry = layout.routes + routeIndex * 2;
+        uint32_t firstTokenIndex = FSQReadLittleEndian(routeEntry[0]);
+        uint32_t numberOfTokens = FSQReadLittleEndian(routeEntry[1]);
+        
+        if (firstTokenIndex == kFSQCompiledRouteMapNeverMatchingRoute
+            && numberOfTokens == 0) {
+            continue;
+        }
+        
+        NSMutableArray<FSQRouteUrlToken *> *tokens = [NSMutableArray arrayWithCapacity:numberOfTokens];
+        for (uint32_t tokenIndex = firstTokenIndex; tokenIndex < firstTokenIndex + numberOfTokens; tokenIndex++) {
+            const uint32_t *tokenEntry = layout.tokens + tokenIndex * 2;
+            uint32_t stringIndex = FSQReadLittleEndian(tokenEntry[1]);
+            
+            switch ((FSQRouteUrlTokenType)FSQReadLittleEndian(tokenEntry[0])) {
+                case FSQRouteUrlTokenTypeString:
+                    [tokens addObject:[FSQRouteUrlToken withString:FSQFoldedString(strings[stringIndex], _options)]];
+                    break;
+                case FSQRouteUrlTokenTypeParameter:
+                    [tokens addObject:[FSQRouteUrlToken withParameterName:strings[stringIndex]]];
+                    break;
+                case FSQRouteUrlTokenTypeSingleComponentWildcard:
+                    [tokens addObject:[FSQRouteUrlToken singleComponentWildCard]];
+                    break;
+                case FSQRouteUrlTokenTypeUnlimitedComponentWildcard:
+                    [tokens addObject:[FSQRouteUrlToken unlimitedComponentWildCard]];
+                    break;
+                case FSQRouteUrlTokenTypeIntegerParameter:
+                    [tokens addObject:[FSQRouteUrlToken withIntegerParameterName:strings[stringIndex]]];
+                    break;
+            }
+        }
+        
+        id contentGenerator = (_compiledRouteMapGenerators != nil) ? _compiledRouteMapGenerators[routeIndex] : [NSNull null];
+        [trieRoot insertRoute:[[FSQCompiledRoute alloc] initWithTokens:tokens
+                                                      contentGenerator:contentGenerator
+                                                            routeIndex:routeIndex]
+                       tokens:tokens];
+    }
+    
+    return trieRoot;
+}
+
+- (instancetype)initWithTokenizedRouteMap:(NSArray<NSArray *> *)tokenizedRouteMap {
+    return [self initWithTokenizedRouteMap:tokenizedRouteMap options:FSQRouteMatchingOptionsNone];
+}
+
+- (instancetype)initWithTokenizedRouteMap:(NSArray<NSArray *> *)tokenizedRouteMap options:(FSQRouteMatchingOptions)options {
+    /**
+     The trie is not shared with anything yet, so it is built in place instead of copying nodes for each route.
+     */
+    FSQRouteTrieNode *trieRoot = [FSQRouteTrieNode new];
+    
+    for (NSUInteger routeIndex = 0; routeIndex < tokenizedRouteMap.count; routeIndex++) {
+        NSArray *pair = tokenizedRouteMap[routeIndex];
+        if ([pair firstObject] == [NSNull null]) {
+            continue;
+        }
+        [trieRoot insertRoute:[[FSQCompiledRoute alloc] initWithTokens:[pair firstObject]
+                                                      contentGenerator:[pair lastObject]
+                                                            routeIndex:routeIndex]
+                       tokens:[pair firstObject]];
+    }
+    
+    return [self initWithTrieRoot:trieRoot 
+                   numberOfRoutes:tokenizedRouteMap.count 
+                   nextRouteIndex:tokenizedRouteMap.count
+                          options:options];
+}
+
+- (FSQCompiledRouteMap *)routeMapByAddingRouteWithTokens:(NSArray<FSQRouteUrlToken *> *)tokens
+                                        contentGenerator:(id)contentGenerator {
+    FSQCompiledRoute *route = [[FSQCompiledRoute alloc] initWithTokens:tokens
+                                                      contentGenerator:contentGenerator
+                                                            routeIndex:self.nextRouteIndex];
+    
+    FSQRouteTrieNode *trieRoot = [self.trieRoot nodeByUpdatingNodeForTokens:tokens 
+                                                                 tokenIndex:0 
+                                                                 usingBlock:^FSQRouteTrieNode *(FSQRouteTrieNode *node) {
+                                                                     /**
+                                                                      New routes always have the highest index, so 
+                                                                      appending keeps the routes sorted.
+                                                                      */
+                                                                     FSQRouteTrieNode *updatedNode = [node copy];
+                                                                     [updatedNode.routes addObject:route];
+                                                                     return updatedNode;
+                                                                 }];
+    
+    return [[FSQCompiledRouteMap alloc] initWithTrieRoot:trieRoot
+                                          numberOfRoutes:self.numberOfRoutes + 1
+                                          nextRouteIndex:self.nextRouteIndex + 1
+                                                 options:self.options];
+}
+
+- (nullable FSQCompiledRouteMap *)routeMapByRemovingRoutesWithTokens:(NSArray<FSQRouteUrlToken *> *)tokens {
+    __block NSUInteger numberOfRemovedRoutes = 0;
+    
+    FSQRouteTrieNode *trieRoot = [self.trieRoot nodeByUpdatingNodeForTokens:tokens 
+                                                                 tokenIndex:0 
+                                                                 usingBlock:^FSQRouteTrieNode *_Nullable(FSQRouteTrieNode *node) {
+                                                                     NSIndexSet *indexes = [node.routes indexesOfObjectsPassingTest:^BOOL(FSQCompiledRoute *route, NSUInteger idx, BOOL *stop) {
+                                                                         return [route hasTokens:tokens];
+                                                                     }];
+                                                                     
+                                                                     if (indexes.count == 0) {
+                                                                         return nil;
+                                                                     }
+                                                                     
+                                                                     numberOfRemovedRoutes = indexes.count;
+                                                                     FSQRouteTrieNode *updatedNode = [node copy];
+                                                                     [updatedNode.routes removeObjectsAtIndexes:indexes];
+                                                                     return updatedNode;
+                                                                 }];
+    
+    if (trieRoot == nil) {
+        return nil;
+    }
+    
+    return [[FSQCompiledRouteMap alloc] initWithTrieRoot:trieRoot
+                                          numberOfRoutes:self.numberOfRoutes - numberOfRemovedRoutes
+                                          nextRouteIndex:self.nextRouteIndex
+                                                 options:self.options];
+}
+
+- (nullable FSQCompiledRouteMap *)routeMapByReplacingContentGenerator:(id)contentGenerator
+                                                   forRoutesWithTokens:(NSArray<FSQRouteUrlToken *> *)tokens {
+    FSQRouteTrieNode *trieRoot = [self.trieRoot nodeByUpdatingNodeForTokens:tokens 
+                                                                 tokenIndex:0 
+                                                                 usingBlock:^FSQRouteTrieNode *_Nullable(FSQRouteTrieNode *node) {
+                                                                     FSQRouteTrieNode *updatedNode = nil;
+                                                                     
+                                                                     for (NSUInteger i = 0; i < node.routes.count; i++) {
+                                                                         FSQCompiledRoute *route = node.routes[i];
+                                                                         if ([route hasTokens:tokens]) {
+                                                                             if (updatedNode == nil) {
+                                                                                 updatedNode = [node copy];
+                                                                             }
+                                                                             updatedNode.routes[i] = [[FSQCompiledRoute alloc] initWithRoute:route
+                                                                                                                            contentGenerator:contentGenerator];
+                                                                         }
+                                                                     }
+                                                                     
+                                                                     return updatedNode;
+                                                                 }];
+    
+    if (trieRoot == nil) {
+        return nil;
+    }
+    
+    return [[FSQCompiledRouteMap alloc] initWithTrieRoot:trieRoot
+                                          numberOfRoutes:self.numberOfRoutes
+                                          nextRouteIndex:self.nextRouteIndex
+                                                 options:self.options];
+}
+
+- (BOOL)containsRouteWithTokens:(NSArray<FSQRouteUrlToken *> *)tokens {
+    FSQRouteTrieNode *node = self.trieRoot;
+    
+    for (FSQRouteUrlToken *token in tokens) {
+        node = [node childForToken:token];
+        if (node == nil) {
+            return NO;
+        }
+    }
+    
+    for (FSQCompiledRoute *route in node.routes) {
+        if ([route hasTokens:tokens]) {
+            return YES;
+        }
+    }
+    
+    return NO;
+}
+
+- (NSArray<FSQCompiledRoute *> *)routesMatchingPathComponentIndexes:(const uint32_t *)pathComponentIndexes
+                                                        ofParsedUrl:(FSQParsedRouteUrl *)parsedUrl {
+    NSUInteger numberOfPathComponents = parsedUrl.pathComponents.count;
+    const BOOL *integerPathComponents = NULL;
+    
+    NSMutableSet<FSQRouteTrieNode *> *activeNodes = [NSMutableSet new];
+    [self.trieRoot addToActiveNodes:activeNodes];
+    
+    for (NSUInteger pathIndex = 0; pathIndex < numberOfPathComponents; pathIndex++) {
+        if (activeNodes.count == 0) {
+            break;
+        }
+        
+        /**
+         A component that isn't in the string pool can't be the static part of any route.
+         */
+        uint32_t pathComponentIndex = pathComponentIndexes[pathIndex];
+        NSNumber *stringChildKey = (pathComponentIndex != kFSQRouteStringNotInterned) ? @(pathComponentIndex) : nil;
+        NSMutableSet<FSQRouteTrieNode *> *nextActiveNodes = [NSMutableSet new];
+        
+        for (FSQRouteTrieNode *node in activeNodes) {
+            if (stringChildKey != nil) {
+                [node.stringChildren[stringChildKey] addToActiveNodes:nextActiveNodes];
+            }
+            [node.parameterChild addToActiveNodes:nextActiveNodes];
+            [node.singleComponentWildcardChild addToActiveNodes:nextActiveNodes];
+            
+            if (node.integerParameterChild != nil) {
+                /**
+                 Components which aren't integers stop here, before any route below this edge is matched.
+                 */
+                if (integerPathComponents == NULL) {
+                    integerPathComponents = parsedUrl.integerPathComponents;
+                }
+                if (integerPathComponents[pathIndex]) {
+                    [node.integerParameterChild addToActiveNodes:nextActiveNodes];
+                }
+            }
+            
+            if (node.isUnlimitedComponentWildcard) {
+                /**
+                 Unlimited wildcards can swallow this component and stay where they are.
+                 */
+                [node addToActiveNodes:nextActiveNodes];
+            }
+        }
+        
+        activeNodes = nextActiveNodes;
+    }
+    
+    NSMutableArray<FSQCompiledRoute *> *matchingRoutes = [NSMutableArray new];
+    for (FSQRouteTrieNode *node in activeNodes) {
+        [matchingRoutes addObjectsFromArray:node.routes];
+    }
+    
+    if (matchingRoutes.count > 1) {
+        [matchingRoutes sortUsingComparator:^NSComparisonResult(FSQCompiledRoute *route1, FSQCompiledRoute *route2) {
+            if (route1.routeIndex < route2.routeIndex) {
+                return NSOrderedAscending;
+            }
+            else if (route1.routeIndex > route2.routeIndex) {
+                return NSOrderedDescending;
+            }
+            return NSOrderedSame;
+        }];
+    }
+    
+    return matchingRoutes;
+}
+
+- (nullable FSQCompiledRoute *)routeMatchingParsedUrl:(FSQParsedRouteUrl *)parsedUrl
+                                       pathParameters:(NSMutableDictionary<NSString *, NSString *> *_Nullable *_Nullable)pathParameters
+                                  numberOfRoutesTried:(nullable NSUInteger *)numberOfRoutesTried {
+    __block FSQCompiledRoute *matchingRoute = nil;
+    __block NSMutableDictionary<NSString *, NSString *> *parameters = nil;
+    
+    NSUInteger routesTried = [self enumerateRoutesMatchingParsedUrl:parsedUrl
+                                                         usingBlock:^(FSQCompiledRoute *route, NSMutableDictionary<NSString *, NSString *> *routeParameters, BOOL *stop) {
+                                                             matchingRoute = route;
+                                                             parameters = routeParameters;
+                                                             *stop = YES;
+                                                         }];
+    
+    if (pathParameters != NULL) {
+        *pathParameters = parameters;
+    }
+    if (numberOfRoutesTried != NULL) {
+        *numberOfRoutesTried = routesTried;
+    }
+    
+    return matchingRoute;
+}
+
+- (NSArray<FSQCompiledRoute *> *)routesMatchingParsedUrl:(FSQParsedRouteUrl *)parsedUrl
+                                          pathParameters:(NSArray<NSMutableDictionary<NSString *, NSString *> *> *_Nullable *_Nullable)pathParameters {
+    NSMutableArray<FSQCompiledRoute *> *matchingRoutes = [NSMutableArray new];
+    NSMutableArray<NSMutableDictionary<NSString *, NSString *> *> *parameters = [NSMutableArray new];
+    
+    [self enumerateRoutesMatchingParsedUrl:parsedUrl
+                                usingBlock:^(FSQCompiledRoute *route, NSMutableDictionary<NSString *, NSString *> *routeParameters, BOOL *stop) {
+                                    [matchingRoutes addObject:route];
+                                    [parameters addObject:routeParameters];
+                                }];
+    
+    if (pathParameters != NULL) {
+        *pathParameters = parameters;
+    }
+    
+    return matchingRoutes;
+}
+
+/**
+ Matches a url's path against each route the trie gives us, in ascending index order, and calls `block` with every
+ route that matches (and its path parameters) until the block sets `stop`.
+
+ @return The number of routes whose tokens were matched against the path.
+ */
+- (NSUInteger)enumerateRoutesMatchingParsedUrl:(FSQParsedRouteUrl *)parsedUrl
+                                    usingBlock:(void (^)(FSQCompiledRoute *route, NSMutableDictionary<NSString *, NSString *> *pathParameters, BOOL *stop))block {
+    NSUInteger routesTried = 0;
+    
+    NSRange stackCaptureRanges[kFSQStackCaptureRangeCount];
+    NSRange *captureRanges = stackCaptureRanges;
+    NSUInteger captureRangeCapacity = kFSQStackCaptureRangeCount;
+    
+    /**
+     Each path component is folded and looked up in the map's string pool snapshot once here, after which every
+     comparison against a static route component is an integer compare. Reading the snapshot builds the trie of a map
+     created from compiled route map data, which is what interns its strings.
+     */
+    const uint32_t *pathComponentIndexes = [parsedUrl pathComponentStringIndexesWithOptions:self.options
+                                                                          stringPoolSnapshot:self.stringPoolSnapshot];
+    
+    /**
+     The trie gives us every route that can match this path, in ascending index order so the route 
+     registered first still wins.
+     */
+    for (FSQCompiledRoute *route in [self routesMatchingPathComponentIndexes:pathComponentIndexes
+                                                                 ofParsedUrl:parsedUrl]) {
+        routesTried++;
+        NSUInteger numberOfTokens = route.numberOfTokens;
+        
+        if (numberOfTokens > captureRangeCapacity) {
+            captureRangeCapacity = numberOfTokens;
+            captureRanges = (captureRanges == stackCaptureRanges) 
+                            ? malloc(captureRangeCapacity * sizeof(NSRange)) 
+                            : realloc(captureRanges, captureRangeCapacity * sizeof(NSRange));
+        }
+        
+        if (![route matchPathComponentIndexes:pathComponentIndexes
+                                  ofParsedUrl:parsedUrl
+                                captureRanges:captureRanges]) {
+            continue;
+        }
+        
+        if (numberOfTokens == 0 && // Important: a route can have parameters but no path, i.e. scheme://?foo=bar
+            parsedUrl.queryItems.count == 0) {
+            continue;
+        }
+        
+        BOOL stop = NO;
+        block(route, [route parametersForUrlPathComponents:parsedUrl.pathComponents captureRanges:captureRanges], &stop);
+        if (stop) {
+            break;
+        }
+    }
+    
+    if (captureRanges != stackCaptureRanges) {
+        free(captureRanges);
+    }
+    
+    return routesTried;
+}
+
+#pragma mark - Route analysis -
+
+- (NSArray<FSQRouteAnalysis *> *)routeAnalyses {
+    FSQRouteTrieNode *trieRoot = self.trieRoot;
+    
+    NSMutableArray<FSQCompiledRoute *> *routes = [NSMutableArray arrayWithCapacity:self.numberOfRoutes];
+    FSQAddRoutesBelowNode(trieRoot, routes);
+    [routes sortUsingComparator:^NSComparisonResult(FSQCompiledRoute *route1, FSQCompiledRoute *route2) {
+        if (route1.routeIndex < route2.routeIndex) {
+            return NSOrderedAscending;
+        }
+        else if (route1.routeIndex > route2.routeIndex) {
+            return NSOrderedDescending;
+        }
+        return NSOrderedSame;
+    }];
+    
+    NSMutableArray<FSQRouteAnalysis *> *analyses = [NSMutableArray arrayWithCapacity:routes.count];
+    for (FSQCompiledRoute *route in routes) {
+        FSQCompiledRoute *shadowingRoute = [self routeShadowingRoute:route];
+        
+        NSUInteger numberOfUnlimitedWildcards = 0;
+        for (NSUInteger tokenIndex = 0; tokenIndex < route.numberOfTokens; tokenIndex++) {
+            if (route.tokenTypes[tokenIndex] == FSQRouteUrlTokenTypeUnlimitedComponentWildcard) {
+                numberOfUnlimitedWildcards++;
+            }
+        }
+        
+        [analyses addObject:[[FSQRouteAnalysis alloc] initWithRouteIndex:route.routeIndex
+                                                             routeString:FSQRouteStringForRoute(route)
+                                                     shadowingRouteIndex:(shadowingRoute != nil) ? shadowingRoute.routeIndex : NSNotFound
+                                                               redundant:(shadowingRoute != nil && FSQRoutesHaveSamePathComponents(route, shadowingRoute))
+                                                          numberOfTokens:route.numberOfTokens
+                                              numberOfUnlimitedWildcards:numberOfUnlimitedWildcards]];
+    }
+    
+    return analyses;
+}
+
+/**
+ Finds the route with the lowest index below the given route's which matches every path the given route matches.
+
+ The route's own tokens are walked through the trie the way a url's path components are, with each token standing
+ for every path component it could match: a static string can be followed by the edge for the same string or by any
+ edge which matches any component (or any integer, if the string is one), a parameter or single wildcard only by the
+ edges which match any component, an integer parameter also by integer parameter edges, and an unlimited wildcard
+ only by an unlimited wildcard node staying where it is. The routes on the nodes which are
+ still active at the end match everything the given route does.
+
+ Zero token routes need no special casing: they are only on the root node, which is only active at the end when
+ the given route also has no tokens (and so also only matches urls with a query).
+ */
+- (nullable FSQCompiledRoute *)routeShadowingRoute:(FSQCompiledRoute *)route {
+    NSMutableSet<FSQRouteTrieNode *> *activeNodes = [NSMutableSet new];
+    [self.trieRoot addToActiveNodes:activeNodes];
+    
+    FSQRouteStringPool *stringPool = [FSQRouteStringPool sharedPool];
+    
+    for (NSUInteger tokenIndex = 0; tokenIndex < route.numberOfTokens; tokenIndex++) {
+        FSQRouteUrlTokenType tokenType = route.tokenTypes[tokenIndex];
+        NSMutableSet<FSQRouteTrieNode *> *nextActiveNodes = [NSMutableSet new];
+        
+        BOOL matchesOnlyIntegers = (tokenType == FSQRouteUrlTokenTypeIntegerParameter
+                                    || (tokenType == FSQRouteUrlTokenTypeString
+                                        && FSQIntegerValueOfString([stringPool stringAtIndex:route.tokenStringIndexes[tokenIndex]], NULL)));
+        
+        for (FSQRouteTrieNode *node in activeNodes) {
+            if (tokenType == FSQRouteUrlTokenTypeString) {
+                [node.stringChildren[@(route.tokenStringIndexes[tokenIndex])] addToActiveNodes:nextActiveNodes];
+            }
+            if (tokenType != FSQRouteUrlTokenTypeUnlimitedComponentWildcard) {
+                [node.parameterChild addToActiveNodes:nextActiveNodes];
+                [node.singleComponentWildcardChild addToActiveNodes:nextActiveNodes];
+            }
+            if (matchesOnlyIntegers) {
+                [node.integerParameterChild addToActiveNodes:nextActiveNodes];
+            }
+            if (node.isUnlimitedComponentWildcard) {
+                [node addToActiveNodes:nextActiveNodes];
+            }
+        }
+        
+        if (nextActiveNodes.count == 0) {
+            return nil;
+        }
+        activeNodes = nextActiveNodes;
+    }
+    
+    FSQCompiledRoute *shadowingRoute = nil;
+    for (FSQRouteTrieNode *node in activeNodes) {
+        /**
+         Each node's routes are in ascending index order, so only the first one can be the lowest.
+         */
+        FSQCompiledRoute *firstRoute = node.routes.firstObject;
+        if (firstRoute != nil
+            && firstRoute.routeIndex < route.routeIndex
+            && (shadowingRoute == nil || firstRoute.routeIndex < shadowingRoute.routeIndex)) {
+            shadowingRoute = firstRoute;
+        }
+    }
+    
+    return shadowingRoute;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
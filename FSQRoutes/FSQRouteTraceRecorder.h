@@ -0,0 +1,117 @@
+//
+//  FSQRouteTraceRecorder.h
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+@import Foundation;
+
+#import "FSQRoutingMetrics.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A single routing pass read back from a trace file written by FSQRouteTraceRecorder.
+ */
+@interface FSQRouteTraceRecord : NSObject
+
+@property (nonatomic, strong, readonly, nullable) NSURL *url;
+
+/**
+ The notification userInfo the url was routed with. This is nil if there was none, or if it could not be stored as
+ a property list.
+ */
+@property (nonatomic, copy, readonly, nullable) NSDictionary *notificationUserInfo;
+
+/**
+ When the routing pass finished, in seconds since 1970.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval timestamp;
+
+/**
+ The index of the matching route in its route map, or NSNotFound if no route matched.
+ */
+@property (nonatomic, assign, readonly) NSUInteger routeIndex;
+
+@property (nonatomic, assign, readonly) NSUInteger numberOfRoutesTried;
+@property (nonatomic, assign, readonly, getter=isResumedFromDeferral) BOOL resumedFromDeferral;
+@property (nonatomic, assign, readonly) BOOL usedPrewarmedContent;
+@property (nonatomic, assign, readonly) FSQRoutingOutcome outcome;
+
+/**
+ @return The duration of the given stage in nanoseconds, or 0 if it did not finish during the routing pass.
+ */
+- (uint64_t)durationOfStage:(FSQRoutingStage)stage;
+
+/**
+ Reads every record in a trace file.
+
+ A record which was only partly written (eg because the app was killed during a write) at the end of the file is
+ ignored.
+
+ @return The records in the order they were written, or nil if the file could not be read or is not a trace file
+ (with an error in the FSQUrlRouterErrorDomain, or the error from reading the file).
+ */
++ (nullable NSArray<FSQRouteTraceRecord *> *)recordsFromTraceAtUrl:(NSURL *)url error:(NSError **)error;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+/**
+ The Route Trace Recorder class appends a compact binary record of routing passes to a file, so that the urls your
+ app routes in the field (and how long each stage took) can be replayed later. See FSQUrlRouter's `traceRecorder`
+ and `replayTraceRecords:`.
+
+ Each record holds the url, the notification userInfo (as a binary property list), the time the pass finished, the
+ route index, the outcome and the duration of every stage that ran. Records are only appended, so a file can be
+ written by recorders from several launches, one after another. Only one recorder can have a file open at a time.
+
+ Recording never blocks routing on the disk. Finished passes are handed to a background queue which encodes and
+ writes them in batches. If more than `maximumNumberOfBufferedRecords` passes are waiting to be written, further
+ passes are dropped (and counted in `numberOfDroppedRecords`) until the writer catches up.
+
+ Recorders can be used from any thread.
+ */
+@interface FSQRouteTraceRecorder : NSObject
+
+@property (nonatomic, strong, readonly) NSURL *fileUrl;
+
+/**
+ The maximum number of routing passes waiting to be written. The default is 256.
+ */
+@property (atomic, assign) NSUInteger maximumNumberOfBufferedRecords;
+
+/**
+ The number of routing passes which were not recorded because the buffer was full or the file could not be written.
+ */
+@property (atomic, assign, readonly) NSUInteger numberOfDroppedRecords;
+
+/**
+ Opens a trace file for appending, creating it if it does not exist.
+
+ The recorder holds an exclusive lock (`flock`) on the file until it is deallocated, since it cuts off records that
+ were only partly written, which would corrupt another writer's records.
+
+ @return The new recorder, or nil if the file could not be opened or is not a trace file. If another recorder (in
+ this or any other process) has the file open, the error is EWOULDBLOCK in the NSPOSIXErrorDomain.
+ */
+- (nullable instancetype)initWithFileUrl:(NSURL *)fileUrl error:(NSError **)error;
+
+/**
+ Queues a record of a finished routing pass to be written. Routers call this for you when the recorder is set as
+ their `traceRecorder`.
+ */
+- (void)recordRoutingMetrics:(FSQRoutingMetrics *)metrics;
+
+/**
+ Writes every queued record, and does not return until they have been written.
+ */
+- (void)flush;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,510 @@
+//
+//  FSQRouteTraceRecorder.m
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+#import "FSQRouteTraceRecorder.h"
+
+#import "FSQRouteMatcher.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Trace files are little endian. They start with a magic number and a version (two uint32_t values), followed by
+ records laid out as:
+
+ uint32_t  Length of the rest of the record
+ uint64_t  Time the routing pass finished, in microseconds since 1970
+ uint32_t  Route index, or UINT32_MAX if no route matched
+ uint32_t  Number of routes tried
+ uint32_t  Outcome in the low byte, then one bit each for resumedFromDeferral and usedPrewarmedContent
+ uint32_t  A bit for each stage which finished
+ uint64_t  The duration in nanoseconds of each stage which finished, in stage order
+ uint32_t  Length of the url string, followed by its UTF-8 bytes
+ uint32_t  Length of the notification userInfo, followed by it as a binary property list
+
+ The record length lets readers skip fields added by later versions, and find a record cut short at the end.
+ */
+static const uint32_t kFSQRouteTraceMagic = 0x54515346; // "FSQT"
+static const uint32_t kFSQRouteTraceVersion = 1;
+static const uint32_t kFSQRouteTraceNoRouteIndex = UINT32_MAX;
+static const uint32_t kFSQRouteTraceResumedFromDeferralFlag = 1 << 8;
+static const uint32_t kFSQRouteTraceUsedPrewarmedContentFlag = 1 << 9;
+static const size_t kFSQRouteTraceHeaderLength = 2 * sizeof(uint32_t);
+
+static const NSUInteger kFSQRouteTraceDefaultMaximumNumberOfBufferedRecords = 256;
+
+static void FSQAppendTraceUInt32(NSMutableData *data, uint32_t value) {
+    uint32_t littleEndianValue = NSSwapHostIntToLittle(value);
+    [data appendBytes:&littleEndianValue length:sizeof(littleEndianValue)];
+}
+
+static void FSQAppendTraceUInt64(NSMutableData *data, uint64_t value) {
+    uint64_t littleEndianValue = NSSwapHostLongLongToLittle(value);
+    [data appendBytes:&littleEndianValue length:sizeof(littleEndianValue)];
+}
+
+static void FSQAppendTraceBytes(NSMutableData *data, const void *_Nullable bytes, NSUInteger length) {
+    FSQAppendTraceUInt32(data, (uint32_t)length);
+    if (length > 0) {
+        [data appendBytes:bytes length:length];
+    }
+}
+
+/**
+ Reads from a record without alignment requirements.
+
+ @return NO (and reads nothing) if the value would run past the end of the record.
+ */
+static BOOL FSQReadTraceUInt32(const uint8_t **cursor, const uint8_t *end, uint32_t *value) {
+    if ((size_t)(end - *cursor) < sizeof(uint32_t)) {
+        return NO;
+    }
+    uint32_t littleEndianValue;
+    memcpy(&littleEndianValue, *cursor, sizeof(littleEndianValue));
+    *value = NSSwapLittleIntToHost(littleEndianValue);
+    *cursor += sizeof(uint32_t);
+    return YES;
+}
+
+static BOOL FSQReadTraceUInt64(const uint8_t **cursor, const uint8_t *end, uint64_t *value) {
+    if ((size_t)(end - *cursor) < sizeof(uint64_t)) {
+        return NO;
+    }
+    uint64_t littleEndianValue;
+    memcpy(&littleEndianValue, *cursor, sizeof(littleEndianValue));
+    *value = NSSwapLittleLongLongToHost(littleEndianValue);
+    *cursor += sizeof(uint64_t);
+    return YES;
+}
+
+static BOOL FSQReadTraceBytes(const uint8_t **cursor, const uint8_t *end, NSData *_Nullable *_Nonnull bytes) {
+    uint32_t length = 0;
+    if (!FSQReadTraceUInt32(cursor, end, &length)
+        || (size_t)(end - *cursor) < length) {
+        return NO;
+    }
+    *bytes = (length > 0) ? [NSData dataWithBytes:*cursor length:length] : nil;
+    *cursor += length;
+    return YES;
+}
+
+static NSError *FSQInvalidTraceError(void) {
+    return [NSError errorWithDomain:FSQUrlRouterErrorDomain
+                               code:FSQUrlRouterErrorCodeInvalidTrace
+                           userInfo:@{NSLocalizedDescriptionKey : @"The file is not a route trace or was made by an incompatible version of FSQRoutes."}];
+}
+
+static NSError *FSQPOSIXError(int errorNumber) {
+    return [NSError errorWithDomain:NSPOSIXErrorDomain code:errorNumber userInfo:nil];
+}
+
+/**
+ Writes all of the bytes, retrying after interrupts and short writes.
+
+ @return The number of bytes written, which is less than length only if the write failed with errno set.
+ */
+static size_t FSQWriteTraceBytes(int fileDescriptor, const uint8_t *bytes, size_t length) {
+    size_t writtenLength = 0;
+    while (writtenLength < length) {
+        ssize_t result = write(fileDescriptor, bytes + writtenLength, length - writtenLength);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            if (result == 0) {
+                errno = EIO;
+            }
+            break;
+        }
+        writtenLength += (size_t)result;
+    }
+    return writtenLength;
+}
+
+/**
+ Walks the record lengths of a trace file with a valid header, and cuts off a record left incomplete at the end by
+ a crash or a failed write, so that records appended after it can be read.
+
+ @return 0, or the errno of the read or truncation which failed.
+ */
+static int FSQTruncateTornTraceRecord(int fileDescriptor, off_t fileLength) {
+    off_t offset = kFSQRouteTraceHeaderLength;
+    while (fileLength - offset >= (off_t)sizeof(uint32_t)) {
+        uint32_t recordLength = 0;
+        ssize_t readLength = pread(fileDescriptor, &recordLength, sizeof(recordLength), offset);
+        if (readLength < 0 && errno == EINTR) {
+            continue;
+        }
+        if (readLength != (ssize_t)sizeof(recordLength)) {
+            return (readLength < 0) ? errno : EIO;
+        }
+        off_t recordEnd = offset + (off_t)sizeof(uint32_t) + NSSwapLittleIntToHost(recordLength);
+        if (recordEnd > fileLength) {
+            break;
+        }
+        offset = recordEnd;
+    }
+
+    if (offset < fileLength && ftruncate(fileDescriptor, offset) != 0) {
+        return errno;
+    }
+    return 0;
+}
+
+static void FSQAppendTraceRecord(NSMutableData *data, FSQRoutingMetrics *metrics, uint64_t timestamp) {
+    NSData *urlData = [metrics.url.absoluteString dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *userInfoData = nil;
+    if (metrics.notificationUserInfo != nil) {
+        userInfoData = [NSPropertyListSerialization dataWithPropertyList:(id)metrics.notificationUserInfo
+                                                                  format:NSPropertyListBinaryFormat_v1_0
+                                                                 options:0
+                                                                   error:NULL];
+    }
+
+    NSUInteger lengthOffset = data.length;
+    FSQAppendTraceUInt32(data, 0);
+
+    FSQAppendTraceUInt64(data, timestamp);
+    FSQAppendTraceUInt32(data, (metrics.routeIndex < kFSQRouteTraceNoRouteIndex
+                                ? (uint32_t)metrics.routeIndex
+                                : kFSQRouteTraceNoRouteIndex));
+    FSQAppendTraceUInt32(data, (uint32_t)MIN(metrics.numberOfRoutesTried, (NSUInteger)UINT32_MAX));
+    FSQAppendTraceUInt32(data, ((uint32_t)(metrics.outcome & 0xFF)
+                                | (metrics.resumedFromDeferral ? kFSQRouteTraceResumedFromDeferralFlag : 0)
+                                | (metrics.usedPrewarmedContent ? kFSQRouteTraceUsedPrewarmedContentFlag : 0)));
+
+    uint32_t stageMask = 0;
+    for (FSQRoutingStage stage = 0; stage < FSQRoutingStageCount; stage++) {
+        if ([metrics endTimeForStage:stage] > 0) {
+            stageMask |= (1u << stage);
+        }
+    }
+    FSQAppendTraceUInt32(data, stageMask);
+    for (FSQRoutingStage stage = 0; stage < FSQRoutingStageCount; stage++) {
+        if (stageMask & (1u << stage)) {
+            FSQAppendTraceUInt64(data, [metrics durationOfStage:stage]);
+        }
+    }
+
+    FSQAppendTraceBytes(data, urlData.bytes, urlData.length);
+    FSQAppendTraceBytes(data, userInfoData.bytes, userInfoData.length);
+
+    uint32_t recordLength = NSSwapHostIntToLittle((uint32_t)(data.length - lengthOffset - sizeof(uint32_t)));
+    [data replaceBytesInRange:NSMakeRange(lengthOffset, sizeof(recordLength)) withBytes:&recordLength];
+}
+
+@implementation FSQRouteTraceRecord {
+    uint64_t _stageDurations[FSQRoutingStageCount];
+}
+
+/**
+ @return The record, or nil if the bytes are not a valid record.
+ */
+- (nullable instancetype)initWithBytes:(const uint8_t *)bytes length:(size_t)length {
+    self = [super init];
+    if (self) {
+        const uint8_t *cursor = bytes;
+        const uint8_t *end = bytes + length;
+
+        uint64_t timestamp = 0;
+        uint32_t routeIndex = 0;
+        uint32_t numberOfRoutesTried = 0;
+        uint32_t flags = 0;
+        uint32_t stageMask = 0;
+        if (!FSQReadTraceUInt64(&cursor, end, &timestamp)
+            || !FSQReadTraceUInt32(&cursor, end, &routeIndex)
+            || !FSQReadTraceUInt32(&cursor, end, &numberOfRoutesTried)
+            || !FSQReadTraceUInt32(&cursor, end, &flags)
+            || !FSQReadTraceUInt32(&cursor, end, &stageMask)) {
+            return nil;
+        }
+
+        /**
+         Every stage bit has a duration, even those of stages this version doesn't know about.
+         */
+        for (uint32_t stage = 0; stage < 32; stage++) {
+            if (stageMask & (1u << stage)) {
+                uint64_t duration = 0;
+                if (!FSQReadTraceUInt64(&cursor, end, &duration)) {
+                    return nil;
+                }
+                if (stage < FSQRoutingStageCount) {
+                    _stageDurations[stage] = duration;
+                }
+            }
+        }
+
+        NSData *urlData = nil;
+        NSData *userInfoData = nil;
+        if (!FSQReadTraceBytes(&cursor, end, &urlData)
+            || !FSQReadTraceBytes(&cursor, end, &userInfoData)) {
+            return nil;
+        }
+
+        if (urlData != nil) {
+            NSString *urlString = [[NSString alloc] initWithData:urlData encoding:NSUTF8StringEncoding];
+            _url = (urlString != nil) ? [NSURL URLWithString:urlString] : nil;
+        }
+        if (userInfoData != nil) {
+            id userInfo = [NSPropertyListSerialization propertyListWithData:userInfoData
+                                                                    options:NSPropertyListImmutable
+                                                                     format:NULL
+                                                                      error:NULL];
+            _notificationUserInfo = [userInfo isKindOfClass:[NSDictionary class]] ? userInfo : nil;
+        }
+
+        _timestamp = timestamp / (NSTimeInterval)USEC_PER_SEC;
+        _routeIndex = (routeIndex != kFSQRouteTraceNoRouteIndex) ? routeIndex : NSNotFound;
+        _numberOfRoutesTried = numberOfRoutesTried;
+        _outcome = (FSQRoutingOutcome)(flags & 0xFF);
+        _resumedFromDeferral = !!(flags & kFSQRouteTraceResumedFromDeferralFlag);
+        _usedPrewarmedContent = !!(flags & kFSQRouteTraceUsedPrewarmedContentFlag);
+    }
+    return self;
+}
+
+- (uint64_t)durationOfStage:(FSQRoutingStage)stage {
+    return (stage >= 0 && stage < FSQRoutingStageCount) ? _stageDurations[stage] : 0;
+}
+
++ (nullable NSArray<FSQRouteTraceRecord *> *)recordsFromTraceAtUrl:(NSURL *)url error:(NSError **)error {
+    NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:error];
+    if (data == nil) {
+        return nil;
+    }
+
+    const uint8_t *cursor = data.bytes;
+    const uint8_t *end = cursor + data.length;
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    if (!FSQReadTraceUInt32(&cursor, end, &magic)
+        || !FSQReadTraceUInt32(&cursor, end, &version)
+        || magic != kFSQRouteTraceMagic
+        || version != kFSQRouteTraceVersion) {
+        if (error) {
+            *error = FSQInvalidTraceError();
+        }
+        return nil;
+    }
+
+    NSMutableArray<FSQRouteTraceRecord *> *records = [NSMutableArray new];
+    uint32_t recordLength = 0;
+    while (FSQReadTraceUInt32(&cursor, end, &recordLength)
+           && (size_t)(end - cursor) >= recordLength) {
+        @autoreleasepool {
+            FSQRouteTraceRecord *record = [[FSQRouteTraceRecord alloc] initWithBytes:cursor length:recordLength];
+            if (record == nil) {
+                if (error) {
+                    *error = FSQInvalidTraceError();
+                }
+                return nil;
+            }
+            [records addObject:record];
+        }
+        cursor += recordLength;
+    }
+
+    return records;
+}
+
+- (NSString *)debugDescription {
+    return [NSString stringWithFormat:@"<%@: %p, url: %@, routeIndex: %@, outcome: %ld>",
+            self.class, self, self.url,
+            (self.routeIndex != NSNotFound ? @(self.routeIndex) : @"none"), (long)self.outcome];
+}
+
+@end
+
+@implementation FSQRouteTraceRecorder {
+    int _fileDescriptor;
+    dispatch_queue_t _writeQueue;
+
+    /**
+     Finished metrics waiting to be written, and whether a write has been dispatched for them. Guarded by _lock.
+     */
+    NSLock *_lock;
+    NSMutableArray<FSQRoutingMetrics *> *_bufferedMetrics;
+    NSMutableArray<NSNumber *> *_bufferedTimestamps;
+    BOOL _writeScheduled;
+}
+
+@synthesize numberOfDroppedRecords = _numberOfDroppedRecords;
+
+- (nullable instancetype)initWithFileUrl:(NSURL *)fileUrl error:(NSError **)error {
+    int fileDescriptor = open(fileUrl.fileSystemRepresentation, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fileDescriptor < 0) {
+        if (error) {
+            *error = FSQPOSIXError(errno);
+        }
+        return nil;
+    }
+
+    /**
+     Cutting off torn records (here and after a failed write) is only safe while nothing else is appending to the
+     file, so the recorder holds an exclusive lock on it until it is deallocated, which closes the file.
+     */
+    if (flock(fileDescriptor, LOCK_EX | LOCK_NB) != 0) {
+        if (error) {
+            *error = FSQPOSIXError(errno);
+        }
+        close(fileDescriptor);
+        return nil;
+    }
+
+    /**
+     New files get a header. Existing ones must already have a header from this version, since records are
+     appended as is, and lose any incomplete record at the end.
+     */
+    uint32_t header[2];
+    struct stat fileStatus;
+    int errorNumber = 0;
+    BOOL isTraceFile = NO;
+
+    if (fstat(fileDescriptor, &fileStatus) != 0) {
+        errorNumber = errno;
+    }
+    else if (fileStatus.st_size == 0) {
+        header[0] = NSSwapHostIntToLittle(kFSQRouteTraceMagic);
+        header[1] = NSSwapHostIntToLittle(kFSQRouteTraceVersion);
+        if (FSQWriteTraceBytes(fileDescriptor, (const uint8_t *)header, kFSQRouteTraceHeaderLength) == kFSQRouteTraceHeaderLength) {
+            isTraceFile = YES;
+        }
+        else {
+            errorNumber = errno;
+        }
+    }
+    else {
+        isTraceFile = (pread(fileDescriptor, header, kFSQRouteTraceHeaderLength, 0) == (ssize_t)kFSQRouteTraceHeaderLength
+                       && NSSwapLittleIntToHost(header[0]) == kFSQRouteTraceMagic
+                       && NSSwapLittleIntToHost(header[1]) == kFSQRouteTraceVersion);
+        if (isTraceFile) {
+            errorNumber = FSQTruncateTornTraceRecord(fileDescriptor, fileStatus.st_size);
+            isTraceFile = (errorNumber == 0);
+        }
+    }
+
+    if (!isTraceFile) {
+        if (error) {
+            *error = (errorNumber != 0) ? FSQPOSIXError(errorNumber) : FSQInvalidTraceError();
+        }
+        close(fileDescriptor);
+        return nil;
+    }
+
+    self = [super init];
+    if (self) {
+        _fileUrl = fileUrl;
+        _fileDescriptor = fileDescriptor;
+        _maximumNumberOfBufferedRecords = kFSQRouteTraceDefaultMaximumNumberOfBufferedRecords;
+        _lock = [NSLock new];
+        _bufferedMetrics = [NSMutableArray new];
+        _bufferedTimestamps = [NSMutableArray new];
+
+        _writeQueue = dispatch_queue_create("com.foursquare.FSQRoutes.traceRecorder", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_writeQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+    }
+    else {
+        close(fileDescriptor);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    /**
+     Queued writes retain the recorder, so by now everything buffered has been written.
+     */
+    close(_fileDescriptor);
+}
+
+- (NSUInteger)numberOfDroppedRecords {
+    [_lock lock];
+    NSUInteger numberOfDroppedRecords = _numberOfDroppedRecords;
+    [_lock unlock];
+    return numberOfDroppedRecords;
+}
+
+- (void)recordRoutingMetrics:(FSQRoutingMetrics *)metrics {
+    /**
+     Only the wall clock time is read here. Encoding the record and writing it are both left to the write queue.
+     */
+    NSTimeInterval timestamp = [[NSDate date] timeIntervalSince1970];
+    BOOL shouldScheduleWrite = NO;
+
+    [_lock lock];
+    if (_bufferedMetrics.count >= self.maximumNumberOfBufferedRecords) {
+        _numberOfDroppedRecords++;
+    }
+    else {
+        [_bufferedMetrics addObject:metrics];
+        [_bufferedTimestamps addObject:@(timestamp)];
+        shouldScheduleWrite = !_writeScheduled;
+        _writeScheduled = YES;
+    }
+    [_lock unlock];
+
+    if (shouldScheduleWrite) {
+        dispatch_async(_writeQueue, ^{
+            [self writeBufferedRecords];
+        });
+    }
+}
+
+- (void)flush {
+    dispatch_sync(_writeQueue, ^{
+        [self writeBufferedRecords];
+    });
+}
+
+/**
+ Writes everything buffered so far with a single write. Only called on the write queue.
+ */
+- (void)writeBufferedRecords {
+    [_lock lock];
+    NSArray<FSQRoutingMetrics *> *metricsToWrite = _bufferedMetrics;
+    NSArray<NSNumber *> *timestamps = _bufferedTimestamps;
+    _bufferedMetrics = [NSMutableArray new];
+    _bufferedTimestamps = [NSMutableArray new];
+    _writeScheduled = NO;
+    [_lock unlock];
+
+    if (metricsToWrite.count == 0) {
+        return;
+    }
+
+    NSMutableData *data = [NSMutableData new];
+    @autoreleasepool {
+        [metricsToWrite enumerateObjectsUsingBlock:^(FSQRoutingMetrics *metrics, NSUInteger index, BOOL *stop) {
+            FSQAppendTraceRecord(data, metrics, (uint64_t)(timestamps[index].doubleValue * USEC_PER_SEC));
+        }];
+    }
+
+    /**
+     No other recorder can have the file open (see `initWithFileUrl:error:`), so if the write fails partway through,
+     the partial records can be cut off again without touching anyone else's records, and a later write doesn't land
+     after a torn record.
+     */
+    off_t startOffset = lseek(_fileDescriptor, 0, SEEK_END);
+    size_t writtenLength = FSQWriteTraceBytes(_fileDescriptor, data.bytes, data.length);
+    if (writtenLength < data.length) {
+        if (writtenLength > 0 && startOffset >= 0) {
+            (void)ftruncate(_fileDescriptor, startOffset);
+        }
+        [_lock lock];
+        _numberOfDroppedRecords += metricsToWrite.count;
+        [_lock unlock];
+    }
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
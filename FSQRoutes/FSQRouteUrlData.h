@@ -13,11 +13,39 @@ NS_ASSUME_NONNULL_BEGIN
 /**
  The Url Data class wraps a url, parsed out parameters from that url, and remote/local notification info 
  into a single object to make them easier to pass around.
+
+ Url data created by the router keeps the url's query items as they are, and only unescapes them when they are
+ asked for. `parameterForKey:` and `integerParameterForKey:` unescape just the one they return, so urls carrying
+ lots of query items a generator never looks at (eg tracking parameters) don't pay for decoding them. Reading
+ `parameters` decodes everything once.
  */
 @interface FSQRouteUrlData : NSObject
 @property (nonatomic, strong, nullable) NSURL *url;
+
+/**
+ All of the url's parameters: the route's path parameters and the url's query items. A query item with the same
+ name as a path parameter takes its place.
+
+ For url data created by the router, this dictionary is only built the first time it is read.
+ */
 @property (nonatomic, strong, nullable) NSDictionary<NSString *, NSString *>*parameters;
 @property (nonatomic, strong, nullable) NSDictionary *notificationUserInfo;
+
+/**
+ @return The value `parameters` has for the key, unescaping only that parameter if `parameters` hasn't been built.
+ */
+- (nullable NSString *)parameterForKey:(NSString *)key;
+
+/**
+ The value of a parameter which is a decimal integer (an optional minus sign followed by digits, which fits in 64
+ bits).
+
+ Route parameters declared as integers (eg ":venueId<int>") were already checked when the url was matched, so this
+ never returns nil for them.
+
+ @return The integer, or nil if there is no such parameter or it is not an integer.
+ */
+- (nullable NSNumber *)integerParameterForKey:(NSString *)key;
 @end
 
 NS_ASSUME_NONNULL_END
\ No newline at end of file
@@ -8,6 +8,179 @@
 
 #import "FSQRouteUrlData.h"
 
-@implementation FSQRouteUrlData
+#import "FSQRouteMatchingCore.h"
+
+#import <pthread.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation FSQRouteUrlData {
+    /**
+     Url data is often handed to another queue after matching, so the lazily decoded parameters are guarded.
+     */
+    pthread_mutex_t _lock;
+    
+    /**
+     Set for url data created by the router until `parameters` is built or assigned, nil otherwise.
+     */
+    NSDictionary<NSString *, NSString *> *_pathParameters;
+    NSArray<NSURLQueryItem *> *_queryItems;
+    
+    /**
+     YES if query item names and values are used as they are instead of being unescaped.
+     */
+    BOOL _queryItemsAreRaw;
+    
+    /**
+     The query parameters unescaped by `parameterForKey:` so far, with NSNull for keys no query item has.
+     */
+    NSMutableDictionary<NSString *, id> *_queryParametersByKey;
+}
+
+@synthesize parameters = _parameters;
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+    }
+    return self;
+}
+
+- (instancetype)initWithUrl:(NSURL *)url
+             pathParameters:(nullable NSDictionary<NSString *, NSString *> *)pathParameters
+                 queryItems:(nullable NSArray<NSURLQueryItem *> *)queryItems {
+    self = [self init];
+    if (self) {
+        _url = url;
+        _pathParameters = pathParameters ?: @{};
+        _queryItems = [queryItems copy];
+    }
+    return self;
+}
+
+- (instancetype)initWithUrl:(NSURL *)url rawQueryItems:(nullable NSArray<NSURLQueryItem *> *)queryItems {
+    self = [self initWithUrl:url pathParameters:nil queryItems:queryItems];
+    if (self) {
+        _queryItemsAreRaw = YES;
+    }
+    return self;
+}
+
+- (instancetype)initWithUrl:(NSURL *)url parametersOfUrlData:(FSQRouteUrlData *)urlData {
+    pthread_mutex_lock(&urlData->_lock);
+    NSDictionary<NSString *, NSString *> *parameters = urlData->_parameters;
+    NSDictionary<NSString *, NSString *> *pathParameters = urlData->_pathParameters;
+    NSArray<NSURLQueryItem *> *queryItems = urlData->_queryItems;
+    BOOL queryItemsAreRaw = urlData->_queryItemsAreRaw;
+    pthread_mutex_unlock(&urlData->_lock);
+    
+    if (pathParameters != nil) {
+        self = [self initWithUrl:url pathParameters:pathParameters queryItems:queryItems];
+        if (self) {
+            _queryItemsAreRaw = queryItemsAreRaw;
+        }
+        return self;
+    }
+    
+    self = [self init];
+    if (self) {
+        _url = url;
+        _parameters = parameters;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
+- (nullable NSDictionary<NSString *, NSString *> *)parameters {
+    pthread_mutex_lock(&_lock);
+    if (_pathParameters != nil) {
+        NSMutableDictionary<NSString *, NSString *> *queryParameters = [NSMutableDictionary new];
+        for (NSURLQueryItem *item in _queryItems) {
+            NSString *name = [self queryItemString:item.name];
+            if (name != nil) {
+                queryParameters[name] = [self queryItemString:item.value];
+            }
+        }
+        
+        NSMutableDictionary<NSString *, NSString *> *parameters = [_pathParameters mutableCopy];
+        [parameters addEntriesFromDictionary:queryParameters];
+        
+        _parameters = parameters;
+        _pathParameters = nil;
+        _queryItems = nil;
+        _queryParametersByKey = nil;
+    }
+    NSDictionary<NSString *, NSString *> *parameters = _parameters;
+    pthread_mutex_unlock(&_lock);
+    
+    return parameters;
+}
+
+- (void)setParameters:(nullable NSDictionary<NSString *, NSString *> *)parameters {
+    pthread_mutex_lock(&_lock);
+    _parameters = parameters;
+    _pathParameters = nil;
+    _queryItems = nil;
+    _queryParametersByKey = nil;
+    pthread_mutex_unlock(&_lock);
+}
+
+- (nullable NSString *)parameterForKey:(NSString *)key {
+    pthread_mutex_lock(&_lock);
+    NSString *value = nil;
+    
+    if (_pathParameters == nil) {
+        value = _parameters[key];
+    }
+    else {
+        id queryValue = _queryParametersByKey[key];
+        if (queryValue == nil) {
+            queryValue = [self unescapedQueryValueForKey:key] ?: [NSNull null];
+            
+            if (_queryParametersByKey == nil) {
+                _queryParametersByKey = [NSMutableDictionary new];
+            }
+            _queryParametersByKey[key] = queryValue;
+        }
+        
+        value = (queryValue != [NSNull null]) ? queryValue : _pathParameters[key];
+    }
+    
+    pthread_mutex_unlock(&_lock);
+    return value;
+}
+
+/**
+ Finds the query item `parameters` would take the key's value from: the last one with that name. Only names are
+ unescaped on the way, and those rarely need it.
+
+ @return The unescaped value, or nil if there is no such query item or it has no value.
+ */
+- (nullable NSString *)unescapedQueryValueForKey:(NSString *)key {
+    for (NSURLQueryItem *item in _queryItems.reverseObjectEnumerator) {
+        if ([[self queryItemString:item.name] isEqualToString:key]) {
+            return [self queryItemString:item.value];
+        }
+    }
+    return nil;
+}
+
+- (nullable NSString *)queryItemString:(nullable NSString *)string {
+    return _queryItemsAreRaw ? string : FSQUnescapedString(string);
+}
+
+- (nullable NSNumber *)integerParameterForKey:(NSString *)key {
+    int64_t value = 0;
+    if (!FSQIntegerValueOfString([self parameterForKey:key], &value)) {
+        return nil;
+    }
+    return @(value);
+}
 
 @end
+
+NS_ASSUME_NONNULL_END
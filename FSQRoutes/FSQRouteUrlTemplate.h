@@ -0,0 +1,64 @@
+//
+//  FSQRouteUrlTemplate.h
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+@import Foundation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The Route Url Template class builds urls from one of the routes registered on a FSQUrlRouter, the reverse of
+ matching a url against it.
+
+ Templates are created with FSQUrlRouter's `urlTemplateForRoute:nativeScheme:` or
+ `urlTemplateForRoute:universalLinkHost:`. The route string is parsed once when the template is created, so building
+ urls from it only fills in and percent-encodes the parameter values.
+
+ Templates are immutable and can be used from any thread.
+ */
+@interface FSQRouteUrlTemplate : NSObject
+
+/**
+ The route string this template was created from.
+ */
+@property (nonatomic, copy, readonly) NSString *routeString;
+
+/**
+ The names of the route's path parameters, in the order they appear in the route.
+ */
+@property (nonatomic, copy, readonly) NSArray<NSString *> *parameterNames;
+
+/**
+ Builds a url by filling in the route's path parameters.
+
+ Parameter values which are not strings are converted using their description (so numbers can be passed as is).
+ Values are percent-encoded as needed. Parameters which are not path parameters of the route are added as query
+ items, sorted by name, so matching the url returns the same parameters.
+
+ @param parameters The parameter values to use. Every one of the route's parameterNames must have a value.
+
+ @return The new url, or nil if a path parameter was missing.
+ */
+- (nullable NSURL *)urlWithParameters:(NSDictionary<NSString *, id> *)parameters;
+
+/**
+ Builds one url per parameter dictionary. See `urlWithParameters:`.
+
+ This is intended for building large numbers of urls at once. A single string buffer is reused for every url, and
+ values which don't need percent-encoding are copied straight into it.
+
+ @param parameterDictionaries The parameter values for each url.
+
+ @return One NSURL per parameter dictionary in the same order, or NSNull for dictionaries which are missing a path
+ parameter.
+ */
+- (NSArray *)urlsWithParameterDictionaries:(NSArray<NSDictionary<NSString *, id> *> *)parameterDictionaries;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,187 @@
+//
+//  FSQRouteUrlTemplate.m
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+#import "FSQRouteUrlTemplate.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Characters which can appear unescaped in a single path component. Slashes are escaped so a value can't add path
+ components, plus signs so they aren't read back as spaces, and colons because the first path component of a native
+ scheme url is its host, where a colon would start a port.
+ */
+static NSCharacterSet *FSQPathComponentAllowedCharacters;
+static NSCharacterSet *FSQPathComponentDisallowedCharacters;
+static NSCharacterSet *FSQQueryComponentAllowedCharacters;
+static NSCharacterSet *FSQQueryComponentDisallowedCharacters;
+
+static void FSQLoadUrlCharacterSets(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSMutableCharacterSet *pathCharacters = [[NSCharacterSet URLPathAllowedCharacterSet] mutableCopy];
+        [pathCharacters removeCharactersInString:@"/+:"];
+        FSQPathComponentAllowedCharacters = [pathCharacters copy];
+        FSQPathComponentDisallowedCharacters = [pathCharacters invertedSet];
+
+        NSMutableCharacterSet *queryCharacters = [[NSCharacterSet URLQueryAllowedCharacterSet] mutableCopy];
+        [queryCharacters removeCharactersInString:@"&=+#?"];
+        FSQQueryComponentAllowedCharacters = [queryCharacters copy];
+        FSQQueryComponentDisallowedCharacters = [queryCharacters invertedSet];
+    });
+}
+
+/**
+ Appends the string to the buffer, percent-encoding it only if it has characters which are not allowed. Most values
+ are plain identifiers, which are appended without creating an encoded copy.
+ */
+static void FSQAppendPercentEncodedString(NSMutableString *buffer,
+                                          NSString *string,
+                                          NSCharacterSet *allowedCharacters,
+                                          NSCharacterSet *disallowedCharacters) {
+    if ([string rangeOfCharacterFromSet:disallowedCharacters].location == NSNotFound) {
+        [buffer appendString:string];
+    }
+    else {
+        NSString *encodedString = [string stringByAddingPercentEncodingWithAllowedCharacters:allowedCharacters];
+        if (encodedString != nil) {
+            [buffer appendString:encodedString];
+        }
+    }
+}
+
+static NSString *FSQParameterValueString(id value) {
+    return [value isKindOfClass:[NSString class]] ? value : [value description];
+}
+
+@implementation FSQRouteUrlTemplate {
+    /**
+     The url with its parameters taken out: literal i comes before parameter i, and the last literal after the last
+     parameter. Literals are already percent-encoded.
+     */
+    NSArray<NSString *> *_literals;
+    NSSet<NSString *> *_parameterNameSet;
+}
+
+- (instancetype)initWithRouteString:(NSString *)routeString
+                          urlPrefix:(NSString *)urlPrefix
+                     pathComponents:(NSArray<NSString *> *)pathComponents
+                   parameterIndexes:(NSIndexSet *)parameterIndexes {
+    self = [super init];
+    if (self) {
+        FSQLoadUrlCharacterSets();
+        
+        NSMutableArray<NSString *> *literals = [NSMutableArray new];
+        NSMutableArray<NSString *> *parameterNames = [NSMutableArray new];
+        NSMutableString *literal = [urlPrefix mutableCopy];
+
+        [pathComponents enumerateObjectsUsingBlock:^(NSString *component, NSUInteger index, BOOL *stop) {
+            if (index > 0) {
+                [literal appendString:@"/"];
+            }
+
+            if ([parameterIndexes containsIndex:index]) {
+                [literals addObject:[literal copy]];
+                [parameterNames addObject:component];
+                [literal setString:@""];
+            }
+            else {
+                FSQAppendPercentEncodedString(literal,
+                                              component,
+                                              FSQPathComponentAllowedCharacters,
+                                              FSQPathComponentDisallowedCharacters);
+            }
+        }];
+        [literals addObject:[literal copy]];
+
+        _routeString = [routeString copy];
+        _literals = [literals copy];
+        _parameterNames = [parameterNames copy];
+        _parameterNameSet = [NSSet setWithArray:parameterNames];
+    }
+    return self;
+}
+
+- (nullable NSURL *)urlWithParameters:(NSDictionary<NSString *, id> *)parameters {
+    NSMutableString *buffer = [NSMutableString new];
+    return [self appendUrlWithParameters:parameters toBuffer:buffer] ? [NSURL URLWithString:buffer] : nil;
+}
+
+- (NSArray *)urlsWithParameterDictionaries:(NSArray<NSDictionary<NSString *, id> *> *)parameterDictionaries {
+    NSMutableArray *urls = [NSMutableArray arrayWithCapacity:parameterDictionaries.count];
+    NSMutableString *buffer = [NSMutableString new];
+
+    for (NSDictionary<NSString *, id> *parameters in parameterDictionaries) {
+        @autoreleasepool {
+            [buffer setString:@""];
+
+            NSURL *url = nil;
+            if ([self appendUrlWithParameters:parameters toBuffer:buffer]) {
+                url = [NSURL URLWithString:buffer];
+            }
+            [urls addObject:(url ?: [NSNull null])];
+        }
+    }
+
+    return urls;
+}
+
+/**
+ @return NO if one of the path parameters has no value, in which case the contents of the buffer are undefined.
+ */
+- (BOOL)appendUrlWithParameters:(NSDictionary<NSString *, id> *)parameters toBuffer:(NSMutableString *)buffer {
+    NSUInteger numberOfParameters = _parameterNames.count;
+
+    for (NSUInteger index = 0; index < numberOfParameters; index++) {
+        [buffer appendString:_literals[index]];
+
+        id value = parameters[_parameterNames[index]];
+        if (value == nil) {
+            return NO;
+        }
+
+        FSQAppendPercentEncodedString(buffer,
+                                      FSQParameterValueString(value),
+                                      FSQPathComponentAllowedCharacters,
+                                      FSQPathComponentDisallowedCharacters);
+    }
+    [buffer appendString:_literals[numberOfParameters]];
+
+    /**
+     Routes can use the same parameter name twice, so the count alone doesn't tell us whether every parameter
+     was used in the path.
+     */
+    if (parameters.count > _parameterNameSet.count) {
+        NSArray<NSString *> *sortedNames = [parameters.allKeys sortedArrayUsingSelector:@selector(compare:)];
+        BOOL isFirstQueryItem = YES;
+
+        for (NSString *name in sortedNames) {
+            if ([_parameterNameSet containsObject:name]) {
+                continue;
+            }
+
+            [buffer appendString:(isFirstQueryItem ? @"?" : @"&")];
+            FSQAppendPercentEncodedString(buffer, name, FSQQueryComponentAllowedCharacters, FSQQueryComponentDisallowedCharacters);
+            [buffer appendString:@"="];
+            FSQAppendPercentEncodedString(buffer,
+                                          FSQParameterValueString(parameters[name]),
+                                          FSQQueryComponentAllowedCharacters,
+                                          FSQQueryComponentDisallowedCharacters);
+            isFirstQueryItem = NO;
+        }
+    }
+
+    return YES;
+}
+
+- (NSString *)debugDescription {
+    return [NSString stringWithFormat:@"<%@: %p, routeString: %@, parameterNames: %@>",
+            self.class, self, self.routeString, self.parameterNames];
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
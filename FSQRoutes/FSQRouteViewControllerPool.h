@@ -0,0 +1,71 @@
+//
+//  FSQRouteViewControllerPool.h
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+@import UIKit;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The Route View Controller Pool class keeps view controllers created for route content around after they have been
+ presented, so that routing to the same destination again (eg bouncing between links to the same venue) can reuse
+ the existing view controller instead of building a new one.
+
+ View controllers are keyed by their class and a reuse identifier chosen by the route (see FSQRouteContent's
+ `reuseIdentifier`). Only view controllers which implement `prepareForReuseWithFSQRouteUrlData:` from
+ FSQRouteContentViewControllerProtocol are pooled, since they are handed the new url data when they are reused.
+
+ A pooled view controller is only handed out while it is not in use, ie it has no parent view controller, is not
+ presenting or being presented, and its view is not in a view hierarchy. When the pool is full the least recently
+ added view controller is dropped. The pool is emptied when the app receives a memory warning.
+
+ Pools must only be used from the main queue.
+ */
+@interface FSQRouteViewControllerPool : NSObject
+
+/**
+ The maximum number of view controllers kept in the pool. Lowering it drops the least recently added view
+ controllers.
+ */
+@property (nonatomic, assign) NSUInteger capacity;
+
+/**
+ The number of view controllers currently in the pool.
+ */
+@property (nonatomic, assign, readonly) NSUInteger count;
+
+/**
+ This is the designated initializer for the class.
+
+ @param capacity The maximum number of view controllers kept in the pool.
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity NS_DESIGNATED_INITIALIZER;
+
+/**
+ Takes the most recently added view controller of the given class and reuse identifier, which is not in use, out
+ of the pool.
+
+ @return The view controller, or nil if there is no such view controller in the pool.
+ */
+- (nullable UIViewController *)dequeueViewControllerOfClass:(Class)viewControllerClass
+                                            reuseIdentifier:(NSString *)reuseIdentifier;
+
+/**
+ Adds a view controller to the pool, dropping the least recently added one if the pool is full. Adding a view
+ controller which is already in the pool just updates its reuse identifier and makes it the most recently added.
+ */
+- (void)addViewController:(UIViewController *)viewController reuseIdentifier:(NSString *)reuseIdentifier;
+
+/**
+ Drops every view controller in the pool.
+ */
+- (void)removeAllViewControllers;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
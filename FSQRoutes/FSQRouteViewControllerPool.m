@@ -0,0 +1,126 @@
+//
+//  FSQRouteViewControllerPool.m
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+#import "FSQRouteViewControllerPool.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface FSQRouteViewControllerPoolEntry : NSObject
+@property (nonatomic, strong, readonly) UIViewController *viewController;
+@property (nonatomic, copy) NSString *reuseIdentifier;
+@end
+
+@implementation FSQRouteViewControllerPoolEntry
+
+- (instancetype)initWithViewController:(UIViewController *)viewController reuseIdentifier:(NSString *)reuseIdentifier {
+    self = [super init];
+    if (self) {
+        _viewController = viewController;
+        _reuseIdentifier = [reuseIdentifier copy];
+    }
+    return self;
+}
+
+- (BOOL)isInUse {
+    UIViewController *viewController = self.viewController;
+    return (viewController.parentViewController != nil
+            || viewController.presentingViewController != nil
+            || viewController.presentedViewController != nil
+            || (viewController.isViewLoaded && viewController.view.superview != nil));
+}
+
+@end
+
+@implementation FSQRouteViewControllerPool {
+    /**
+     Least recently added first. Pools only hold a handful of view controllers, so lookups just scan this.
+     */
+    NSMutableArray<FSQRouteViewControllerPoolEntry *> *_entries;
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self) {
+        _capacity = capacity;
+        _entries = [NSMutableArray new];
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(didReceiveMemoryWarning:)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (void)didReceiveMemoryWarning:(NSNotification *)notification {
+    [self removeAllViewControllers];
+}
+
+- (NSUInteger)count {
+    return _entries.count;
+}
+
+- (void)setCapacity:(NSUInteger)capacity {
+    _capacity = capacity;
+    [self removeEntriesOverCapacity];
+}
+
+- (nullable UIViewController *)dequeueViewControllerOfClass:(Class)viewControllerClass
+                                            reuseIdentifier:(NSString *)reuseIdentifier {
+    NSAssert([NSThread isMainThread], @"FSQRouteViewControllerPool: Must be used from the main queue");
+
+    for (NSUInteger entryIndex = _entries.count; entryIndex > 0; entryIndex--) {
+        FSQRouteViewControllerPoolEntry *entry = _entries[entryIndex - 1];
+        if ([entry.viewController class] == viewControllerClass
+            && [entry.reuseIdentifier isEqualToString:reuseIdentifier]
+            && ![entry isInUse]) {
+            [_entries removeObjectAtIndex:entryIndex - 1];
+            return entry.viewController;
+        }
+    }
+    return nil;
+}
+
+- (void)addViewController:(UIViewController *)viewController reuseIdentifier:(NSString *)reuseIdentifier {
+    NSAssert([NSThread isMainThread], @"FSQRouteViewControllerPool: Must be used from the main queue");
+
+    NSUInteger existingIndex = [_entries indexOfObjectPassingTest:^BOOL(FSQRouteViewControllerPoolEntry *entry, NSUInteger index, BOOL *stop) {
+        return (entry.viewController == viewController);
+    }];
+
+    FSQRouteViewControllerPoolEntry *entry = nil;
+    if (existingIndex != NSNotFound) {
+        entry = _entries[existingIndex];
+        entry.reuseIdentifier = reuseIdentifier;
+        [_entries removeObjectAtIndex:existingIndex];
+    }
+    else {
+        entry = [[FSQRouteViewControllerPoolEntry alloc] initWithViewController:viewController
+                                                                reuseIdentifier:reuseIdentifier];
+    }
+
+    [_entries addObject:entry];
+    [self removeEntriesOverCapacity];
+}
+
+- (void)removeAllViewControllers {
+    [_entries removeAllObjects];
+}
+
+- (void)removeEntriesOverCapacity {
+    if (_entries.count > self.capacity) {
+        [_entries removeObjectsInRange:NSMakeRange(0, _entries.count - self.capacity)];
+    }
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
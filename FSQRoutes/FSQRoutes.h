@@ -7,6 +7,14 @@
 //
 
 #import "FSQUrlRouter.h"
+#import "FSQRouteAnalysis.h"
+#import "FSQRouteCancellationToken.h"
 #import "FSQRouteContent.h"
 #import "FSQRouteContentGenerator.h"
-#import "FSQRouteUrlData.h"
\ No newline at end of file
+#import "FSQRouteMatch.h"
+#import "FSQRouteMatcher.h"
+#import "FSQRouteTraceRecorder.h"
+#import "FSQRouteUrlData.h"
+#import "FSQRouteUrlTemplate.h"
+#import "FSQRouteViewControllerPool.h"
+#import "FSQRoutingMetrics.h"
\ No newline at end of file
@@ -0,0 +1,179 @@
+//
+//  FSQRoutingMetrics.h
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+@import Foundation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+@protocol FSQRoutingMetricsObserver;
+
+/**
+ The stages of a routing pass, in the order they happen.
+ */
+typedef NS_ENUM(NSInteger, FSQRoutingStage) {
+    /**
+     Parsing and normalizing the url.
+     */
+    FSQRoutingStageUrlParsing,
+    /**
+     Looking up the route map registered for the url's scheme or host.
+     */
+    FSQRoutingStageRouteMapLookup,
+    /**
+     Matching the url's path against the routes in the map and extracting its parameters.
+     */
+    FSQRoutingStagePathMatching,
+    /**
+     The delegate's `urlRouter:shouldGenerateRouteContent:withUrlData:` callback.
+     */
+    FSQRoutingStageShouldGenerateRouteContent,
+    /**
+     The matching route's content generator block.
+     */
+    FSQRoutingStageContentGeneration,
+    /**
+     The delegate's `urlRouter:shouldPresentRoute:` callback.
+     */
+    FSQRoutingStageShouldPresentRoute,
+    /**
+     From calling the delegate's `urlRouter:routedUrlWillBePresented:completionHandler:` until it calls the
+     completion handler.
+     */
+    FSQRoutingStageWillPresent,
+    /**
+     From the completion handler being called until the presentation block starts running on the main queue.
+     */
+    FSQRoutingStageMainQueueHop,
+    /**
+     Getting the presenting view controller from the delegate, presenting the content, and the delegate's
+     `urlRouter:routedUrlDidGetPresented:` callback.
+     */
+    FSQRoutingStagePresentation,
+
+    FSQRoutingStageCount,
+};
+
+/**
+ How a routing pass ended.
+ */
+typedef NS_ENUM(NSInteger, FSQRoutingOutcome) {
+    /**
+     The pass has not finished yet.
+     */
+    FSQRoutingOutcomeInProgress,
+    FSQRoutingOutcomePresented,
+    FSQRoutingOutcomeFailedToMatch,
+    FSQRoutingOutcomeFailedToGenerateContent,
+    /**
+     The delegate did not provide a view controller to present from.
+     */
+    FSQRoutingOutcomeNoPresentingViewController,
+    /**
+     The delegate cancelled the route, a newer route was started before this one could be presented, or the route
+     timed out (see `routingPassTimeout` on FSQUrlRouter).
+     */
+    FSQRoutingOutcomeCancelled,
+    /**
+     The route was deferred. If it is resumed with `handleDeferredRoute`, the rest of the route is measured as a
+     new routing pass.
+     */
+    FSQRoutingOutcomeDeferred,
+    /**
+     The url was dropped by the router's routing queue before it was matched. See FSQRoutingQueuePolicy.
+     */
+    FSQRoutingOutcomeDropped,
+};
+
+/**
+ The Routing Metrics class collects timings for a single routing pass of a FSQUrlRouter.
+
+ Metrics objects are only created when the router has a metrics observer or a trace recorder. They are passed to
+ the observer as each stage ends, and once more when the pass finishes. Finished metrics are also recorded by the
+ router's trace recorder.
+
+ All timestamps are in nanoseconds on a monotonic clock (mach_absolute_time), so they can be compared with each
+ other but not with wall clock time.
+ */
+@interface FSQRoutingMetrics : NSObject
+
+/**
+ The url being routed.
+ */
+@property (nonatomic, strong, readonly, nullable) NSURL *url;
+
+/**
+ The notification userInfo the url was routed with, if any.
+ */
+@property (nonatomic, copy, readonly, nullable) NSDictionary *notificationUserInfo;
+
+/**
+ The index of the matching route in its route map, or NSNotFound if no route matched (or the url was routed with
+ an explicit generator).
+ */
+@property (nonatomic, assign, readonly) NSUInteger routeIndex;
+
+/**
+ The number of routes whose tokens were matched against the url's path. This is usually much smaller than the
+ size of the route map, and is 0 when the url was matched from the router's match cache.
+ */
+@property (nonatomic, assign, readonly) NSUInteger numberOfRoutesTried;
+
+/**
+ YES if this pass is the continuation of a route that was deferred.
+ */
+@property (nonatomic, assign, readonly, getter=isResumedFromDeferral) BOOL resumedFromDeferral;
+
+/**
+ YES if the url was routed using content prepared by FSQUrlRouter's `prewarmUrl:notificationUserInfo:`, in which
+ case the matching and content generation stages do not run.
+ */
+@property (nonatomic, assign, readonly) BOOL usedPrewarmedContent;
+
+@property (nonatomic, assign, readonly) FSQRoutingOutcome outcome;
+
+/**
+ @return The time the given stage started, or 0 if it has not run during this pass.
+ */
+- (uint64_t)startTimeForStage:(FSQRoutingStage)stage;
+
+/**
+ @return The time the given stage ended, or 0 if it has not finished during this pass.
+ */
+- (uint64_t)endTimeForStage:(FSQRoutingStage)stage;
+
+/**
+ @return The duration of the given stage in nanoseconds, or 0 if it has not finished during this pass.
+ */
+- (uint64_t)durationOfStage:(FSQRoutingStage)stage;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+/**
+ Observers of routing metrics can be set on a FSQUrlRouter to find out where time goes while routing urls.
+
+ Callbacks are made on the thread the stage ran on. Presentation stages end on the main queue, while the other
+ stages end on the thread that called the routing method.
+ */
+@protocol FSQRoutingMetricsObserver <NSObject>
+
+/**
+ Called every time a stage of a routing pass ends.
+ */
+- (void)routingMetrics:(FSQRoutingMetrics *)metrics didEndStage:(FSQRoutingStage)stage;
+
+@optional
+
+/**
+ Called once when a routing pass ends, after its outcome has been set.
+ */
+- (void)routingMetricsDidFinish:(FSQRoutingMetrics *)metrics;
+
+@end
+
+NS_ASSUME_NONNULL_END
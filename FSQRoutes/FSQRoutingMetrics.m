@@ -0,0 +1,116 @@
+//
+//  FSQRoutingMetrics.m
+//  FSQRoutes
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+#import "FSQRoutingMetrics.h"
+
+#import "FSQRouteTraceRecorder.h"
+
+#import <mach/mach_time.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+static uint64_t FSQMonotonicNanoseconds(void) {
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+}
+
+@implementation FSQRoutingMetrics {
+    __weak id<FSQRoutingMetricsObserver> _observer;
+    FSQRouteTraceRecorder *_traceRecorder;
+    uint64_t _startTimes[FSQRoutingStageCount];
+    uint64_t _endTimes[FSQRoutingStageCount];
+}
+
+- (instancetype)initWithUrl:(nullable NSURL *)url
+       notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
+                   observer:(nullable id<FSQRoutingMetricsObserver>)observer
+              traceRecorder:(nullable FSQRouteTraceRecorder *)traceRecorder
+        resumedFromDeferral:(BOOL)resumedFromDeferral {
+    self = [super init];
+    if (self) {
+        _url = url;
+        _notificationUserInfo = [notificationUserInfo copy];
+        _observer = observer;
+        _traceRecorder = traceRecorder;
+        _resumedFromDeferral = resumedFromDeferral;
+        _routeIndex = NSNotFound;
+        _outcome = FSQRoutingOutcomeInProgress;
+    }
+    return self;
+}
+
+- (uint64_t)startTimeForStage:(FSQRoutingStage)stage {
+    return (stage >= 0 && stage < FSQRoutingStageCount) ? _startTimes[stage] : 0;
+}
+
+- (uint64_t)endTimeForStage:(FSQRoutingStage)stage {
+    return (stage >= 0 && stage < FSQRoutingStageCount) ? _endTimes[stage] : 0;
+}
+
+- (uint64_t)durationOfStage:(FSQRoutingStage)stage {
+    uint64_t endTime = [self endTimeForStage:stage];
+    return (endTime > 0) ? endTime - [self startTimeForStage:stage] : 0;
+}
+
+- (void)beginStage:(FSQRoutingStage)stage {
+    _startTimes[stage] = FSQMonotonicNanoseconds();
+}
+
+- (void)endStage:(FSQRoutingStage)stage {
+    _endTimes[stage] = FSQMonotonicNanoseconds();
+    [_observer routingMetrics:self didEndStage:stage];
+}
+
+- (void)recordRouteIndex:(NSUInteger)routeIndex numberOfRoutesTried:(NSUInteger)numberOfRoutesTried {
+    _routeIndex = routeIndex;
+    _numberOfRoutesTried = numberOfRoutesTried;
+}
+
+- (void)recordUsedPrewarmedContent {
+    _usedPrewarmedContent = YES;
+}
+
+- (void)finishWithOutcome:(FSQRoutingOutcome)outcome {
+    _outcome = outcome;
+
+    id<FSQRoutingMetricsObserver> observer = _observer;
+    if ([observer respondsToSelector:@selector(routingMetricsDidFinish:)]) {
+        [observer routingMetricsDidFinish:self];
+    }
+
+    /**
+     The recorder is let go first so metrics waiting in its buffer don't keep it alive.
+     */
+    FSQRouteTraceRecorder *traceRecorder = _traceRecorder;
+    _traceRecorder = nil;
+    [traceRecorder recordRoutingMetrics:self];
+}
+
+- (NSString *)debugDescription {
+    NSMutableString *description = [NSMutableString stringWithFormat:@"<%@: %p, url: %@, routeIndex: %@, routesTried: %lu, outcome: %ld",
+                                     self.class, self, self.url,
+                                     (self.routeIndex != NSNotFound ? @(self.routeIndex) : @"none"),
+                                     (unsigned long)self.numberOfRoutesTried, (long)self.outcome];
+
+    for (FSQRoutingStage stage = 0; stage < FSQRoutingStageCount; stage++) {
+        if (_endTimes[stage] > 0) {
+            [description appendFormat:@", stage %ld: %lluns", (long)stage, [self durationOfStage:stage]];
+        }
+    }
+
+    [description appendString:@">"];
+    return description;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -9,13 +9,48 @@
 @import Foundation;
 
 #import "FSQRouteContent.h"
+#import "FSQRouteMatcher.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
+@class FSQRouteAnalysis;
+@class FSQRouteCancellationToken;
 @class FSQRouteContentGenerator;
+@class FSQRouteMatch;
+@class FSQRouteTraceRecord;
+@class FSQRouteTraceRecorder;
 @class FSQRouteUrlData;
+@class FSQRouteUrlTemplate;
+@class FSQRouteViewControllerPool;
+@class FSQRoutingMetrics;
+@protocol FSQRoutingMetricsObserver;
 @protocol FSQUrlRouterDelegate;
 
+/**
+ How the router handles urls which are routed while another route is in progress or deferred.
+ */
+typedef NS_ENUM(NSInteger, FSQRoutingQueuePolicy) {
+    /**
+     Routing a url cancels the route in progress and drops the deferred route (if any). This is the default.
+
+     A url routed while a route is in progress waits until the cancelled route finishes or the next turn of the main
+     queue, whichever comes first. A newer url routed before then replaces it, so in a burst of urls only the first
+     and the last are matched and generated; the ones in between finish as dropped.
+     */
+    FSQRoutingQueuePolicyLatestWins,
+    /**
+     Urls are routed one at a time in the order they were routed. A url routed while another route is in progress
+     or deferred waits in the queue, and is not matched until the routes ahead of it have finished. Deferred routes
+     hold up the queue until they are handled or cleared.
+     */
+    FSQRoutingQueuePolicyFirstInFirstOut,
+    /**
+     The same as FSQRoutingQueuePolicyFirstInFirstOut, except that a url which is equal to a url routed less than
+     `routingQueueDedupeInterval` seconds earlier is dropped without being matched.
+     */
+    FSQRoutingQueuePolicyDedupeWithinInterval,
+};
+
 /**
  The Url Router class takes in url objects that are sent to your app, matches them against a preset mapping that
  you configure at launch time, and then takes the relevant action that corresponds to that url in the map
@@ -31,6 +66,15 @@ NS_ASSUME_NONNULL_BEGIN
                      presented or pushed, but can be any action at all.
  * FSQRouteUrlData - Wraps url, url parameters, and remote/local notification info into a single object.
 
+ Registering route maps, matching urls and generating route content can all be done from any thread. Registered route
+ maps are published as immutable snapshots, so a match that is in progress when new maps are registered finishes
+ against the maps it started with. `urlRouter:shouldGenerateRouteContent:withUrlData:` is called on the thread that
+ called the routing method. Every delegate callback after content generation is made on the main queue, even when an
+ asynchronous generator completes on another thread.
+
+ By default only the most recently routed url is ever presented. Routing a new url cancels the route in progress
+ (see FSQRouteCancellationToken), so content from an asynchronous generator that finishes after a newer url was
+ routed is dropped. Set `routingQueuePolicy` to route urls in order instead.
  */
 @interface FSQUrlRouter : NSObject
 
@@ -51,6 +95,31 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, copy, nullable) FSQRoutePresentation defaultRoutedUrlPresentation;
 
+/**
+ Route content generated by the router which does not have a reuse pool of its own gets this one. The default is nil,
+ so view controllers are only reused if you set a pool here (or on the content) and your generators give their
+ content a `reuseIdentifier`. See FSQRouteViewControllerPool.
+ */
+@property (nonatomic, strong, nullable) FSQRouteViewControllerPool *viewControllerReusePool;
+
+/**
+ If set, the observer is sent a FSQRoutingMetrics object with timings for each stage of every routing pass started
+ by `routeUrl:` and its variants. See FSQRoutingMetrics.h for the stages that are measured.
+
+ Metrics are only collected while an observer is set. Without one, routing does not read the clock or allocate
+ anything extra.
+ */
+@property (atomic, weak, nullable) id<FSQRoutingMetricsObserver> metricsObserver;
+
+/**
+ If set, every routing pass started by `routeUrl:` and its variants is appended to the recorder's trace file when it
+ finishes, with the same timings the metrics observer gets. Traces can be read back with FSQRouteTraceRecord and
+ replayed against a route map with `replayTraceRecords:`.
+
+ Like metrics, nothing is recorded or timed while this is nil.
+ */
+@property (atomic, strong, nullable) FSQRouteTraceRecorder *traceRecorder;
+
 /**
  This is the designated initializer for the class.
 
@@ -92,14 +161,182 @@ NS_ASSUME_NONNULL_BEGIN
 
  Univeral Links are urls which are https schemes. The host part of the url is eg `example.com`
 
+ Hosts can also be patterns like `*.example.com`, which match every subdomain of example.com (but not example.com
+ itself). A url whose host is registered exactly uses that host's map. Otherwise the longest matching pattern wins,
+ eg `*.api.example.com` is used instead of `*.example.com` for `eu.api.example.com`. Hosts and patterns are
+ compared case insensitively.
+
+ The map is compiled once and shared by every host and pattern in the array, so registering one map for many hosts
+ in a single call costs the same as registering it for one.
+
  See `registerNativeSchemes:forRouteMap:` method description for a discussion of route maps.
 
- @param hosts The hosts you want to use this route map.
+ @param hosts The hosts or host patterns you want to use this route map.
  @param map   The route map to be used when receiving universal link urls with the specified hosts.
  */
 - (void)registerUniversalLinkHosts:(NSArray<NSString *> *)hosts
                        forRouteMap:(NSArray<NSArray *> *)map;
 
+/**
+ Registers a route map for a set of native url schemes, comparing the static components of its routes with urls
+ using the given options (eg case insensitively).
+
+ The route strings' static components are folded once here, and each url's path components are folded once when it
+ is matched against the map, so matching costs about the same as with no options. Parameter values are passed on
+ exactly as they appear in the url. Routes added to the map later with `addRoute:generator:forNativeSchemes:` are
+ folded the same way.
+
+ See `registerNativeSchemes:forRouteMap:` for a discussion of route maps.
+ */
+- (void)registerNativeSchemes:(NSArray<NSString *> *)schemes
+                  forRouteMap:(NSArray<NSArray *> *)map
+                      options:(FSQRouteMatchingOptions)options;
+
+/**
+ Registers a route map for a set of universal link hosts, comparing the static components of its routes with urls
+ using the given options.
+
+ See `registerNativeSchemes:forRouteMap:options:` for more information.
+ */
+- (void)registerUniversalLinkHosts:(NSArray<NSString *> *)hosts
+                       forRouteMap:(NSArray<NSArray *> *)map
+                           options:(FSQRouteMatchingOptions)options;
+
+/**
+ Compiles route strings into a compact binary route map that can later be registered with
+ `registerNativeSchemes:forCompiledRouteMapAtUrl:generators:error:`.
+
+ This is meant to be run ahead of time (eg from a build step or a unit test that writes the data into your app
+ bundle), so that the app does not need to parse any route strings at launch.
+
+ The data stores the tokenized routes with every string interned, and does not depend on the device it was made on.
+
+ @param routeStrings The route strings of a route map, in order of precedence. The route at each position gets that
+                     position as its route index. Empty strings are kept as routes which never match, so that the
+                     indexes of the routes after them don't change.
+
+ @return The compiled route map data.
+ */
++ (NSData *)compiledRouteMapDataWithRouteStrings:(NSArray<NSString *> *)routeStrings;
+
+/**
+ Registers a route map compiled with `compiledRouteMapDataWithRouteStrings:` for a set of native url schemes.
+
+ The file is memory mapped and only its layout is checked, so registration does no tokenization work. The routes
+ themselves are loaded the first time a url is matched against this map.
+
+ @param schemes    The schemes you want to use this route map.
+ @param url        The file url of the compiled route map data.
+ @param generators The content generators for the routes, in the same order as the route strings the data was
+                   compiled from.
+ @param error      Set if the data could not be read, is not a valid compiled route map, or does not have
+                   the same number of routes as there are generators.
+
+ @return YES if the route map was registered.
+ */
+- (BOOL)registerNativeSchemes:(NSArray<NSString *> *)schemes
+     forCompiledRouteMapAtUrl:(NSURL *)url
+                   generators:(NSArray<FSQRouteContentGenerator *> *)generators
+                        error:(NSError **)error;
+
+/**
+ Registers a route map compiled with `compiledRouteMapDataWithRouteStrings:` for a set of universal link hosts.
+
+ See `registerNativeSchemes:forCompiledRouteMapAtUrl:generators:error:` for more information.
+ */
+- (BOOL)registerUniversalLinkHosts:(NSArray<NSString *> *)hosts
+          forCompiledRouteMapAtUrl:(NSURL *)url
+                        generators:(NSArray<FSQRouteContentGenerator *> *)generators
+                             error:(NSError **)error;
+
+/**
+ Registers a compiled route map for a set of native url schemes with matching options (see
+ `registerNativeSchemes:forRouteMap:options:`). Compiled route map data is the same whatever the options, its static
+ components are folded when the routes are loaded.
+ */
+- (BOOL)registerNativeSchemes:(NSArray<NSString *> *)schemes
+     forCompiledRouteMapAtUrl:(NSURL *)url
+                   generators:(NSArray<FSQRouteContentGenerator *> *)generators
+                      options:(FSQRouteMatchingOptions)options
+                        error:(NSError **)error;
+
+/**
+ Registers a compiled route map for a set of universal link hosts with matching options.
+
+ See `registerNativeSchemes:forCompiledRouteMapAtUrl:generators:options:error:` for more information.
+ */
+- (BOOL)registerUniversalLinkHosts:(NSArray<NSString *> *)hosts
+          forCompiledRouteMapAtUrl:(NSURL *)url
+                        generators:(NSArray<FSQRouteContentGenerator *> *)generators
+                           options:(FSQRouteMatchingOptions)options
+                             error:(NSError **)error;
+
+/**
+ Adds a single route to the route maps of the given schemes, without recompiling the rest of the map.
+
+ The new route has lower precedence than every route already in the map. Schemes which do not have a route map yet
+ get a new one containing only this route.
+
+ @param routeString The route string to match against. See README.md for a description of valid route strings.
+ @param generator   The content generator to use when a url matches this route.
+ @param schemes     The schemes whose route maps should get the new route.
+ */
+- (void)addRoute:(NSString *)routeString
+       generator:(FSQRouteContentGenerator *)generator
+forNativeSchemes:(NSArray<NSString *> *)schemes;
+
+/**
+ Adds a single route to the route maps of the given universal link hosts.
+
+ See `addRoute:generator:forNativeSchemes:` for more information.
+ */
+- (void)addRoute:(NSString *)routeString
+       generator:(FSQRouteContentGenerator *)generator
+forUniversalLinkHosts:(NSArray<NSString *> *)hosts;
+
+/**
+ Removes every route with the given route string from the route maps of the given schemes.
+
+ Route strings are compared after tokenization, so parameter names must also be the same. The remaining routes keep
+ their precedence and route indexes.
+
+ @return YES if any route was removed.
+ */
+- (BOOL)removeRoute:(NSString *)routeString forNativeSchemes:(NSArray<NSString *> *)schemes;
+
+/**
+ Removes every route with the given route string from the route maps of the given universal link hosts.
+
+ See `removeRoute:forNativeSchemes:` for more information.
+ */
+- (BOOL)removeRoute:(NSString *)routeString forUniversalLinkHosts:(NSArray<NSString *> *)hosts;
+
+/**
+ Replaces the content generator of every route with the given route string in the route maps of the given schemes.
+ The routes keep their precedence and route indexes.
+
+ @return YES if any route was updated.
+ */
+- (BOOL)replaceGeneratorForRoute:(NSString *)routeString
+                   withGenerator:(FSQRouteContentGenerator *)generator
+                forNativeSchemes:(NSArray<NSString *> *)schemes;
+
+/**
+ Replaces the content generator of every route with the given route string in the route maps of the given
+ universal link hosts.
+
+ See `replaceGeneratorForRoute:withGenerator:forNativeSchemes:` for more information.
+ */
+- (BOOL)replaceGeneratorForRoute:(NSString *)routeString
+                   withGenerator:(FSQRouteContentGenerator *)generator
+           forUniversalLinkHosts:(NSArray<NSString *> *)hosts;
+
+/**
+ A counter which is incremented every time the registered routes change (by registering a route map or by adding,
+ removing or replacing a route). Matches made against the same generation always see the same routes.
+ */
+@property (nonatomic, assign, readonly) NSUInteger routeTableGeneration;
+
 /**
  Check if a url matches any of the currently registered route map schemes/hosts.
 
@@ -152,7 +389,8 @@ notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
  Routing can be deferred by the `urlRouter:shouldGenerateRouteContent:withUrlData:` and/or
  `urlRouter:shouldPresentRoute:` delegate methods. See those methods for more information on deferring.
 
- The router can only hold on to one deferred route at a time. If a second route is deferred, the first is dropped.
+ The router can only hold on to one deferred route at a time. With the default routing queue policy, routing another
+ url drops the deferred route. With the other policies, urls routed later wait in the queue behind it.
 
  @return YES if the router currently has a deferred route, NO otherwise.
  */
@@ -162,17 +400,60 @@ notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
  If your delegate ever defers routes, it should call this method whenever it wants the router to try routing its
  deferred route again. This will cause a re-attempt of the deferred route, with the same delegate callbacks.
 
- The router can only hold on to one deferred route at a time. If a second route is deferred, the first is dropped.
+ The router can only hold on to one deferred route at a time. See `hasDeferredRoute`.
 
  @note The route can immediately be re-deferred by the delegate.
  */
 - (void)handleDeferredRoute;
 
 /**
- This removes the deferred route currently being held by the router (if any).
+ This removes the deferred route currently being held by the router (if any). Routes which were queued behind it
+ start routing.
  */
 - (void)clearDeferredRoute;
 
+/**
+ How urls routed while another route is in progress or deferred are handled. The default is
+ FSQRoutingQueuePolicyLatestWins.
+
+ Under the FIFO and dedupe policies, each route must finish (be presented, fail, be cancelled or be deferred) before
+ the next one starts, so your delegate must always call the completion handler of
+ `urlRouter:routedUrlWillBePresented:completionHandler:`. Routes which don't finish within `routingPassTimeout` are
+ cancelled so the queue doesn't stall.
+
+ Under the latest wins policy, routing a url while another route is in progress no longer matches it before
+ `routeUrl:` returns. It starts once the cancelled route finishes or on the next turn of the main queue.
+ */
+@property (nonatomic, assign) FSQRoutingQueuePolicy routingQueuePolicy;
+
+/**
+ The number of seconds during which a url routed again is dropped under FSQRoutingQueuePolicyDedupeWithinInterval.
+ The default is 1 second.
+ */
+@property (nonatomic, assign) NSTimeInterval routingQueueDedupeInterval;
+
+/**
+ The number of seconds a routing pass can stay in progress before the router gives up on it. A pass that times out
+ is cancelled (and reported as cancelled if it carries on later), and the next pending or queued url starts. This
+ keeps the routing queue moving when the delegate never calls the completion handler of
+ `urlRouter:routedUrlWillBePresented:completionHandler:` or an asynchronous generator never completes.
+
+ The default is 30 seconds. Set it to 0 to let routing passes run for as long as they need.
+ */
+@property (atomic, assign) NSTimeInterval routingPassTimeout;
+
+/**
+ The number of routed urls waiting for their turn in the routing queue. This is always 0 under the latest wins
+ policy, which keeps at most one pending url outside the queue.
+ */
+@property (nonatomic, assign, readonly) NSUInteger numberOfQueuedRoutes;
+
+/**
+ Drops every url waiting in the routing queue, and the pending url under the latest wins policy. The route in
+ progress and the deferred route (if any) are not affected.
+ */
+- (void)clearQueuedRoutes;
+
 /**
  This generates a route content object by matching the given url against the registered route map.
 
@@ -194,13 +475,201 @@ notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
  Generating a route content using this method will not actually "route" the object, meaning no delegate callbacks
  are sent and the content object is not presented.
 
+ This never waits for asynchronous generators. Urls matching a route with an asynchronous generator return nil (and
+ assert in debug builds), use `generateRouteContentFromUrl:notificationUserInfo:completion:` for those instead.
+
  @param url                  The url for which you want to generate a route content object from.
  @param notificationUserInfo The notification userInfo dictionary to attach to the content/generators url data.
 
- @return A new FSQRouteContent object if the url matched a registered route map.
+ @return A new FSQRouteContent object if the url matched a registered route map with a synchronous generator.
  */
 - (nullable FSQRouteContent *)generateRouteContentFromUrl:(NSURL *)url
                                      notificationUserInfo:(nullable NSDictionary *)notificationUserInfo;
+
+/**
+ This generates a route content object by matching the given url against the registered route map, without
+ blocking the calling thread while an asynchronous generator runs.
+
+ As with `generateRouteContentFromUrl:notificationUserInfo:`, no delegate callbacks are sent and the content object
+ is not presented. Generating content this way does not cancel (and is not cancelled by) routed urls.
+
+ @param url                  The url for which you want to generate a route content object from.
+ @param notificationUserInfo The notification userInfo dictionary to attach to the content/generators url data.
+ @param completion           Called exactly once with the new content object, or nil if the url did not match, the
+                             generator did not return any content or the generation was cancelled. Synchronous
+                             generators call it before this method returns, asynchronous ones on any thread.
+
+ @return A token which can be used to cancel the generation.
+ */
+- (FSQRouteCancellationToken *)generateRouteContentFromUrl:(NSURL *)url
+                                      notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
+                                                completion:(void (^)(FSQRouteContent *_Nullable routeContent))completion;
+
+/**
+ Matches each of the given urls against the registered route maps, without generating or presenting any content.
+ 
+ This is a convenience method for calling `matchUrls:concurrently:` with concurrently set to NO.
+ 
+ @param urls The urls to match.
+ 
+ @return One match object per url, in the same order as the urls array.
+ */
+- (NSArray<FSQRouteMatch *> *)matchUrls:(NSArray<NSURL *> *)urls;
+
+/**
+ Matches each of the given urls against the registered route maps, without generating or presenting any content.
+ 
+ This is intended for processing large numbers of urls at once (eg auditing or validating links). No delegate
+ callbacks are sent. All urls are matched against the same set of route maps, and urls which appear more than
+ once in the array are only matched once.
+ 
+ @param urls         The urls to match.
+ @param concurrently If YES, matching is split across cores using dispatch_apply. This method still does not
+ return until every url has been matched.
+ 
+ @return One match object per url, in the same order as the urls array. Urls which do not match any route
+ get a match object with `matched` set to NO.
+ */
+- (NSArray<FSQRouteMatch *> *)matchUrls:(NSArray<NSURL *> *)urls concurrently:(BOOL)concurrently;
+
+/**
+ Matches a url against the registered route maps and returns every route it matches, not just the one it would be
+ routed to. No content is generated or presented and no delegate callbacks are sent.
+
+ Use this to see which routes overlap for a url, eg to check that reordering a route map keeps the same route
+ first. The match cache is not used.
+
+ @param url The url to match.
+
+ @return One match per matching route in priority order, so the first one is the match routing would use. Empty if
+ the url does not match any route.
+ */
+- (NSArray<FSQRouteMatch *> *)allMatchesForUrl:(NSURL *)url;
+
+/**
+ Matches the url of each trace record against the registered route maps, timing the url parsing, route map lookup
+ and path matching stages the same way routing does. Nothing is generated or presented and no delegate callbacks
+ are sent, so this can be run headlessly (eg from a unit test or a benchmark) against a router with the same route
+ maps as the app that recorded the trace.
+
+ Compare the route indexes and stage durations of the returned metrics with those of the records to check a matcher
+ change against real traffic. Every record's url is matched once, in order, whatever the outcome of its original
+ routing pass was. The match cache is used if it is enabled. The metrics observer is not sent the replayed metrics,
+ and they are not recorded by the trace recorder.
+
+ @param records Records read with `+[FSQRouteTraceRecord recordsFromTraceAtUrl:error:]`.
+
+ @return One metrics object per record, in the same order. Urls which did not match have the outcome
+ FSQRoutingOutcomeFailedToMatch, the others are left as FSQRoutingOutcomeInProgress.
+ */
+- (NSArray<FSQRoutingMetrics *> *)replayTraceRecords:(NSArray<FSQRouteTraceRecord *> *)records;
+
+/**
+ Creates a template for building urls which match one of the routes registered for a native scheme.
+
+ Use this instead of formatting url strings by hand, so urls your app builds can't drift from its route maps. The
+ route string is parsed once here. Keep the template around and use it for every url you build from that route.
+
+ @param routeString The route string, as it was registered. Parameter names must be the same.
+ @param scheme      The native scheme the route is registered for.
+
+ @return A new template, or nil if no such route is registered for the scheme or the route has wildcards.
+ */
+- (nullable FSQRouteUrlTemplate *)urlTemplateForRoute:(NSString *)routeString nativeScheme:(NSString *)scheme;
+
+/**
+ Creates a template for building universal links which match one of the routes registered for a host.
+
+ The host should be the host the urls will use. If it is only registered through a host pattern, the pattern's map
+ is used.
+
+ See `urlTemplateForRoute:nativeScheme:` for more information.
+ */
+- (nullable FSQRouteUrlTemplate *)urlTemplateForRoute:(NSString *)routeString universalLinkHost:(NSString *)host;
+
+/**
+ Analyzes the route map registered for a native scheme, reporting routes which are shadowed by (or duplicates of)
+ an earlier route, and the matching cost of each route. See FSQRouteAnalysis.
+
+ The analysis walks the map's trie once per route. Run it after registering your route maps (eg from a unit test or
+ a debug build) rather than on every launch.
+
+ @return One analysis per route, in route index order, or nil if no route map is registered for the scheme.
+ */
+- (nullable NSArray<FSQRouteAnalysis *> *)routeAnalysesForNativeScheme:(NSString *)scheme;
+
+/**
+ Analyzes the route map registered for a universal link host. If the host is only registered through a host
+ pattern, the pattern's map is analyzed.
+
+ See `routeAnalysesForNativeScheme:` for more information.
+ */
+- (nullable NSArray<FSQRouteAnalysis *> *)routeAnalysesForUniversalLinkHost:(NSString *)host;
+
+/**
+ The maximum number of match results the router keeps cached. The default is 0, which disables the cache.
+ 
+ The cache is keyed by the scheme (or universal link host) and normalized path of a url. It stores the matched route 
+ and the parameters parsed out of the path, so urls which are routed repeatedly skip matching entirely. Query
+ parameters are never cached and are parsed fresh for every url. Urls with no path are not cached.
+ 
+ The cache is invalidated whenever the registered routes change. Least recently used results are evicted first.
+ Setting this back to 0 releases the cache and resets its hit and miss counts.
+ */
+@property (nonatomic, assign) NSUInteger matchCacheCapacity;
+
+/**
+ The number of urls matched using a cached result since the cache was enabled.
+ */
+@property (nonatomic, assign, readonly) NSUInteger matchCacheHitCount;
+
+/**
+ The number of urls which were looked up in the cache but had to be matched against the route maps.
+ */
+@property (nonatomic, assign, readonly) NSUInteger matchCacheMissCount;
+
+/**
+ This is a convenience method for calling `prewarmUrl:notificationUserInfo:` with the notification dictionary set
+ to nil.
+
+ @param url The url to prewarm.
+ */
+- (void)prewarmUrl:(NSURL *)url;
+
+/**
+ Matches the given url and generates its route content ahead of time, so that routing the same url later skips
+ matching and generation and goes straight to presentation.
+
+ This is intended for urls which are likely to be routed soon, eg the url of a notification which has been
+ delivered but not opened yet. No delegate callbacks are sent while prewarming. If the content's view controller
+ is created from a class, it is also instantiated ahead of time.
+
+ The url is matched on a background queue. The generator is then called on the main queue, as it would be when
+ routing from the main queue, so synchronous generators do not need to be thread safe. Asynchronous generators may
+ complete on any thread, and view controllers are always instantiated on the main queue.
+
+ When `routeUrl:notificationUserInfo:` is called with an equal url and an equal notification userInfo, the
+ prewarmed content is taken out of the cache and used instead of generating new content. The delegate still gets
+ its `urlRouter:shouldGenerateRouteContent:withUrlData:` callback. Content prewarmed with a different userInfo is
+ discarded and the url is routed normally, as are urls which are routed before their content is ready.
+
+ Prewarmed content is used at most once, and is discarded if the registered routes change before it is used.
+
+ @param url                  The url to prewarm.
+ @param notificationUserInfo The notification userInfo dictionary to attach to the url data during generation.
+ */
+- (void)prewarmUrl:(NSURL *)url notificationUserInfo:(nullable NSDictionary *)notificationUserInfo;
+
+/**
+ The maximum number of prewarmed content objects the router keeps. The default is 3. When more urls are prewarmed,
+ the oldest content is discarded first. Setting this to 0 discards all prewarmed content and disables prewarming.
+ */
+@property (nonatomic, assign) NSUInteger prewarmedContentCapacity;
+
+/**
+ Discards all prewarmed content which has not been used yet, eg in response to a memory warning.
+ */
+- (void)clearPrewarmedContent;
 @end
 
 /**
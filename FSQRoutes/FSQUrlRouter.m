@@ -8,36 +8,319 @@
 
 #import "FSQUrlRouter.h"
 
+#import "FSQRouteCancellationToken.h"
 #import "FSQRouteContent.h"
 #import "FSQRouteContentGenerator.h"
+#import "FSQRouteMatch.h"
+#import "FSQRouteMatchingCore.h"
+#import "FSQRouteTraceRecorder.h"
 #import "FSQRouteUrlData.h"
+#import "FSQRouteUrlTemplate.h"
+#import "FSQRouteViewControllerPool.h"
+#import "FSQRoutingMetrics.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
+@class FSQRouteTable;
+@class FSQRouteMatchCache;
+@class FSQPrewarmedRouteContentCache;
+@class FSQPendingRoute;
+
+/**
+ Runs a routing pass for a route once it leaves the routing queue.
+ */
+typedef void (^FSQRoutingPassBlock)(FSQUrlRouter *router, FSQRouteCancellationToken *cancellationToken);
+
 @interface FSQUrlRouter ()
-@property (nonatomic, strong, nullable) NSMutableDictionary<NSString *, NSArray<NSArray *> *> *nativeSchemeRouteMaps;
-@property (nonatomic, strong, nullable) NSMutableDictionary<NSString *, NSArray<NSArray *> *> *httpHostRouteMaps;
+/**
+ The currently registered route maps. This is an immutable snapshot which is replaced (never mutated) whenever maps
+ are registered, so matching can read it from any thread without taking a lock.
+ */
+@property (atomic, strong) FSQRouteTable *routeTable;
 
+/**
+ Serializes registrations so that two concurrent registrations can't both copy the same table and drop each 
+ other's changes. Matching never takes this lock.
+ */
+@property (nonatomic, strong, readonly) NSLock *registrationLock;
+
+/**
+ Reads and writes of deferredRoute go through this lock so that handleDeferredRoute can take the route out of the
+ slot atomically.
+ */
+@property (nonatomic, strong, readonly) NSLock *deferredRouteLock;
 @property (nonatomic, copy, nullable) void (^deferredRoute)(FSQUrlRouter *router);
+
+/**
+ Nil unless matchCacheCapacity has been set to a non-zero value.
+ */
+@property (atomic, strong, nullable) FSQRouteMatchCache *matchCache;
+
+/**
+ The cancellation token of the most recently started routing pass. Starting a new pass cancels it, so content that
+ is still being generated or waiting to be presented for an older url is dropped.
+ */
+@property (nonatomic, strong, readonly) NSLock *routingPassLock;
+@property (nonatomic, strong, nullable) FSQRouteCancellationToken *currentRoutingPassCancellationToken;
+
+/**
+ Routes waiting for their turn under the FIFO and dedupe policies, oldest first. Nothing is parsed or matched until
+ a route leaves the queue, so queued routes which are dropped cost nothing but their block.
+
+ This, routingPassInProgress and recentRouteRequestTimes are guarded by routingPassLock.
+ */
+@property (nonatomic, strong, readonly) NSMutableArray<FSQRoutingPassBlock> *queuedRoutes;
+@property (nonatomic, assign) BOOL routingPassInProgress;
+
+/**
+ Under the latest wins policy, the newest url requested while a routing pass was in progress. A newer url replaces
+ it before it is ever parsed or matched. Guarded by routingPassLock.
+ */
+@property (nonatomic, strong, nullable) FSQPendingRoute *latestPendingRoute;
+
+/**
+ When each url was last requested, for the dedupe policy. Entries older than the dedupe interval are pruned every
+ time a url is requested.
+ */
+@property (nonatomic, strong, readonly) NSMutableDictionary<NSURL *, NSNumber *> *recentRouteRequestTimes;
+
+@property (nonatomic, strong, readonly) FSQPrewarmedRouteContentCache *prewarmedContentCache;
+
+/**
+ The compiled map of every route map registered with `registerNativeSchemes:forRouteMap:` or
+ `registerUniversalLinkHosts:forRouteMap:`, keyed by the route map array itself. Registering the same array again
+ (eg for another batch of hosts) reuses the compiled map instead of tokenizing it again.
+
+ Keys are compared by identity, so looking a map up never compares route maps (or their generators) element by
+ element. Both keys and values are weak, so the table never keeps route maps, their generators or compiled maps
+ alive.
+
+ Guarded by @synchronized on the table itself.
+ */
+@property (nonatomic, strong, readonly) NSMapTable<NSArray<NSArray *> *, FSQCompiledRouteMap *> *compiledRouteMapsBySourceMap;
+@end
+
+/**
+ Recording methods for routing metrics, which are only used by the router.
+ 
+ Messages to a nil metrics object do nothing, so the routing code calls these unconditionally and routing without
+ a metrics observer or trace recorder doesn't read the clock or allocate anything.
+ */
+@interface FSQRoutingMetrics (Recording)
+- (instancetype)initWithUrl:(nullable NSURL *)url
+       notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
+                   observer:(nullable id<FSQRoutingMetricsObserver>)observer
+              traceRecorder:(nullable FSQRouteTraceRecorder *)traceRecorder
+        resumedFromDeferral:(BOOL)resumedFromDeferral;
+- (void)beginStage:(FSQRoutingStage)stage;
+- (void)endStage:(FSQRoutingStage)stage;
+- (void)recordRouteIndex:(NSUInteger)routeIndex numberOfRoutesTried:(NSUInteger)numberOfRoutesTried;
+- (void)recordUsedPrewarmedContent;
+- (void)finishWithOutcome:(FSQRoutingOutcome)outcome;
+@end
+
+/**
+ Templates are only created by the router, from routes it has already tokenized.
+
+ @param urlPrefix        The scheme (and universal link host) part of the url, which the path components follow.
+ @param pathComponents   The static strings and parameter names of the route, in order.
+ @param parameterIndexes The indexes of the path components which are parameter names.
+ */
+@interface FSQRouteUrlTemplate (Compiling)
+- (instancetype)initWithRouteString:(NSString *)routeString
+                          urlPrefix:(NSString *)urlPrefix
+                     pathComponents:(NSArray<NSString *> *)pathComponents
+                   parameterIndexes:(NSIndexSet *)parameterIndexes;
+@end
+
+/**
+ Url data for a match keeps the route's path parameters and the url's raw query items apart, and only unescapes the
+ query items as they are asked for.
+
+ @param urlData Url data whose parameters are shared, decoded or not, for a repeated url.
+ */
+@interface FSQRouteUrlData (Matching)
+- (instancetype)initWithUrl:(NSURL *)url
+             pathParameters:(nullable NSDictionary<NSString *, NSString *> *)pathParameters
+                 queryItems:(nullable NSArray<NSURLQueryItem *> *)queryItems;
+/**
+ Url data with only query parameters, whose names and values are used as they are instead of being unescaped.
+ */
+- (instancetype)initWithUrl:(NSURL *)url rawQueryItems:(nullable NSArray<NSURLQueryItem *> *)queryItems;
+- (instancetype)initWithUrl:(NSURL *)url parametersOfUrlData:(FSQRouteUrlData *)urlData;
+@end
+
+/**
+ Prewarming instantiates the content's view controller ahead of presentation, using the same method presentation
+ does so both create it the same way.
+ */
+@interface FSQRouteContent (Prewarming)
+- (nullable UIViewController *)viewControllerToPresent;
+@end
+
+/**
+ A trie of the universal link host patterns (eg "*.example.com") registered on a router.
+
+ Patterns are stored by their labels in reverse order, so "*.example.com" is the node reached through "com" and then
+ "example". A host is resolved by walking its own labels from the right, which costs the same however many patterns
+ are registered, and the deepest pattern passed on the way wins.
+
+ Tries are built once per route table and never mutated afterwards.
+ */
+@interface FSQHostPatternTrieNode : NSObject
+@property (nonatomic, strong, readonly) NSMutableDictionary<NSString *, FSQHostPatternTrieNode *> *children;
+
+/**
+ The map registered for the pattern made of "*." followed by the labels leading to this node, if any.
+ */
+@property (nonatomic, strong, nullable) FSQCompiledRouteMap *subdomainRouteMap;
+
+/**
+ @return The root of a trie of the host patterns in `httpHostRouteMaps`, or nil if none of its keys are patterns.
+ */
++ (nullable instancetype)trieWithHttpHostRouteMaps:(NSDictionary<NSString *, FSQCompiledRouteMap *> *)httpHostRouteMaps;
+
+- (nullable FSQCompiledRouteMap *)routeMapForReversedHostLabels:(NSArray<NSString *> *)reversedHostLabels;
+@end
+
+/**
+ An immutable snapshot of all the route maps registered on a router.
+ */
+@interface FSQRouteTable : NSObject
+@property (nonatomic, copy, readonly) NSDictionary<NSString *, FSQCompiledRouteMap *> *nativeSchemeRouteMaps;
+
+/**
+ Route maps by universal link host. Keys starting with "*." are host patterns, which are also indexed in
+ hostPatternTrie.
+ */
+@property (nonatomic, copy, readonly) NSDictionary<NSString *, FSQCompiledRouteMap *> *httpHostRouteMaps;
+@property (nonatomic, strong, readonly, nullable) FSQHostPatternTrieNode *hostPatternTrie;
+
+/**
+ Incremented every time a new table is published.
+ */
+@property (nonatomic, assign, readonly) NSUInteger generation;
+
+/**
+ @param hostPatternTrie The trie of the patterns in httpHostRouteMaps. Tables which only change native scheme maps
+                        pass on the previous table's trie instead of building a new one.
+ */
+- (instancetype)initWithNativeSchemeRouteMaps:(NSDictionary<NSString *, FSQCompiledRouteMap *> *)nativeSchemeRouteMaps
+                            httpHostRouteMaps:(NSDictionary<NSString *, FSQCompiledRouteMap *> *)httpHostRouteMaps
+                              hostPatternTrie:(nullable FSQHostPatternTrieNode *)hostPatternTrie
+                                   generation:(NSUInteger)generation;
+
+- (nullable FSQCompiledRouteMap *)routeMapForParsedUrl:(FSQParsedRouteUrl *)parsedUrl;
+
+/**
+ Looks up the map of a universal link host the same way as urls are, falling back to host patterns.
+ */
+- (nullable FSQCompiledRouteMap *)routeMapForUniversalLinkHost:(NSString *)host;
+@end
+
+/**
+ Identifies the route map and normalized path of a url, ignoring its query. Two urls with equal keys always match 
+ the same route with the same path parameters.
+ */
+@interface FSQRouteMatchCacheKey : NSObject <NSCopying>
+- (instancetype)initWithParsedUrl:(FSQParsedRouteUrl *)parsedUrl;
+@end
+
+/**
+ The part of a match which only depends on a url's path. A nil route means no route matched.
+ */
+@interface FSQRouteMatchCacheEntry : NSObject
+@property (nonatomic, strong, readonly) FSQRouteMatchCacheKey *key;
+@property (nonatomic, strong, readonly, nullable) FSQCompiledRoute *route;
+@property (nonatomic, copy, readonly, nullable) NSDictionary<NSString *, NSString *> *pathParameters;
+
+/**
+ Neighbors in the cache's recency list. The cache's dictionary owns the entries, so these are not retained.
+ */
+@property (nonatomic, unsafe_unretained, nullable) FSQRouteMatchCacheEntry *newerEntry;
+@property (nonatomic, unsafe_unretained, nullable) FSQRouteMatchCacheEntry *olderEntry;
+
+- (instancetype)initWithKey:(FSQRouteMatchCacheKey *)key
+                      route:(nullable FSQCompiledRoute *)route
+             pathParameters:(nullable NSDictionary<NSString *, NSString *> *)pathParameters;
+@end
+
+/**
+ A bounded, least recently used cache of match results.
+ 
+ Entries are only valid for the route table generation they were stored for. The first lookup or store for a 
+ newer generation empties the cache, so registering or updating routes invalidates it without the registration
+ code having to know about it.
+ */
+@interface FSQRouteMatchCache : NSObject
+@property (nonatomic, assign) NSUInteger capacity;
+@property (nonatomic, assign, readonly) NSUInteger hitCount;
+@property (nonatomic, assign, readonly) NSUInteger missCount;
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+- (nullable FSQRouteMatchCacheEntry *)entryForKey:(FSQRouteMatchCacheKey *)key generation:(NSUInteger)generation;
+- (void)addEntry:(FSQRouteMatchCacheEntry *)entry generation:(NSUInteger)generation;
 @end
 
-typedef NS_ENUM(NSInteger, FSQRouteUrlTokenType) {
-    FSQRouteUrlTokenTypeString,
-    FSQRouteUrlTokenTypeParameter,
-    FSQRouteUrlTokenTypeSingleComponentWildcard,
-    FSQRouteUrlTokenTypeUnlimitedComponentWildcard
-};
-
-@interface FSQRouteUrlToken : NSObject 
-@property (nonatomic, assign, readonly) FSQRouteUrlTokenType type;
-@property (nonatomic, copy, nullable, readonly) NSString *stringOrParameterName;
-
-+ (instancetype)withString:(NSString *)string;
-+ (instancetype)withParameterName:(NSString *)parameterName;
-+ (instancetype)singleComponentWildCard;
-+ (instancetype)unlimitedComponentWildCard;
+/**
+ Content generated by `prewarmUrl:notificationUserInfo:`, along with the match it was generated for.
+ */
+@interface FSQPrewarmedRouteContent : NSObject
+@property (nonatomic, strong, readonly) FSQRouteMatch *match;
+@property (nonatomic, strong, readonly) FSQRouteContent *routeContent;
+@property (nonatomic, copy, readonly, nullable) NSDictionary *notificationUserInfo;
+
+- (instancetype)initWithMatch:(FSQRouteMatch *)match
+                 routeContent:(FSQRouteContent *)routeContent
+         notificationUserInfo:(nullable NSDictionary *)notificationUserInfo;
+@end
+
+/**
+ A small bounded cache of prewarmed content, keyed by url. The oldest content is evicted first.
+
+ Content objects can only be presented once, so lookups take the content out of the cache. Content prewarmed
+ against an older route table generation than the one being routed against, or with a different notification
+ userInfo than the one being routed with, is discarded instead of returned.
+ */
+@interface FSQPrewarmedRouteContentCache : NSObject
+@property (nonatomic, assign) NSUInteger capacity;
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+- (BOOL)hasContentForUrl:(NSURL *)url
+    notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
+              generation:(NSUInteger)generation;
+- (nullable FSQPrewarmedRouteContent *)takeContentForUrl:(NSURL *)url
+                                    notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
+                                              generation:(NSUInteger)generation;
+- (void)addContent:(FSQPrewarmedRouteContent *)content;
+- (void)removeAllContent;
+@end
+
+/**
+ A route waiting to start under the latest wins policy.
+ */
+@interface FSQPendingRoute : NSObject
+@property (nonatomic, strong, readonly, nullable) NSURL *url;
+@property (nonatomic, copy, readonly, nullable) NSDictionary *notificationUserInfo;
+@property (nonatomic, copy, readonly) FSQRoutingPassBlock routingPass;
+
+- (instancetype)initWithUrl:(nullable NSURL *)url
+       notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
+                routingPass:(FSQRoutingPassBlock)routingPass;
 @end
 
+/**
+ Runs the block right away on the main thread, or asynchronously on the main queue from any other thread.
+ */
+static void FSQPerformOnMainQueue(dispatch_block_t block) {
+    if ([NSThread isMainThread]) {
+        block();
+    }
+    else {
+        dispatch_async(dispatch_get_main_queue(), block);
+    }
+}
+
 @implementation FSQUrlRouter
 
 - (instancetype)init NS_UNAVAILABLE {
@@ -48,6 +331,21 @@ typedef NS_ENUM(NSInteger, FSQRouteUrlTokenType) {
     self = [super init];
     if (self) {
         self.delegate = delegate;
+        _registrationLock = [NSLock new];
+        _deferredRouteLock = [NSLock new];
+        _routingPassLock = [NSLock new];
+        _queuedRoutes = [NSMutableArray new];
+        _recentRouteRequestTimes = [NSMutableDictionary new];
+        _routingQueueDedupeInterval = 1;
+        _routingPassTimeout = 30;
+        _prewarmedContentCache = [[FSQPrewarmedRouteContentCache alloc] initWithCapacity:3];
+        _compiledRouteMapsBySourceMap = [[NSMapTable alloc] initWithKeyOptions:(NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPointerPersonality)
+                                                                  valueOptions:NSPointerFunctionsWeakMemory
+                                                                      capacity:0];
+        self.routeTable = [[FSQRouteTable alloc] initWithNativeSchemeRouteMaps:@{}
+                                                             httpHostRouteMaps:@{}
+                                                               hostPatternTrie:nil
+                                                                    generation:0];
     }
     return self;
 }
@@ -56,109 +354,323 @@ typedef NS_ENUM(NSInteger, FSQRouteUrlTokenType) {
 
 - (void)registerNativeSchemes:(NSArray<NSString *> *)schemes 
                   forRouteMap:(NSArray<NSArray *> *)map {
+    [self registerNativeSchemes:schemes forRouteMap:map options:FSQRouteMatchingOptionsNone];
+}
 
-    if (!self.nativeSchemeRouteMaps) {
-        self.nativeSchemeRouteMaps = [NSMutableDictionary dictionary];
-    }
+- (void)registerUniversalLinkHosts:(NSArray<NSString *> *)hosts
+                       forRouteMap:(NSArray<NSArray *> *)map {
+    [self registerUniversalLinkHosts:hosts forRouteMap:map options:FSQRouteMatchingOptionsNone];
+}
+
+- (void)registerNativeSchemes:(NSArray<NSString *> *)schemes
+                  forRouteMap:(NSArray<NSArray *> *)map
+                      options:(FSQRouteMatchingOptions)options {
     
-    map = [self tokenizeRouteMap:map];
+    /**
+     Tokenizing and compiling is done before taking the registration lock, only publishing the new table 
+     is serialized.
+     */
+    FSQCompiledRouteMap *compiledMap = [self compiledRouteMapForRouteMap:map options:options];
     
-    for (NSString *scheme in schemes) {
-        self.nativeSchemeRouteMaps[scheme] = map;
-    }
+    [self updateRouteMapsForKeys:schemes 
+                isNativeSchemes:YES 
+                     usingBlock:^FSQCompiledRouteMap *(FSQCompiledRouteMap *routeMap) {
+                         return compiledMap;
+                     }];
 }
 
 - (void)registerUniversalLinkHosts:(NSArray<NSString *> *)hosts 
-                       forRouteMap:(NSArray<NSArray *> *)map {
+                       forRouteMap:(NSArray<NSArray *> *)map
+                           options:(FSQRouteMatchingOptions)options {
+    
+    FSQCompiledRouteMap *compiledMap = [self compiledRouteMapForRouteMap:map options:options];
+    
+    [self updateRouteMapsForKeys:hosts 
+                isNativeSchemes:NO 
+                     usingBlock:^FSQCompiledRouteMap *(FSQCompiledRouteMap *routeMap) {
+                         return compiledMap;
+                     }];
+}
 
-    if (!self.httpHostRouteMaps) {
-        self.httpHostRouteMaps = [NSMutableDictionary dictionary];
+/**
+ @return The compiled map of the same route map array with the same options if it is still registered somewhere,
+ or a newly compiled one.
+ */
+- (FSQCompiledRouteMap *)compiledRouteMapForRouteMap:(NSArray<NSArray *> *)map options:(FSQRouteMatchingOptions)options {
+    NSMapTable<NSArray<NSArray *> *, FSQCompiledRouteMap *> *compiledMaps = self.compiledRouteMapsBySourceMap;
+    FSQCompiledRouteMap *compiledMap = nil;
+    
+    @synchronized (compiledMaps) {
+        compiledMap = [compiledMaps objectForKey:map];
     }
     
-    map = [self tokenizeRouteMap:map];
+    if (compiledMap.options != options) {
+        compiledMap = nil;
+    }
     
-    for (NSString *host in hosts) {
-        self.httpHostRouteMaps[host] = map;
+    if (compiledMap == nil) {
+        compiledMap = [[FSQCompiledRouteMap alloc] initWithTokenizedRouteMap:[self tokenizeRouteMap:map options:options]
+                                                                     options:options];
+        
+        /**
+         Copying an immutable array returns the array itself. A mutable array could change before it is registered
+         again, so its entry is keyed by a copy that nothing else holds and which goes away straight away.
+         */
+        @synchronized (compiledMaps) {
+            [compiledMaps setObject:compiledMap forKey:[map copy]];
+        }
     }
+    
+    return compiledMap;
 }
 
-- (NSArray<NSString *> *)normalizePathComponents:(NSArray<NSString *> *)pathComponents {
-    NSMutableArray<NSString *> *normalizedComponents = [NSMutableArray new];
-    for (NSString *component in pathComponents) {
-        if (component.length > 0
-            && ![component isEqualToString:@"/"]) {
-            [normalizedComponents addObject:[self unescapedStringFromString:component]];
-        }
+#pragma mark - Compiled route maps -
+
++ (NSData *)compiledRouteMapDataWithRouteStrings:(NSArray<NSString *> *)routeStrings {
+    return FSQCompiledRouteMapDataWithRouteStrings(routeStrings);
+}
+
+- (BOOL)registerNativeSchemes:(NSArray<NSString *> *)schemes
+     forCompiledRouteMapAtUrl:(NSURL *)url
+                   generators:(NSArray<FSQRouteContentGenerator *> *)generators
+                        error:(NSError **)error {
+    return [self registerNativeSchemes:schemes
+              forCompiledRouteMapAtUrl:url
+                            generators:generators
+                               options:FSQRouteMatchingOptionsNone
+                                 error:error];
+}
+
+- (BOOL)registerUniversalLinkHosts:(NSArray<NSString *> *)hosts
+          forCompiledRouteMapAtUrl:(NSURL *)url
+                        generators:(NSArray<FSQRouteContentGenerator *> *)generators
+                             error:(NSError **)error {
+    return [self registerUniversalLinkHosts:hosts
+                   forCompiledRouteMapAtUrl:url
+                                 generators:generators
+                                    options:FSQRouteMatchingOptionsNone
+                                      error:error];
+}
+
+- (BOOL)registerNativeSchemes:(NSArray<NSString *> *)schemes
+     forCompiledRouteMapAtUrl:(NSURL *)url
+                   generators:(NSArray<FSQRouteContentGenerator *> *)generators
+                      options:(FSQRouteMatchingOptions)options
+                        error:(NSError **)error {
+    return [self registerKeys:schemes isNativeSchemes:YES forCompiledRouteMapAtUrl:url generators:generators options:options error:error];
+}
+
+- (BOOL)registerUniversalLinkHosts:(NSArray<NSString *> *)hosts
+          forCompiledRouteMapAtUrl:(NSURL *)url
+                        generators:(NSArray<FSQRouteContentGenerator *> *)generators
+                           options:(FSQRouteMatchingOptions)options
+                             error:(NSError **)error {
+    return [self registerKeys:hosts isNativeSchemes:NO forCompiledRouteMapAtUrl:url generators:generators options:options error:error];
+}
+
+- (BOOL)registerKeys:(NSArray<NSString *> *)keys
+     isNativeSchemes:(BOOL)isNativeSchemes
+forCompiledRouteMapAtUrl:(NSURL *)url
+          generators:(NSArray<FSQRouteContentGenerator *> *)generators
+             options:(FSQRouteMatchingOptions)options
+               error:(NSError **)error {
+    /**
+     The file is mapped rather than read, so pages are only faulted in when the trie is built on first use.
+     */
+    NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedAlways error:error];
+    if (data == nil) {
+        return NO;
+    }
+    
+    FSQCompiledRouteMap *compiledMap = [[FSQCompiledRouteMap alloc] initWithCompiledRouteMapData:data
+                                                                                      generators:generators
+                                                                                         options:options
+                                                                                           error:error];
+    if (compiledMap == nil) {
+        return NO;
     }
-    return normalizedComponents.copy;
+    
+    [self updateRouteMapsForKeys:keys
+                 isNativeSchemes:isNativeSchemes
+                      usingBlock:^FSQCompiledRouteMap *(FSQCompiledRouteMap *routeMap) {
+                          return compiledMap;
+                      }];
+    return YES;
+}
+
+- (NSUInteger)routeTableGeneration {
+    return self.routeTable.generation;
 }
 
-- (NSArray<FSQRouteUrlToken *> *)tokenizedRouteString:(NSString *)urlString {
-    NSMutableArray<FSQRouteUrlToken *> *tokenizedURL = [NSMutableArray new];
+/**
+ Applies `update` to the route map of each of the given schemes (or hosts) and publishes a new route table with
+ the results.
+ 
+ Schemes or hosts without a map get an empty one passed in. Maps that are shared between several of the keys are
+ only updated once, so they stay shared afterwards. If the block returns nil for every map, no new table is 
+ published.
+ 
+ @return YES if a new route table was published.
+ */
+- (BOOL)updateRouteMapsForKeys:(NSArray<NSString *> *)keys
+               isNativeSchemes:(BOOL)isNativeSchemes
+                    usingBlock:(FSQCompiledRouteMap *_Nullable (^)(FSQCompiledRouteMap *routeMap))update {
     
-    FSQRouteUrlToken *lastAddedToken = nil;
+    FSQCompiledRouteMap *emptyMap = [[FSQCompiledRouteMap alloc] initWithTokenizedRouteMap:@[]];
+    BOOL didUpdate = NO;
     
-    NSArray *pathComponents = [self normalizePathComponents:[urlString pathComponents]];
-    for (NSString *string in pathComponents) {
-        FSQRouteUrlToken *token = nil;
-        if ([string isEqualToString:@"*"]) {
-            token = [FSQRouteUrlToken singleComponentWildCard];
-        }
-        else if ([string isEqualToString:@"**"]) {
-            if (lastAddedToken.type == FSQRouteUrlTokenTypeUnlimitedComponentWildcard) {
-                /**
-                 Don't add a multiple unlimited wildcards in a row because it is redundant
-                 */
-            }
-            else if (lastAddedToken.type == FSQRouteUrlTokenTypeParameter) {
-                /**
-                 We shouldn't completely wrap a parameter token with unlimited wildcard tokens, because parsing
-                 that is ambigious. eg matching against @"/ ** / :aParameter / ** /" can't work because we
-                 won't know which path component the parameter should match to.
-                 
-                 If we think we might be in this case, do some checking to see if we are surrounding a 
-                 parameter token and if we are, assert and skip adding this route.
-                 
-                 There are other ambiguous cases, but we won't bother trying to catch them all.
-                 */
-                
-                NSUInteger possibleOtherWildcardIndex = tokenizedURL.count - 2;
-                if (possibleOtherWildcardIndex > 0) {
-                    if (tokenizedURL[possibleOtherWildcardIndex].type == FSQRouteUrlTokenTypeUnlimitedComponentWildcard) {
-                        NSAssert(0, @"Tried to add a route where a parameter component was surrounded by "
-                                 @"unlimited wildcard components. path = %@", urlString);
-                        continue;
-                    }
-                }
-                
-                /**
-                 If we made it through the above check without continue'ing, then we are fine.
-                 */
-                token = [FSQRouteUrlToken unlimitedComponentWildCard];
-            }
-            else {
-                token = [FSQRouteUrlToken unlimitedComponentWildCard];
-            }
-        }
-        else if ([string hasPrefix:@":"]
-                 && string.length > 1) {
-            token = [FSQRouteUrlToken withParameterName:[string substringFromIndex:1]];
-        }
-        else if (string.length > 0) {
-            token = [FSQRouteUrlToken withString:string];
+    [self.registrationLock lock];
+    
+    FSQRouteTable *currentTable = self.routeTable;
+    NSMutableDictionary<NSString *, FSQCompiledRouteMap *> *routeMaps = [(isNativeSchemes 
+                                                                          ? currentTable.nativeSchemeRouteMaps 
+                                                                          : currentTable.httpHostRouteMaps) mutableCopy];
+    NSMapTable<FSQCompiledRouteMap *, id> *updatedMaps = [NSMapTable strongToStrongObjectsMapTable];
+    
+    for (NSString *registeredKey in keys) {
+        /**
+         Hosts are case insensitive, so they are stored lowercased and urls' hosts are lowercased to look them up.
+         */
+        NSString *key = isNativeSchemes ? registeredKey : registeredKey.lowercaseString;
+        FSQCompiledRouteMap *routeMap = routeMaps[key] ?: emptyMap;
+        id updatedMap = [updatedMaps objectForKey:routeMap];
+        
+        if (updatedMap == nil) {
+            updatedMap = update(routeMap) ?: [NSNull null];
+            [updatedMaps setObject:updatedMap forKey:routeMap];
         }
         
-        if (token != nil) {
-            lastAddedToken = token;
-            [tokenizedURL addObject:token];                
+        if (updatedMap != [NSNull null]) {
+            routeMaps[key] = updatedMap;
+            didUpdate = YES;
         }
     }
     
-    return [tokenizedURL copy];
+    if (didUpdate) {
+        FSQHostPatternTrieNode *hostPatternTrie = (isNativeSchemes
+                                                   ? currentTable.hostPatternTrie
+                                                   : [FSQHostPatternTrieNode trieWithHttpHostRouteMaps:routeMaps]);
+        
+        self.routeTable = [[FSQRouteTable alloc] initWithNativeSchemeRouteMaps:(isNativeSchemes ? routeMaps : currentTable.nativeSchemeRouteMaps)
+                                                             httpHostRouteMaps:(isNativeSchemes ? currentTable.httpHostRouteMaps : routeMaps)
+                                                               hostPatternTrie:hostPatternTrie
+                                                                    generation:currentTable.generation + 1];
+    }
+    
+    [self.registrationLock unlock];
+    
+    return didUpdate;
+}
+
+#pragma mark - Updating individual routes -
+
+- (nullable NSArray<FSQRouteUrlToken *> *)tokensForUpdatedRoute:(NSString *)routeString {
+    NSAssert(routeString.length > 0, @"Empty url string passed to a route update");
+    if (routeString.length == 0) {
+        return nil;
+    }
+    return FSQTokenizedRouteString(routeString);
+}
+
+/**
+ Updated routes are tokenized without options up front, and only tokenized again for maps which fold their static
+ components.
+ */
+- (NSArray<FSQRouteUrlToken *> *)tokensForRoute:(NSString *)routeString
+                                     withTokens:(NSArray<FSQRouteUrlToken *> *)tokens
+                                     inRouteMap:(FSQCompiledRouteMap *)routeMap {
+    if (routeMap.options == FSQRouteMatchingOptionsNone) {
+        return tokens;
+    }
+    return FSQTokenizedRouteStringWithOptions(routeString, routeMap.options);
+}
+
+- (void)addRoute:(NSString *)routeString
+       generator:(FSQRouteContentGenerator *)generator
+forNativeSchemes:(NSArray<NSString *> *)schemes {
+    [self addRoute:routeString generator:generator forKeys:schemes isNativeSchemes:YES];
+}
+
+- (void)addRoute:(NSString *)routeString
+       generator:(FSQRouteContentGenerator *)generator
+forUniversalLinkHosts:(NSArray<NSString *> *)hosts {
+    [self addRoute:routeString generator:generator forKeys:hosts isNativeSchemes:NO];
+}
+
+- (void)addRoute:(NSString *)routeString
+       generator:(FSQRouteContentGenerator *)generator
+         forKeys:(NSArray<NSString *> *)keys
+ isNativeSchemes:(BOOL)isNativeSchemes {
+    NSArray<FSQRouteUrlToken *> *tokens = [self tokensForUpdatedRoute:routeString];
+    
+    NSAssert(generator != nil, @"Nil contentGenerator passed to a route update. url string = %@", routeString);
+    if (tokens == nil
+        || generator == nil) {
+        return;
+    }
+    
+    [self updateRouteMapsForKeys:keys
+                 isNativeSchemes:isNativeSchemes
+                      usingBlock:^FSQCompiledRouteMap *(FSQCompiledRouteMap *routeMap) {
+                          return [routeMap routeMapByAddingRouteWithTokens:[self tokensForRoute:routeString withTokens:tokens inRouteMap:routeMap]
+                                                          contentGenerator:generator];
+                      }];
+}
+
+- (BOOL)removeRoute:(NSString *)routeString forNativeSchemes:(NSArray<NSString *> *)schemes {
+    return [self removeRoute:routeString forKeys:schemes isNativeSchemes:YES];
+}
+
+- (BOOL)removeRoute:(NSString *)routeString forUniversalLinkHosts:(NSArray<NSString *> *)hosts {
+    return [self removeRoute:routeString forKeys:hosts isNativeSchemes:NO];
+}
+
+- (BOOL)removeRoute:(NSString *)routeString forKeys:(NSArray<NSString *> *)keys isNativeSchemes:(BOOL)isNativeSchemes {
+    NSArray<FSQRouteUrlToken *> *tokens = [self tokensForUpdatedRoute:routeString];
+    if (tokens == nil) {
+        return NO;
+    }
+    
+    return [self updateRouteMapsForKeys:keys
+                        isNativeSchemes:isNativeSchemes
+                             usingBlock:^FSQCompiledRouteMap *_Nullable(FSQCompiledRouteMap *routeMap) {
+                                 return [routeMap routeMapByRemovingRoutesWithTokens:[self tokensForRoute:routeString withTokens:tokens inRouteMap:routeMap]];
+                             }];
+}
+
+- (BOOL)replaceGeneratorForRoute:(NSString *)routeString
+                   withGenerator:(FSQRouteContentGenerator *)generator
+                forNativeSchemes:(NSArray<NSString *> *)schemes {
+    return [self replaceGeneratorForRoute:routeString withGenerator:generator forKeys:schemes isNativeSchemes:YES];
+}
+
+- (BOOL)replaceGeneratorForRoute:(NSString *)routeString
+                   withGenerator:(FSQRouteContentGenerator *)generator
+           forUniversalLinkHosts:(NSArray<NSString *> *)hosts {
+    return [self replaceGeneratorForRoute:routeString withGenerator:generator forKeys:hosts isNativeSchemes:NO];
+}
+
+- (BOOL)replaceGeneratorForRoute:(NSString *)routeString
+                   withGenerator:(FSQRouteContentGenerator *)generator
+                         forKeys:(NSArray<NSString *> *)keys
+                 isNativeSchemes:(BOOL)isNativeSchemes {
+    NSArray<FSQRouteUrlToken *> *tokens = [self tokensForUpdatedRoute:routeString];
+    
+    NSAssert(generator != nil, @"Nil contentGenerator passed to a route update. url string = %@", routeString);
+    if (tokens == nil
+        || generator == nil) {
+        return NO;
+    }
     
+    return [self updateRouteMapsForKeys:keys
+                        isNativeSchemes:isNativeSchemes
+                             usingBlock:^FSQCompiledRouteMap *_Nullable(FSQCompiledRouteMap *routeMap) {
+                                 return [routeMap routeMapByReplacingContentGenerator:generator
+                                                                  forRoutesWithTokens:[self tokensForRoute:routeString withTokens:tokens inRouteMap:routeMap]];
+                             }];
 }
 
-- (NSArray<NSArray *> *)tokenizeRouteMap:(NSArray<NSArray *> *)map {
+- (NSArray<NSArray *> *)tokenizeRouteMap:(NSArray<NSArray *> *)map options:(FSQRouteMatchingOptions)options {
     
     NSMutableArray<NSArray *> *tokenizedRouteMap = [NSMutableArray new];
     
@@ -174,7 +686,7 @@ typedef NS_ENUM(NSInteger, FSQRouteUrlTokenType) {
             continue;
         }
         
-        [tokenizedRouteMap addObject:@[[self tokenizedRouteString:urlString], contentGenerator]];
+        [tokenizedRouteMap addObject:@[FSQTokenizedRouteStringWithOptions(urlString, options), contentGenerator]];
     }
          
     return [tokenizedRouteMap copy];
@@ -182,509 +694,370 @@ typedef NS_ENUM(NSInteger, FSQRouteUrlTokenType) {
 
 #pragma mark - Matching urls against registered routes -
 
-- (NSArray<NSArray *> *)routeMapForUrl:(NSURL *)url isNativeScheme:(nullable BOOL *)isNativeScheme {
-    NSArray<NSArray *> *routeMap = nil;
+- (BOOL)urlSchemeOrDomainIsRegistered:(NSURL *)url {
+    return !![self.routeTable routeMapForParsedUrl:[[FSQParsedRouteUrl alloc] initWithUrl:url]];
+}
+
+- (FSQRouteMatch *)routeMatchForParsedUrl:(FSQParsedRouteUrl *)parsedUrl 
+                             inRouteTable:(FSQRouteTable *)routeTable
+                                  metrics:(nullable FSQRoutingMetrics *)metrics {
+    [metrics beginStage:FSQRoutingStageRouteMapLookup];
+    FSQCompiledRouteMap *routeMap = [routeTable routeMapForParsedUrl:parsedUrl];
+    [metrics endStage:FSQRoutingStageRouteMapLookup];
     
-    if ([[url scheme] isEqualToString:@"https"]) {
-        routeMap = self.httpHostRouteMaps[url.host];
+    [metrics beginStage:FSQRoutingStagePathMatching];
+    FSQCompiledRoute *matchingRoute = nil;
+    NSDictionary<NSString *, NSString *> *pathParameters = nil;
+    NSUInteger numberOfRoutesTried = 0;
+    
+    if (routeMap.numberOfRoutes > 0) {
+        /**
+         Urls with an empty path are not cached since whether they match a route with no tokens depends on 
+         their query.
+         */
+        FSQRouteMatchCache *matchCache = (parsedUrl.pathComponents.count > 0) ? self.matchCache : nil;
+        FSQRouteMatchCacheKey *cacheKey = nil;
+        FSQRouteMatchCacheEntry *cacheEntry = nil;
         
-        if (isNativeScheme != NULL) {
-            *isNativeScheme = NO;
+        if (matchCache != nil) {
+            cacheKey = [[FSQRouteMatchCacheKey alloc] initWithParsedUrl:parsedUrl];
+            cacheEntry = [matchCache entryForKey:cacheKey generation:routeTable.generation];
         }
-    }
-    else {
-        routeMap = self.nativeSchemeRouteMaps[url.scheme];
         
-        if (isNativeScheme != NULL) {
-            *isNativeScheme = YES;
+        if (cacheEntry != nil) {
+            matchingRoute = cacheEntry.route;
+            pathParameters = cacheEntry.pathParameters;
+        }
+        else {
+            NSMutableDictionary<NSString *, NSString *> *routePathParameters = nil;
+            matchingRoute = [routeMap routeMatchingParsedUrl:parsedUrl
+                                              pathParameters:&routePathParameters
+                                         numberOfRoutesTried:&numberOfRoutesTried];
+            pathParameters = routePathParameters;
+            
+            if (matchCache != nil) {
+                [matchCache addEntry:[[FSQRouteMatchCacheEntry alloc] initWithKey:cacheKey 
+                                                                            route:matchingRoute 
+                                                                   pathParameters:pathParameters]
+                          generation:routeTable.generation];
+            }
         }
     }
     
-    return routeMap;
+    if (matchingRoute == nil) {
+        [metrics recordRouteIndex:NSNotFound numberOfRoutesTried:numberOfRoutesTried];
+        [metrics endStage:FSQRoutingStagePathMatching];
+        
+        return [[FSQRouteMatch alloc] initWithUrl:parsedUrl.url
+                                   isNativeScheme:parsedUrl.isNativeScheme
+                                 contentGenerator:nil
+                                          urlData:nil
+                                       routeIndex:NSNotFound
+                             routeTableGeneration:routeTable.generation];
+    }
+    
+    /**
+     Query items come from this url, they are never part of a cache entry. The url data only unescapes the ones its
+     content generator asks for, and path parameters (cached or not) are never modified, so they are shared as is.
+     */
+    FSQRouteUrlData *urlData = [[FSQRouteUrlData alloc] initWithUrl:parsedUrl.url
+                                                     pathParameters:pathParameters
+                                                         queryItems:parsedUrl.queryItems];
+    
+    [metrics recordRouteIndex:matchingRoute.routeIndex numberOfRoutesTried:numberOfRoutesTried];
+    [metrics endStage:FSQRoutingStagePathMatching];
+    
+    return [[FSQRouteMatch alloc] initWithUrl:parsedUrl.url
+                               isNativeScheme:parsedUrl.isNativeScheme
+                             contentGenerator:matchingRoute.contentGenerator
+                                      urlData:urlData
+                                   routeIndex:matchingRoute.routeIndex
+                         routeTableGeneration:routeTable.generation];
 }
 
-- (BOOL)urlSchemeOrDomainIsRegistered:(NSURL *)url {
-    return !![self routeMapForUrl:url isNativeScheme:NULL];
+- (void)matchRouteForUrl:(NSURL *)url completionBlock:(void (^)(BOOL matched, 
+                                                                BOOL isNativeScheme,
+                                                                FSQRouteContentGenerator *_Nullable contentGenerator, 
+                                                                FSQRouteUrlData *_Nullable urlData))completionBlock {
+    [self matchRouteForUrl:url metrics:nil completionBlock:completionBlock];
 }
 
-- (NSString *)unescapedStringFromString:(NSString *)string {
-    NSMutableString *mutableString = [string mutableCopy];
-    [mutableString replaceOccurrencesOfString:@"+" 
-                                   withString:@" " 
-                                      options:NSLiteralSearch 
-                                        range:NSMakeRange(0, mutableString.length)];
-    
-    return [mutableString stringByRemovingPercentEncoding];
+- (void)matchRouteForUrl:(NSURL *)url 
+                 metrics:(nullable FSQRoutingMetrics *)metrics
+         completionBlock:(void (^)(BOOL matched, 
+                                   BOOL isNativeScheme,
+                                   FSQRouteContentGenerator *_Nullable contentGenerator, 
+                                   FSQRouteUrlData *_Nullable urlData))completionBlock {
+    if (url != nil) {
+        [metrics beginStage:FSQRoutingStageUrlParsing];
+        FSQParsedRouteUrl *parsedUrl = [[FSQParsedRouteUrl alloc] initWithUrl:url];
+        [metrics endStage:FSQRoutingStageUrlParsing];
+        
+        FSQRouteMatch *match = [self routeMatchForParsedUrl:parsedUrl inRouteTable:self.routeTable metrics:metrics];
+        
+        completionBlock(match.matched, match.isNativeScheme, match.contentGenerator, match.urlData);
+    }
+    else {
+        completionBlock(NO, NO, nil, nil);
+    }
 }
 
-- (nullable NSDictionary<NSString *, NSString *> *)parametersForUrl:(NSURL *)url
-                                                     ifMatchingPath:(NSArray<FSQRouteUrlToken *> *)tokens {
-
-    NSURLComponents *urlComponents = [[NSURLComponents alloc] initWithURL:url resolvingAgainstBaseURL:YES];;
-    NSArray *urlPathComponents = [urlComponents.path pathComponents];
-
-    if (![urlComponents.scheme isEqualToString:@"https"]
-        && urlComponents.host.length > 0) {
-        urlPathComponents = [@[urlComponents.host] arrayByAddingObjectsFromArray:urlPathComponents];
-    }
-    
-    urlPathComponents = [self normalizePathComponents:urlPathComponents];
+- (NSArray<FSQRouteMatch *> *)allMatchesForUrl:(NSURL *)url {
+    FSQParsedRouteUrl *parsedUrl = [[FSQParsedRouteUrl alloc] initWithUrl:url];
+    FSQRouteTable *routeTable = self.routeTable;
+    FSQCompiledRouteMap *routeMap = [routeTable routeMapForParsedUrl:parsedUrl];
     
-    NSDictionary<NSString *, NSString *> *matchResult;
-    matchResult = [self parametersForUrlPathComponents:urlPathComponents 
-                                                tokens:tokens 
-                                     startingPathIndex:0 
-                                    startingTokenIndex:0 
-                                       targetPathIndex:urlPathComponents.count - 1
-                                      targetTokenIndex:tokens.count - 1];
+    NSArray<NSMutableDictionary<NSString *, NSString *> *> *pathParameters = nil;
+    NSArray<FSQCompiledRoute *> *routes = [routeMap routesMatchingParsedUrl:parsedUrl pathParameters:&pathParameters];
+    NSMutableArray<FSQRouteMatch *> *matches = [NSMutableArray arrayWithCapacity:routes.count];
     
-    if (matchResult == nil) {
-        return nil;
-    }
-    else {
-        NSMutableDictionary<NSString *, NSString *> *mutableParameters = matchResult.mutableCopy;
-        
-        for (NSURLQueryItem *item in urlComponents.queryItems) {
-            mutableParameters[[self unescapedStringFromString:item.name]] = [self unescapedStringFromString:item.value];
-        }
+    for (NSUInteger matchIndex = 0; matchIndex < routes.count; matchIndex++) {
+        FSQCompiledRoute *route = routes[matchIndex];
+        FSQRouteUrlData *urlData = [[FSQRouteUrlData alloc] initWithUrl:url
+                                                         pathParameters:pathParameters[matchIndex]
+                                                             queryItems:parsedUrl.queryItems];
         
-        return mutableParameters.copy;
+        [matches addObject:[[FSQRouteMatch alloc] initWithUrl:url
+                                               isNativeScheme:parsedUrl.isNativeScheme
+                                             contentGenerator:route.contentGenerator
+                                                      urlData:urlData
+                                                   routeIndex:route.routeIndex
+                                         routeTableGeneration:routeTable.generation]];
     }
+    
+    return matches.copy;
 }
 
+#pragma mark - Trace replay -
 
-- (nullable NSDictionary<NSString *, NSString *> *)parametersForUrlPathComponents:(NSArray *)urlPathComponents
-                                                                           tokens:(NSArray<FSQRouteUrlToken *> *)tokens
-                                                                startingPathIndex:(NSInteger)urlPathComponentIndex
-                                                               startingTokenIndex:(NSInteger)tokenIndex
-                                                                  targetPathIndex:(NSInteger)targetUrlPathComponentIndex
-                                                                 targetTokenIndex:(NSInteger)targetTokenIndex {
- 
-    NSInteger numberOfUrlPathComponents = urlPathComponents.count;
-    NSInteger numberOfTokens = tokens.count;
-    
-    NSMutableDictionary<NSString *, NSString *> *parameterDictionary = [NSMutableDictionary new];
+- (NSArray<FSQRoutingMetrics *> *)replayTraceRecords:(NSArray<FSQRouteTraceRecord *> *)records {
+    NSMutableArray<FSQRoutingMetrics *> *replayedMetrics = [NSMutableArray arrayWithCapacity:records.count];
     
-    if (numberOfUrlPathComponents == 0
-        || numberOfTokens == 0) {
-        if (numberOfUrlPathComponents == 0
-             && (numberOfTokens == 0
-                 || (numberOfTokens == 1 && tokens[0].type == FSQRouteUrlTokenTypeUnlimitedComponentWildcard))
-            ) {
-            return parameterDictionary.copy;
-        }
-        else {
-            return nil;
+    for (FSQRouteTraceRecord *record in records) {
+        @autoreleasepool {
+            FSQRoutingMetrics *metrics = [[FSQRoutingMetrics alloc] initWithUrl:record.url
+                                                           notificationUserInfo:record.notificationUserInfo
+                                                                       observer:nil
+                                                                  traceRecorder:nil
+                                                            resumedFromDeferral:record.resumedFromDeferral];
+            NSURL *url = record.url;
+            BOOL matched = NO;
+            if (url != nil) {
+                [metrics beginStage:FSQRoutingStageUrlParsing];
+                FSQParsedRouteUrl *parsedUrl = [[FSQParsedRouteUrl alloc] initWithUrl:url];
+                [metrics endStage:FSQRoutingStageUrlParsing];
+                
+                matched = [self routeMatchForParsedUrl:parsedUrl inRouteTable:self.routeTable metrics:metrics].matched;
+            }
+            
+            if (!matched) {
+                [metrics finishWithOutcome:FSQRoutingOutcomeFailedToMatch];
+            }
+            [replayedMetrics addObject:metrics];
         }
     }
     
-    NSInteger(^advancePathIndex)(NSInteger) = nil;
-    NSInteger(^advanceTokenIndex)(NSInteger) = nil;
-    NSInteger(^reversePathIndex)(NSInteger) = nil;
-    NSInteger(^reverseTokenIndex)(NSInteger) = nil;
-    
-    NSInteger(^forwardAdvancer)(NSInteger) = ^(NSInteger index) {
-        return index + 1;
-    };
+    return replayedMetrics.copy;
+}
 
-    NSInteger(^backwardAdvancer)(NSInteger) = ^(NSInteger index) {
-        return index - 1;
-    };
-    
-    NSInteger pathIndexUpperBound;
-    NSInteger pathIndexLowerBound;
-    NSInteger tokenIndexUpperBound;
-    NSInteger tokenIndexLowerBound;
+#pragma mark - Match cache -
+
+- (void)setMatchCacheCapacity:(NSUInteger)matchCacheCapacity {
+    FSQRouteMatchCache *matchCache = self.matchCache;
     
-    if (targetUrlPathComponentIndex >= urlPathComponentIndex) {
-        pathIndexUpperBound = targetUrlPathComponentIndex;
-        pathIndexLowerBound = 0;
-        advancePathIndex = forwardAdvancer;
-        reversePathIndex = backwardAdvancer;
+    if (matchCacheCapacity == 0) {
+        self.matchCache = nil;
+    }
+    else if (matchCache != nil) {
+        matchCache.capacity = matchCacheCapacity;
     }
     else {
-        pathIndexUpperBound = numberOfUrlPathComponents;
-        pathIndexLowerBound = targetUrlPathComponentIndex;
-        advancePathIndex = backwardAdvancer;
-        reversePathIndex = forwardAdvancer;
+        self.matchCache = [[FSQRouteMatchCache alloc] initWithCapacity:matchCacheCapacity];
     }
+}
+
+- (NSUInteger)matchCacheCapacity {
+    return self.matchCache.capacity;
+}
+
+- (NSUInteger)matchCacheHitCount {
+    return self.matchCache.hitCount;
+}
+
+- (NSUInteger)matchCacheMissCount {
+    return self.matchCache.missCount;
+}
+
+#pragma mark - Reverse routing -
+
+- (nullable FSQRouteUrlTemplate *)urlTemplateForRoute:(NSString *)routeString nativeScheme:(NSString *)scheme {
+    return [self urlTemplateForRoute:routeString key:scheme isNativeScheme:YES];
+}
+
+- (nullable FSQRouteUrlTemplate *)urlTemplateForRoute:(NSString *)routeString universalLinkHost:(NSString *)host {
+    return [self urlTemplateForRoute:routeString key:host isNativeScheme:NO];
+}
+
+- (nullable FSQRouteUrlTemplate *)urlTemplateForRoute:(NSString *)routeString
+                                                  key:(NSString *)key
+                                       isNativeScheme:(BOOL)isNativeScheme {
+    NSArray<FSQRouteUrlToken *> *tokens = FSQTokenizedRouteString(routeString);
     
-    if (targetTokenIndex >= tokenIndex) {
-        tokenIndexUpperBound = targetTokenIndex;
-        tokenIndexLowerBound = 0;
-        advanceTokenIndex = forwardAdvancer;
-        reverseTokenIndex = backwardAdvancer;
-    }
-    else {
-        tokenIndexUpperBound = numberOfTokens;
-        tokenIndexLowerBound = targetTokenIndex;
-        advanceTokenIndex = backwardAdvancer;
-        reverseTokenIndex = forwardAdvancer;
+    FSQRouteTable *routeTable = self.routeTable;
+    FSQCompiledRouteMap *routeMap = (isNativeScheme
+                                     ? routeTable.nativeSchemeRouteMaps[key]
+                                     : [routeTable routeMapForUniversalLinkHost:key]);
+    
+    if (![routeMap containsRouteWithTokens:[self tokensForRoute:routeString withTokens:tokens inRouteMap:routeMap]]) {
+        return nil;
     }
     
-    BOOL successfulMatchShortCircuit = NO;
+    NSMutableArray<NSString *> *pathComponents = [NSMutableArray arrayWithCapacity:tokens.count];
+    NSMutableIndexSet *parameterIndexes = [NSMutableIndexSet new];
     
-    while (!successfulMatchShortCircuit
-           && urlPathComponentIndex <= pathIndexUpperBound
-           && urlPathComponentIndex >= pathIndexLowerBound
-           && tokenIndex <= tokenIndexUpperBound
-           && tokenIndex >= tokenIndexLowerBound) {
-
-        NSString *pathComponent = urlPathComponents[urlPathComponentIndex];
-        FSQRouteUrlToken *token = tokens[tokenIndex];
-        
+    for (FSQRouteUrlToken *token in tokens) {
         switch (token.type) {
-            case FSQRouteUrlTokenTypeString: {
-                if ([token.stringOrParameterName isEqualToString:pathComponent]) {
-                    /**
-                     Token string matches the path component. Proceed to the next of each.
-                     */
-                    tokenIndex = advanceTokenIndex(tokenIndex);
-                    urlPathComponentIndex = advancePathIndex(urlPathComponentIndex);
-                }
-                else {
-                    /**
-                     The string of the token should match the current path component, but does not.
-                     This url is not a match
-                     */
-                    return nil;
-                }
-            }
-                break;
-                
-            case FSQRouteUrlTokenTypeParameter: {
-                /**
-                 Set this components string value for the given parameter in the result dictionary
-                 and then proceed to the next component and token
-                 */
-                parameterDictionary[token.stringOrParameterName] = pathComponent;
-                tokenIndex = advanceTokenIndex(tokenIndex);
-                urlPathComponentIndex = advancePathIndex(urlPathComponentIndex);
-            }
+            case FSQRouteUrlTokenTypeParameter:
+            case FSQRouteUrlTokenTypeIntegerParameter:
+                [parameterIndexes addIndex:pathComponents.count];
+                [pathComponents addObject:token.stringOrParameterName];
                 break;
-                
-            case FSQRouteUrlTokenTypeSingleComponentWildcard: {
-                /**
-                 This component can be anything and we just ignore it.
-                 */
-                tokenIndex = advanceTokenIndex(tokenIndex);
-                urlPathComponentIndex = advancePathIndex(urlPathComponentIndex);
-            }
+            case FSQRouteUrlTokenTypeString:
+                [pathComponents addObject:token.stringOrParameterName];
                 break;
-                
-            case FSQRouteUrlTokenTypeUnlimitedComponentWildcard: {
+            case FSQRouteUrlTokenTypeSingleComponentWildcard:
+            case FSQRouteUrlTokenTypeUnlimitedComponentWildcard:
                 /**
-                 If we are the last token, then at this point we can just say
-                 that the url matches
+                 Wildcards don't say what should go in their place.
                  */
-                if (tokenIndex == targetTokenIndex) {
-                    successfulMatchShortCircuit = YES;
-                    continue;
-                }
-                
-                /**
-                 Ok now we are at the complicated part.
-                 */
-                
-                NSInteger nextTokenIndex = advanceTokenIndex(tokenIndex);
-                FSQRouteUrlToken *nextToken = tokens[nextTokenIndex];
-                
-                switch (nextToken.type) {
-                        
-                        /**
-                         1. The next token is a static string.
-                         
-                         Find every current or future path component that matches that string and start parsing from there.
-                         Use the first least greedy result that matches in case of any ambiguity.
-                         If the string doesn't appear in our path any more, we didn't match.
-                         
-                         Examples:
-                         
-                         "/ ** / b" should match all of the following 
-                         "urlscheme://a/b" 
-                         "urlscheme://a/b/b".
-                         
-                         "/ ** / b / :param / ** /" will match several ways to the url 
-                         "urlscheme://b/a/b/c"
-                         and param could end up as either "a" or "c" but we should write it so that is is 
-                         left-weighted (each wildcard as we go along prefers to be as small as possible) and so
-                         param will end up as "a" 
-                         */
-                        
-                    case FSQRouteUrlTokenTypeString:
-                    {
-                        NSDictionary *parameterResult = nil;
-                        
-                        for (; 
-                             urlPathComponentIndex <= pathIndexUpperBound 
-                             && urlPathComponentIndex >= pathIndexLowerBound
-                             && parameterResult == nil; 
-                             urlPathComponentIndex = advancePathIndex(urlPathComponentIndex)) {
-                            if ([urlPathComponents[urlPathComponentIndex] isEqualToString:nextToken.stringOrParameterName]) {
-                                parameterResult = [self parametersForUrlPathComponents:urlPathComponents 
-                                                                                tokens:tokens 
-                                                                     startingPathIndex:urlPathComponentIndex 
-                                                                    startingTokenIndex:nextTokenIndex 
-                                                                       targetPathIndex:targetUrlPathComponentIndex 
-                                                                      targetTokenIndex:targetTokenIndex];
-                            }
-                        }
-                        
-                        if (parameterResult != nil) {
-                            /**
-                             We successfully matched. Add the other parameters to our own and return
-                             */
-                            [parameterDictionary addEntriesFromDictionary:parameterResult];
-                            successfulMatchShortCircuit = YES;
-                        }
-                        else {
-                            /**
-                             This url is not a match for these tokens.
-                             */
-                            return nil;
-                        }
-                    }
-                        break;
-                        
-                        /**
-                         2. The next token is a parameter string
-                         
-                         If there are any more static strings in the rest of tokens, we have to go to the next one,
-                         or to the end of the whole set of tokens, then match back from there to see if it matches
-                         to us, and if it does we need to also match forwards from there to see if the rest of the 
-                         url matches.
-                         Examples:
-                         
-                         "/ ** / :param / a / **" should match all of the following
-                         "urlscheme://b/a" (param = b)
-                         "urlscheme://b/a/c/a" (param = b, left-weighted)
-                         
-                         "/ ** / :param / a / b / **" should match all of the following
-                         "urlscheme://c/a/a/b" (param = a)
-                         "urlscheme://d/c/a/b/a/b" (param = c, left-weighted)
-                         "urlscheme:///c/a/d/a/b" (param = d)
-                         
-                         If there are no more static strings, we have to go to the end of the url and token list
-                         then match backwards from there to here
-                         
-                         Examples:
-                         
-                         "/ ** / :param /" should match
-                         "urlscheme://a/b/c/d" (param = d)
-                         "urlscheme://a" (param = a)
-                         
-                         */
-                        
-                    case FSQRouteUrlTokenTypeParameter:
-                        // intentionally fall through here
-                        
-                        /**
-                         3. The next token is a single match wildcard
-                         
-                         Since the ** symbol can be any number 0+, it might might sense to put it next to
-                         some single wildcards to ensure that a certain number of components exist
-                         e.g. "/ * / ** /" is any path with at least one component
-                         
-                         This case is identical to case 2. except we don't store the parameter value
-                         */
-                        
-                    case FSQRouteUrlTokenTypeSingleComponentWildcard:
-                    {
-                        // Find next static string token
-                        NSInteger nextStaticStringTokenIndex = advanceTokenIndex(nextTokenIndex);
-                        NSString *foundString = nil;
-                        for (; 
-                             nextStaticStringTokenIndex <= tokenIndexUpperBound
-                             && nextStaticStringTokenIndex >= tokenIndexLowerBound; 
-                             nextStaticStringTokenIndex = advanceTokenIndex(nextStaticStringTokenIndex)) {
-                            FSQRouteUrlToken *nextToken = tokens[nextStaticStringTokenIndex];
-                            if (nextToken.type == FSQRouteUrlTokenTypeString) {
-                                // success
-                                foundString = nextToken.stringOrParameterName;
-                                break;
-                            }
-                        }
-                        /**
-                         At this point we are either at our next static string, or past the bounds
-                         of our token search range.
-                         
-                         Step 1. If we're a static string, search from every future instance of that static
-                         string back to us.
-                         */
-                        if (foundString) {
-                            
-                            NSInteger testedUrlPathComponentIndex = advancePathIndex(urlPathComponentIndex);
-                            
-                            for (; 
-                                 testedUrlPathComponentIndex <= pathIndexUpperBound 
-                                 && testedUrlPathComponentIndex >= pathIndexLowerBound
-                                 && successfulMatchShortCircuit == NO; 
-                                 testedUrlPathComponentIndex = advancePathIndex(testedUrlPathComponentIndex)) {
-                                if ([urlPathComponents[testedUrlPathComponentIndex] isEqualToString:foundString]) {
-                                    NSDictionary *backToUsResult = nil;
-                                    backToUsResult = [self parametersForUrlPathComponents:urlPathComponents 
-                                                                                   tokens:tokens 
-                                                                        startingPathIndex:testedUrlPathComponentIndex 
-                                                                       startingTokenIndex:nextStaticStringTokenIndex 
-                                                                          targetPathIndex:urlPathComponentIndex 
-                                                                         targetTokenIndex:tokenIndex];
-                                    
-                                    if (backToUsResult != nil) {
-                                        /**
-                                         We matched from there to here successfully. Now try matching
-                                         forward from the static string to the rest of the string.
-                                         */
-                                        NSDictionary *forwardResult = [self parametersForUrlPathComponents:urlPathComponents 
-                                                                                                    tokens:tokens 
-                                                                                         startingPathIndex:testedUrlPathComponentIndex 
-                                                                                        startingTokenIndex:nextStaticStringTokenIndex 
-                                                                                           targetPathIndex:targetUrlPathComponentIndex 
-                                                                                          targetTokenIndex:targetTokenIndex];
-                                        if (forwardResult) {
-                                            /**
-                                             We successfully matched. Add the other parameters to our own and return
-                                             */
-                                            [parameterDictionary addEntriesFromDictionary:backToUsResult];
-                                            [parameterDictionary addEntriesFromDictionary:forwardResult];
-                                            successfulMatchShortCircuit = YES;
-                                        }
-                                    }
-                                }
-                            } // end static string searching for loop
-
-                            if (!successfulMatchShortCircuit) {
-                                /**
-                                 If we got to here, that means the next static string doesn't appear in the rest
-                                 of our path at all or all the cases that do don't match to us, so we are not a match.
-                                 */
-                                return nil;
-                            }
-                        }  // end foundString if statement
-                        else {
-                            /**
-                             There are no more static strings in the rest of the tokens array so just try
-                             matching from the bounds. nextStaticStringTokenIndex should be just pass the correct bounds
-                             now if we are in this else statement so backtrack once.
-                             */
-                            NSDictionary *backToUsResult = [self parametersForUrlPathComponents:urlPathComponents 
-                                                                                         tokens:tokens 
-                                                                              startingPathIndex:targetUrlPathComponentIndex 
-                                                                             startingTokenIndex:reverseTokenIndex(nextStaticStringTokenIndex)
-                                                                                targetPathIndex:urlPathComponentIndex
-                                                                               targetTokenIndex:tokenIndex];
-                            if (backToUsResult) {
-                                [parameterDictionary addEntriesFromDictionary:backToUsResult];
-                                successfulMatchShortCircuit = YES;
-                            }
-                            
-                        }
-                    }
-                        break;
-                        
-                        /**
-                         4. This next token is an unlimited wildcard
-                         
-                         This shouldn't happen because we reduce them when tokenizing, but if for some
-                         reason it does just skip ahead to it.
-                         */
-                        
-                    case FSQRouteUrlTokenTypeUnlimitedComponentWildcard:
-                    {
-                        tokenIndex = advanceTokenIndex(tokenIndex);
-                        NSAssert(0, @"There should not be two unlimited wildcard tokens in a row");
-                    }
-                        break;
-                        
-                }
-                
-            }
-                break;
+                return nil;
         }
     }
     
+    NSString *urlPrefix = (isNativeScheme
+                           ? [NSString stringWithFormat:@"%@://", key]
+                           : [NSString stringWithFormat:@"https://%@/", key]);
+    
+    return [[FSQRouteUrlTemplate alloc] initWithRouteString:routeString
+                                                  urlPrefix:urlPrefix
+                                             pathComponents:pathComponents
+                                           parameterIndexes:parameterIndexes];
+}
+
+#pragma mark - Route analysis -
+
+- (nullable NSArray<FSQRouteAnalysis *> *)routeAnalysesForNativeScheme:(NSString *)scheme {
+    return [self.routeTable.nativeSchemeRouteMaps[scheme] routeAnalyses];
+}
+
+- (nullable NSArray<FSQRouteAnalysis *> *)routeAnalysesForUniversalLinkHost:(NSString *)host {
+    return [[self.routeTable routeMapForUniversalLinkHost:host] routeAnalyses];
+}
+
+#pragma mark - Batch matching -
+
+/**
+ Number of urls each block handed to dispatch_apply matches, so that small batches are not dominated by
+ dispatch overhead.
+ */
+static const size_t kFSQBatchMatchStride = 32;
+
+- (NSArray<FSQRouteMatch *> *)matchUrls:(NSArray<NSURL *> *)urls {
+    return [self matchUrls:urls concurrently:NO];
+}
+
+- (NSArray<FSQRouteMatch *> *)matchUrls:(NSArray<NSURL *> *)urls concurrently:(BOOL)concurrently {
+    NSUInteger numberOfUrls = urls.count;
+    
+    if (numberOfUrls == 0) {
+        return @[];
+    }
+    
     /**
-     The while loop has ended. 
-     
-     If both indexes reached their target values, then we matched successfully.
-     If there are more tokens or path components to go then we did not match.
+     Read the route table once so every url in the batch is matched against the same set of maps.
      */
+    FSQRouteTable *routeTable = self.routeTable;
     
-    BOOL successfulMatch = NO;
-    NSInteger finalParsedPathComponentIndex = reversePathIndex(urlPathComponentIndex);
-    NSInteger finalParsedTokenIndex = reversePathIndex(tokenIndex);
-    if (finalParsedPathComponentIndex == targetUrlPathComponentIndex
-        && finalParsedTokenIndex == targetTokenIndex) {
-        /**
-         Both indexes made it to their target
-         */
-        successfulMatch = YES;
-    }
-    else if (finalParsedPathComponentIndex == targetUrlPathComponentIndex
-             && tokenIndex == targetTokenIndex
-             && tokens[tokenIndex].type == FSQRouteUrlTokenTypeUnlimitedComponentWildcard) {
-        /**
-         The path finished parsing, and there is one remaining token and it is an unlimited wildcard
-         (which is allowed to match zero components, so this matches)
-         */
-        successfulMatch = YES;
-    }
+    /**
+     Replayed link logs repeat the same urls a lot, so only match each distinct url once.
+     */
+    NSMutableArray<NSURL *> *distinctUrls = [NSMutableArray new];
+    NSMutableDictionary<NSURL *, NSNumber *> *distinctIndexForUrl = [NSMutableDictionary new];
+    NSUInteger *distinctIndexes = malloc(numberOfUrls * sizeof(NSUInteger));
     
-    if (successfulMatchShortCircuit || successfulMatch) {
-            return parameterDictionary;
+    for (NSUInteger urlIndex = 0; urlIndex < numberOfUrls; urlIndex++) {
+        NSURL *url = urls[urlIndex];
+        NSNumber *distinctIndex = distinctIndexForUrl[url];
+        if (distinctIndex == nil) {
+            distinctIndex = @(distinctUrls.count);
+            distinctIndexForUrl[url] = distinctIndex;
+            [distinctUrls addObject:url];
         }
-    else {
-        return nil;
+        distinctIndexes[urlIndex] = distinctIndex.unsignedIntegerValue;
     }
-}
-
-
-- (void)matchRouteForUrl:(NSURL *)url completionBlock:(void (^)(BOOL matched, 
-                                                                BOOL isNativeScheme,
-                                                                FSQRouteContentGenerator *_Nullable contentGenerator, 
-                                                                FSQRouteUrlData *_Nullable urlData))completionBlock {
-    if (url != nil) {
-        BOOL isNativeScheme = NO;
-        NSArray<NSArray *> *routeMap = [self routeMapForUrl:url isNativeScheme:&isNativeScheme];
-        
-        FSQRouteUrlData *urlData = [FSQRouteUrlData new];
-        urlData.url = url;
-        
-        if (routeMap.count > 0) {
-            __block BOOL foundMatch = NO;
-            
-            [routeMap enumerateObjectsUsingBlock:^(NSArray *pair, NSUInteger idx, BOOL *stop) {
-                NSArray<FSQRouteUrlToken *> *tokenizedPath = [pair firstObject];
-                FSQRouteContentGenerator *contentGenerator = [pair lastObject];
-                
-                NSDictionary<NSString *, NSString *> *parameters = [self parametersForUrl:url
-                                                                           ifMatchingPath:tokenizedPath];
-                
-                if (parameters.count == 0 && // Important: a route can have parameters but no path, i.e. scheme://?foo=bar
-                    (tokenizedPath.count == 0 || contentGenerator == nil)) {
-                    return;
-                }
-                
-                if (parameters != nil) {
-                    *stop = YES;
-                    urlData.parameters = parameters;
-
-                    foundMatch = YES;
-                    completionBlock(YES, isNativeScheme, contentGenerator, urlData);
+    
+    NSUInteger numberOfDistinctUrls = distinctUrls.count;
+    __strong FSQRouteMatch **distinctMatches = (__strong FSQRouteMatch **)calloc(numberOfDistinctUrls, sizeof(FSQRouteMatch *));
+    
+    void (^matchDistinctUrl)(size_t) = ^(size_t distinctIndex) {
+        FSQParsedRouteUrl *parsedUrl = [[FSQParsedRouteUrl alloc] initWithUrl:distinctUrls[distinctIndex]];
+        distinctMatches[distinctIndex] = [self routeMatchForParsedUrl:parsedUrl inRouteTable:routeTable metrics:nil];
+    };
+    
+    if (concurrently 
+        && numberOfDistinctUrls > kFSQBatchMatchStride) {
+        size_t numberOfStrides = (numberOfDistinctUrls + kFSQBatchMatchStride - 1) / kFSQBatchMatchStride;
+        dispatch_apply(numberOfStrides, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t stride) {
+            size_t endIndex = MIN((stride + 1) * kFSQBatchMatchStride, numberOfDistinctUrls);
+            for (size_t distinctIndex = stride * kFSQBatchMatchStride; distinctIndex < endIndex; distinctIndex++) {
+                @autoreleasepool {
+                    matchDistinctUrl(distinctIndex);
                 }
-            }];
-            
-            if (!foundMatch) {
-                // Need to ensure completion block is called
-                completionBlock(NO, isNativeScheme, nil, urlData);
             }
+        });
+    }
+    else {
+        for (size_t distinctIndex = 0; distinctIndex < numberOfDistinctUrls; distinctIndex++) {
+            matchDistinctUrl(distinctIndex);
         }
-        else {
-            completionBlock(NO, isNativeScheme, nil, urlData);
+    }
+    
+    NSMutableArray<FSQRouteMatch *> *matches = [NSMutableArray arrayWithCapacity:numberOfUrls];
+    BOOL *distinctMatchWasReturned = calloc(numberOfDistinctUrls, sizeof(BOOL));
+    
+    for (NSUInteger urlIndex = 0; urlIndex < numberOfUrls; urlIndex++) {
+        NSUInteger distinctIndex = distinctIndexes[urlIndex];
+        FSQRouteMatch *match = distinctMatches[distinctIndex];
+        
+        if (distinctMatchWasReturned[distinctIndex]) {
+            /**
+             Repeated urls share the match work, but each gets its own url data object since callers may modify it.
+             */
+            FSQRouteUrlData *urlData = nil;
+            if (match.urlData != nil) {
+                urlData = [[FSQRouteUrlData alloc] initWithUrl:urls[urlIndex] parametersOfUrlData:match.urlData];
+            }
+            
+            match = [[FSQRouteMatch alloc] initWithUrl:urls[urlIndex]
+                                        isNativeScheme:match.isNativeScheme
+                                      contentGenerator:match.contentGenerator
+                                               urlData:urlData
+                                            routeIndex:match.routeIndex
+                                  routeTableGeneration:match.routeTableGeneration];
         }
+        
+        distinctMatchWasReturned[distinctIndex] = YES;
+        [matches addObject:match];
     }
-    else {
-        completionBlock(NO, NO, nil, nil);
+    
+    for (NSUInteger distinctIndex = 0; distinctIndex < numberOfDistinctUrls; distinctIndex++) {
+        distinctMatches[distinctIndex] = nil;
     }
+    free(distinctMatches);
+    free(distinctMatchWasReturned);
+    free(distinctIndexes);
+    
+    return matches.copy;
 }
 
 #pragma mark - URL routing methods -
@@ -694,9 +1067,39 @@ typedef NS_ENUM(NSInteger, FSQRouteUrlTokenType) {
 }
 
 - (void)routeUrl:(NSURL *)url notificationUserInfo:(nullable NSDictionary *)notificationUserInfo {
-    [self clearDeferredRoute];
+    [self enqueueRouteForUrl:url notificationUserInfo:notificationUserInfo routingPass:^(FSQUrlRouter *router, FSQRouteCancellationToken *cancellationToken) {
+        [router startRoutingPassForUrl:url notificationUserInfo:notificationUserInfo cancellationToken:cancellationToken];
+    }];
+}
+
+- (void)startRoutingPassForUrl:(NSURL *)url
+          notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
+             cancellationToken:(FSQRouteCancellationToken *)cancellationToken {
+    FSQRoutingMetrics *metrics = [self routingMetricsForUrl:url
+                                       notificationUserInfo:notificationUserInfo
+                                        resumedFromDeferral:NO];
+    
+    FSQPrewarmedRouteContent *prewarmedContent = (url != nil)
+                                                 ? [self.prewarmedContentCache takeContentForUrl:url
+                                                                            notificationUserInfo:notificationUserInfo
+                                                                                      generation:self.routeTable.generation]
+                                                 : nil;
+    if (prewarmedContent != nil) {
+        FSQRouteContent *routeContent = prewarmedContent.routeContent;
+        
+        [metrics recordRouteIndex:prewarmedContent.match.routeIndex numberOfRoutesTried:0];
+        [metrics recordUsedPrewarmedContent];
+        
+        [self routeOrDeferContentGenerator:prewarmedContent.match.contentGenerator
+                                   urlData:routeContent.urlData
+                          prewarmedContent:routeContent
+                                   metrics:metrics
+                         cancellationToken:cancellationToken];
+        return;
+    }
     
     [self matchRouteForUrl:url 
+                   metrics:metrics
            completionBlock:^(BOOL matched, 
                              BOOL isNativeScheme, 
                              FSQRouteContentGenerator * _Nullable contentGenerator, 
@@ -704,102 +1107,505 @@ typedef NS_ENUM(NSInteger, FSQRouteUrlTokenType) {
                if (matched && contentGenerator != nil) {
                    urlData.notificationUserInfo = notificationUserInfo;
                    
-                   [self routeOrDeferContentGenerator:contentGenerator urlData:urlData];                  
+                   [self routeOrDeferContentGenerator:contentGenerator
+                                              urlData:urlData
+                                     prewarmedContent:nil
+                                              metrics:metrics
+                                    cancellationToken:cancellationToken];
                }
                else {
                    [self.delegate urlRouter:self failedToRouteUrl:url notificationUserInfo:notificationUserInfo];
+                   [self finishRoutingPassWithMetrics:metrics
+                                              outcome:FSQRoutingOutcomeFailedToMatch
+                                    cancellationToken:cancellationToken];
                }
            }];
 }
 
 - (void)routeUrl:(NSURL *)url notificationUserInfo:(nullable NSDictionary *)notificationUserInfo usingGenerator:(FSQRouteContentGenerator *)generator {
-    FSQRouteUrlData *urlData = [FSQRouteUrlData new];
-    urlData.url = url;
-    urlData.notificationUserInfo = notificationUserInfo;
+    [self enqueueRouteForUrl:url notificationUserInfo:notificationUserInfo routingPass:^(FSQUrlRouter *router, FSQRouteCancellationToken *cancellationToken) {
+        /**
+         There is no route to match here, so the query items are the only parameters. They are decoded lazily, and
+         only as far as NSURLComponents decodes them ("+" is left as is).
+         */
+        NSURLComponents *urlComponents = [[NSURLComponents alloc] initWithURL:url resolvingAgainstBaseURL:YES];
+        FSQRouteUrlData *urlData = [[FSQRouteUrlData alloc] initWithUrl:url rawQueryItems:urlComponents.queryItems];
+        urlData.notificationUserInfo = notificationUserInfo;
+        
+        [router routeOrDeferContentGenerator:generator
+                                     urlData:urlData
+                            prewarmedContent:nil
+                                     metrics:[router routingMetricsForUrl:url
+                                                     notificationUserInfo:notificationUserInfo
+                                                      resumedFromDeferral:NO]
+                           cancellationToken:cancellationToken];
+    }];
+}
+
+#pragma mark - Routing queue -
+
+- (void)enqueueRouteForUrl:(nullable NSURL *)url
+      notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
+               routingPass:(FSQRoutingPassBlock)routingPass {
+    FSQRouteCancellationToken *supersededCancellationToken = nil;
+    FSQRouteCancellationToken *cancellationToken = nil;
+    FSQPendingRoute *supersededPendingRoute = nil;
+    BOOL startsPendingRouteOnNextTurn = NO;
+    BOOL dropped = NO;
+    
+    [self.routingPassLock lock];
+    FSQRoutingQueuePolicy policy = self.routingQueuePolicy;
+    
+    if (policy == FSQRoutingQueuePolicyLatestWins) {
+        /**
+         Anything still queued was queued under another policy, and is dropped just like the deferred route.
+         */
+        [self.queuedRoutes removeAllObjects];
+        supersededPendingRoute = self.latestPendingRoute;
+        
+        if (self.routingPassInProgress) {
+            /**
+             The in-flight pass is cancelled now, but the new url isn't parsed or matched until the next main queue
+             turn (or until the cancelled pass finishes, if that is sooner). A burst of urls in the meantime only
+             replaces the pending route, so only the last of them is ever matched.
+             */
+            supersededCancellationToken = self.currentRoutingPassCancellationToken;
+            self.latestPendingRoute = [[FSQPendingRoute alloc] initWithUrl:url
+                                                      notificationUserInfo:notificationUserInfo
+                                                               routingPass:routingPass];
+            startsPendingRouteOnNextTurn = (supersededPendingRoute == nil);
+        }
+        else {
+            self.latestPendingRoute = nil;
+            cancellationToken = [self beginRoutingPass];
+        }
+    }
+    else if (policy == FSQRoutingQueuePolicyDedupeWithinInterval
+             && [self isDuplicateRouteRequestForUrl:url]) {
+        dropped = YES;
+    }
+    else if (self.routingPassInProgress
+             || self.queuedRoutes.count > 0
+             || self.hasDeferredRoute) {
+        [self.queuedRoutes addObject:[routingPass copy]];
+    }
+    else {
+        cancellationToken = [self beginRoutingPass];
+    }
+    [self.routingPassLock unlock];
     
-    NSMutableDictionary *mutableParameters = [NSMutableDictionary new];
-    NSURLComponents *urlComponents = [[NSURLComponents alloc] initWithURL:url resolvingAgainstBaseURL:YES];
+    if (dropped) {
+        FSQRoutingMetrics *metrics = [self routingMetricsForUrl:url
+                                           notificationUserInfo:notificationUserInfo
+                                            resumedFromDeferral:NO];
+        [metrics finishWithOutcome:FSQRoutingOutcomeDropped];
+        return;
+    }
     
-    for (NSURLQueryItem *item in urlComponents.queryItems) {
-        mutableParameters[item.name] = item.value;
+    if (policy == FSQRoutingQueuePolicyLatestWins) {
+        [self clearDeferredRoute];
+        [supersededCancellationToken cancel];
+        
+        if (supersededPendingRoute != nil) {
+            FSQRoutingMetrics *metrics = [self routingMetricsForUrl:supersededPendingRoute.url
+                                               notificationUserInfo:supersededPendingRoute.notificationUserInfo
+                                                resumedFromDeferral:NO];
+            [metrics finishWithOutcome:FSQRoutingOutcomeDropped];
+        }
+        
+        if (startsPendingRouteOnNextTurn) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self startLatestPendingRoute];
+            });
+        }
     }
     
-    urlData.parameters = mutableParameters.copy;
+    if (cancellationToken != nil) {
+        routingPass(self, cancellationToken);
+    }
+}
+
+/**
+ Starts the latest pending route, if there still is one. This doesn't wait for the cancelled pass it superseded,
+ which may never finish if its generator ignores cancellation.
+ */
+- (void)startLatestPendingRoute {
+    FSQPendingRoute *pendingRoute = nil;
+    FSQRouteCancellationToken *cancellationToken = nil;
     
-    [self routeOrDeferContentGenerator:generator urlData:urlData];
+    [self.routingPassLock lock];
+    pendingRoute = self.latestPendingRoute;
+    if (pendingRoute != nil) {
+        self.latestPendingRoute = nil;
+        cancellationToken = [self beginRoutingPass];
+    }
+    [self.routingPassLock unlock];
+    
+    if (pendingRoute != nil) {
+        pendingRoute.routingPass(self, cancellationToken);
+    }
 }
 
-- (void)routeOrDeferContentGenerator:(FSQRouteContentGenerator *)contentGenerator urlData:(FSQRouteUrlData *)urlData {
+/**
+ Starts the oldest queued route, unless a routing pass is in progress or a route is deferred.
+ */
+- (void)startNextQueuedRoute {
+    FSQRoutingPassBlock routingPass = nil;
+    FSQRouteCancellationToken *cancellationToken = nil;
+    
+    [self.routingPassLock lock];
+    if (!self.routingPassInProgress
+        && self.queuedRoutes.count > 0
+        && !self.hasDeferredRoute) {
+        routingPass = self.queuedRoutes.firstObject;
+        [self.queuedRoutes removeObjectAtIndex:0];
+        cancellationToken = [self beginRoutingPass];
+    }
+    [self.routingPassLock unlock];
+    
+    if (routingPass != nil) {
+        routingPass(self, cancellationToken);
+    }
+}
+
+/**
+ Ends a routing pass. If it was the most recently started pass, the latest pending route or the next queued route
+ (if any) is started.
+ */
+- (void)finishRoutingPassWithMetrics:(nullable FSQRoutingMetrics *)metrics
+                             outcome:(FSQRoutingOutcome)outcome
+                   cancellationToken:(FSQRouteCancellationToken *)cancellationToken {
+    [metrics finishWithOutcome:outcome];
+    
+    [self.routingPassLock lock];
+    BOOL wasCurrentRoutingPass = (cancellationToken == self.currentRoutingPassCancellationToken);
+    if (wasCurrentRoutingPass) {
+        self.routingPassInProgress = NO;
+    }
+    [self.routingPassLock unlock];
+    
+    if (wasCurrentRoutingPass) {
+        [self startLatestPendingRoute];
+        [self startNextQueuedRoute];
+    }
+}
+
+/**
+ Must be called with routingPassLock held.
+
+ @return A new cancellation token, which is now the current routing pass's token.
+ */
+- (FSQRouteCancellationToken *)beginRoutingPass {
+    FSQRouteCancellationToken *cancellationToken = [FSQRouteCancellationToken new];
+    self.currentRoutingPassCancellationToken = cancellationToken;
+    self.routingPassInProgress = YES;
+    
+    NSTimeInterval routingPassTimeout = self.routingPassTimeout;
+    if (routingPassTimeout > 0) {
+        __weak FSQUrlRouter *weakSelf = self;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(routingPassTimeout * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+            [weakSelf routingPassDidTimeOutWithCancellationToken:cancellationToken];
+        });
+    }
+    
+    return cancellationToken;
+}
+
+/**
+ Cancels a routing pass which is still in progress after routingPassTimeout, eg because the delegate never called
+ its presentation completion handler or an async generator never completed, so that the urls behind it can start.
+ If the pass carries on later, it finishes as cancelled.
+ */
+- (void)routingPassDidTimeOutWithCancellationToken:(FSQRouteCancellationToken *)cancellationToken {
+    [self.routingPassLock lock];
+    BOOL timedOut = (cancellationToken == self.currentRoutingPassCancellationToken
+                     && self.routingPassInProgress
+                     && !cancellationToken.isCancelled);
+    if (timedOut) {
+        self.routingPassInProgress = NO;
+    }
+    [self.routingPassLock unlock];
+    
+    if (timedOut) {
+        [cancellationToken cancel];
+        [self startLatestPendingRoute];
+        [self startNextQueuedRoute];
+    }
+}
+
+/**
+ Must be called with routingPassLock held. Records the request time of the url if it is not a duplicate.
+
+ @return YES if the same url was requested less than routingQueueDedupeInterval ago.
+ */
+- (BOOL)isDuplicateRouteRequestForUrl:(nullable NSURL *)url {
+    if (url == nil) {
+        return NO;
+    }
+    
+    NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+    NSTimeInterval oldestRequestTime = now - self.routingQueueDedupeInterval;
+    NSMutableDictionary<NSURL *, NSNumber *> *recentRouteRequestTimes = self.recentRouteRequestTimes;
+    
+    for (NSURL *recentUrl in recentRouteRequestTimes.allKeys) {
+        if (recentRouteRequestTimes[recentUrl].doubleValue < oldestRequestTime) {
+            [recentRouteRequestTimes removeObjectForKey:recentUrl];
+        }
+    }
+    
+    if (recentRouteRequestTimes[url] != nil) {
+        return YES;
+    }
+    
+    recentRouteRequestTimes[url] = @(now);
+    return NO;
+}
+
+- (NSUInteger)numberOfQueuedRoutes {
+    [self.routingPassLock lock];
+    NSUInteger numberOfQueuedRoutes = self.queuedRoutes.count;
+    [self.routingPassLock unlock];
+    return numberOfQueuedRoutes;
+}
+
+- (void)clearQueuedRoutes {
+    [self.routingPassLock lock];
+    [self.queuedRoutes removeAllObjects];
+    self.latestPendingRoute = nil;
+    [self.routingPassLock unlock];
+}
+
+/**
+ Cancels the routing pass in progress (if any) and returns the cancellation token for a new one.
+ */
+- (FSQRouteCancellationToken *)cancellationTokenForNewRoutingPass {
+    [self.routingPassLock lock];
+    FSQRouteCancellationToken *supersededCancellationToken = self.currentRoutingPassCancellationToken;
+    FSQRouteCancellationToken *cancellationToken = [self beginRoutingPass];
+    [self.routingPassLock unlock];
+    
+    /**
+     Cancelling runs the generator's cancellation handlers, so it is done outside the lock.
+     */
+    [supersededCancellationToken cancel];
+    
+    return cancellationToken;
+}
+
+/**
+ Fills in the router's default presentation and view controller pool on content generated by one of its routes,
+ unless the generator already set its own.
+ */
+- (void)applyRouterDefaultsToContent:(nullable FSQRouteContent *)routeContent {
+    if (routeContent.defaultPresentation == nil) {
+        routeContent.defaultPresentation = self.defaultRoutedUrlPresentation;
+    }
+    if (routeContent.reusePool == nil) {
+        routeContent.reusePool = self.viewControllerReusePool;
+    }
+}
+
+/**
+ @return A new metrics object for a routing pass, or nil if there is no metrics observer or trace recorder.
+ */
+- (nullable FSQRoutingMetrics *)routingMetricsForUrl:(nullable NSURL *)url
+                                notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
+                                 resumedFromDeferral:(BOOL)resumedFromDeferral {
+    id<FSQRoutingMetricsObserver> metricsObserver = self.metricsObserver;
+    FSQRouteTraceRecorder *traceRecorder = self.traceRecorder;
+    if (metricsObserver == nil
+        && traceRecorder == nil) {
+        return nil;
+    }
+    return [[FSQRoutingMetrics alloc] initWithUrl:url
+                             notificationUserInfo:notificationUserInfo
+                                         observer:metricsObserver
+                                    traceRecorder:traceRecorder
+                              resumedFromDeferral:resumedFromDeferral];
+}
+
+/**
+ @param prewarmedContent If not nil, this content is routed instead of generating new content with the generator.
+ */
+- (void)routeOrDeferContentGenerator:(FSQRouteContentGenerator *)contentGenerator 
+                             urlData:(FSQRouteUrlData *)urlData 
+                    prewarmedContent:(nullable FSQRouteContent *)prewarmedContent
+                             metrics:(nullable FSQRoutingMetrics *)metrics
+                   cancellationToken:(FSQRouteCancellationToken *)cancellationToken {
     [self clearDeferredRoute];
     
     FSQUrlRoutingControl routingControl = FSQUrlRouterAllowRouting;
     
     if (self.delegate) {
+        [metrics beginStage:FSQRoutingStageShouldGenerateRouteContent];
         routingControl = [self.delegate urlRouter:self shouldGenerateRouteContent:contentGenerator withUrlData:urlData];
+        [metrics endStage:FSQRoutingStageShouldGenerateRouteContent];
     }
     
     switch (routingControl) {
         case FSQUrlRouterAllowRouting: {
-            FSQRouteContent *routeContent = [contentGenerator generateRouteContentFromUrlData:urlData];
-            if (routeContent == nil) {
-                [self.delegate urlRouter:self failedToGenerateContent:contentGenerator urlData:urlData];
-            }
-            else {
-                if (routeContent.defaultPresentation == nil) {
-                    routeContent.defaultPresentation = self.defaultRoutedUrlPresentation;
-                }
-                [self routeOrDeferContent:routeContent];                
+            if (prewarmedContent != nil) {
+                [self routeOrDeferContent:prewarmedContent metrics:metrics cancellationToken:cancellationToken];
+                break;
             }
+            
+            [metrics beginStage:FSQRoutingStageContentGeneration];
+            [contentGenerator generateRouteContentFromUrlData:urlData
+                                            cancellationToken:cancellationToken
+                                                   completion:^(FSQRouteContent *_Nullable routeContent) {
+                [metrics endStage:FSQRoutingStageContentGeneration];
+                
+                /**
+                 Async generators can complete on any thread, but the delegate callbacks from here on are always made
+                 on the main queue since delegates present UI from them. Generators which complete on the main queue
+                 carry on without a hop.
+                 */
+                FSQPerformOnMainQueue(^{
+                    if (cancellationToken.isCancelled) {
+                        /**
+                         A newer route started while this content was being generated.
+                         */
+                        [self finishRoutingPassWithMetrics:metrics
+                                                   outcome:FSQRoutingOutcomeCancelled
+                                         cancellationToken:cancellationToken];
+                    }
+                    else if (routeContent == nil) {
+                        [self.delegate urlRouter:self failedToGenerateContent:contentGenerator urlData:urlData];
+                        [self finishRoutingPassWithMetrics:metrics
+                                                   outcome:FSQRoutingOutcomeFailedToGenerateContent
+                                         cancellationToken:cancellationToken];
+                    }
+                    else {
+                        [self applyRouterDefaultsToContent:routeContent];
+                        [self routeOrDeferContent:routeContent metrics:metrics cancellationToken:cancellationToken];
+                    }
+                });
+            }];
         }
             break;
         case FSQUrlRouterCancelRouting: {
-            // Do nothing
+            [self finishRoutingPassWithMetrics:metrics
+                                       outcome:FSQRoutingOutcomeCancelled
+                             cancellationToken:cancellationToken];
         }
             break;
         case FSQUrlRouterDeferRouting: {
+            NSUInteger routeIndex = (metrics != nil) ? metrics.routeIndex : NSNotFound;
+            NSUInteger numberOfRoutesTried = metrics.numberOfRoutesTried;
+            
             self.deferredRoute = ^(FSQUrlRouter *router) {
-                [router routeOrDeferContentGenerator:contentGenerator urlData:urlData];
+                FSQRoutingMetrics *resumedMetrics = [router routingMetricsForUrl:urlData.url
+                                                            notificationUserInfo:urlData.notificationUserInfo
+                                                             resumedFromDeferral:YES];
+                [resumedMetrics recordRouteIndex:routeIndex numberOfRoutesTried:numberOfRoutesTried];
+                if (prewarmedContent != nil) {
+                    [resumedMetrics recordUsedPrewarmedContent];
+                }
+                [router routeOrDeferContentGenerator:contentGenerator
+                                             urlData:urlData
+                                    prewarmedContent:prewarmedContent
+                                             metrics:resumedMetrics
+                                   cancellationToken:[router cancellationTokenForNewRoutingPass]];
             };
+            [self finishRoutingPassWithMetrics:metrics
+                                       outcome:FSQRoutingOutcomeDeferred
+                             cancellationToken:cancellationToken];
         }
             break;
     } 
 }
 
-- (void)routeOrDeferContent:(FSQRouteContent *)routeContent {
+- (void)routeOrDeferContent:(FSQRouteContent *)routeContent
+                    metrics:(nullable FSQRoutingMetrics *)metrics
+          cancellationToken:(FSQRouteCancellationToken *)cancellationToken {
      [self clearDeferredRoute];
     
     FSQUrlRoutingControl routingControl = FSQUrlRouterAllowRouting;
     
     if (self.delegate) {
+        [metrics beginStage:FSQRoutingStageShouldPresentRoute];
         routingControl = [self.delegate urlRouter:self shouldPresentRoute:routeContent];
+        [metrics endStage:FSQRoutingStageShouldPresentRoute];
     }
     
     switch (routingControl) {
         case FSQUrlRouterAllowRouting: {
             void (^delegateCompletionBlock)(void) = ^(void) {
+                [metrics endStage:FSQRoutingStageWillPresent];
+                [metrics beginStage:FSQRoutingStageMainQueueHop];
+                
                 dispatch_async(dispatch_get_main_queue(), ^{
+                    [metrics endStage:FSQRoutingStageMainQueueHop];
+                    
+                    /**
+                     Superseded routes are dropped at the last moment too, in case a newer route started while the
+                     delegate was getting ready to present this one.
+                     */
+                    if (cancellationToken.isCancelled) {
+                        [self finishRoutingPassWithMetrics:metrics
+                                                   outcome:FSQRoutingOutcomeCancelled
+                                         cancellationToken:cancellationToken];
+                        return;
+                    }
+                    
+                    [metrics beginStage:FSQRoutingStagePresentation];
+                    
                     UIViewController *presentingViewController = [self.delegate urlRouter:self
                                                      viewControllerToPresentRoutedUrlFrom:routeContent];
                     if (presentingViewController) {
                         [routeContent presentFromViewController:presentingViewController];
                         [self.delegate urlRouter:self routedUrlDidGetPresented:routeContent];
                     }
+                    
+                    [metrics endStage:FSQRoutingStagePresentation];
+                    [self finishRoutingPassWithMetrics:metrics
+                                               outcome:(presentingViewController
+                                                        ? FSQRoutingOutcomePresented
+                                                        : FSQRoutingOutcomeNoPresentingViewController)
+                                     cancellationToken:cancellationToken];
                 });
             };
             
-            [self.delegate urlRouter:self
-            routedUrlWillBePresented:routeContent
-                   completionHandler:delegateCompletionBlock];
+            /**
+             Without a delegate there is nothing to present from, and nobody to call the completion handler, so the
+             pass has to be finished here or the routing queue would wait on it.
+             */
+            id<FSQUrlRouterDelegate> delegate = self.delegate;
+            if (delegate == nil) {
+                [self finishRoutingPassWithMetrics:metrics
+                                           outcome:FSQRoutingOutcomeNoPresentingViewController
+                                 cancellationToken:cancellationToken];
+                break;
+            }
+            
+            [metrics beginStage:FSQRoutingStageWillPresent];
+            [delegate urlRouter:self
+       routedUrlWillBePresented:routeContent
+              completionHandler:delegateCompletionBlock];
         }
             break;
         case FSQUrlRouterCancelRouting: {
-            // Do nothing
+            [self finishRoutingPassWithMetrics:metrics
+                                       outcome:FSQRoutingOutcomeCancelled
+                             cancellationToken:cancellationToken];
         }
             break;
         case FSQUrlRouterDeferRouting: {
+            NSUInteger routeIndex = (metrics != nil) ? metrics.routeIndex : NSNotFound;
+            NSUInteger numberOfRoutesTried = metrics.numberOfRoutesTried;
+            
             self.deferredRoute = ^(FSQUrlRouter *router) {
-                [router routeOrDeferContent:routeContent];
+                FSQRoutingMetrics *resumedMetrics = [router routingMetricsForUrl:routeContent.urlData.url
+                                                            notificationUserInfo:routeContent.urlData.notificationUserInfo
+                                                             resumedFromDeferral:YES];
+                [resumedMetrics recordRouteIndex:routeIndex numberOfRoutesTried:numberOfRoutesTried];
+                [router routeOrDeferContent:routeContent
+                                    metrics:resumedMetrics
+                          cancellationToken:[router cancellationTokenForNewRoutingPass]];
             };
+            [self finishRoutingPassWithMetrics:metrics
+                                       outcome:FSQRoutingOutcomeDeferred
+                             cancellationToken:cancellationToken];
         }
             break;
     } 
@@ -808,9 +1614,33 @@ typedef NS_ENUM(NSInteger, FSQRouteUrlTokenType) {
 
 #pragma mark - Route deferral -
 
+@synthesize deferredRoute = _deferredRoute;
+
+- (nullable void (^)(FSQUrlRouter *router))deferredRoute {
+    [self.deferredRouteLock lock];
+    void (^deferredRoute)(FSQUrlRouter *router) = _deferredRoute;
+    [self.deferredRouteLock unlock];
+    return deferredRoute;
+}
+
+- (void)setDeferredRoute:(nullable void (^)(FSQUrlRouter *router))deferredRoute {
+    [self.deferredRouteLock lock];
+    _deferredRoute = [deferredRoute copy];
+    [self.deferredRouteLock unlock];
+}
+
 - (void)handleDeferredRoute {
-    if (self.deferredRoute) {
-        self.deferredRoute(self);
+    /**
+     Take the deferred route out of the slot before running it so two threads calling this at once can't
+     both run the same route.
+     */
+    [self.deferredRouteLock lock];
+    void (^deferredRoute)(FSQUrlRouter *router) = _deferredRoute;
+    _deferredRoute = nil;
+    [self.deferredRouteLock unlock];
+    
+    if (deferredRoute) {
+        deferredRoute(self);
     }
 }
 
@@ -820,6 +1650,11 @@ typedef NS_ENUM(NSInteger, FSQRouteUrlTokenType) {
 
 - (void)clearDeferredRoute {
     self.deferredRoute = nil;
+    
+    /**
+     Routes queued behind the deferred route can go now.
+     */
+    [self startNextQueuedRoute];
 }
 
 #pragma mark - Public manual route generation - 
@@ -833,89 +1668,706 @@ typedef NS_ENUM(NSInteger, FSQRouteUrlTokenType) {
     
     __block FSQRouteContent *content = nil;
     
-    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    /**
+     Matching calls its completion block before returning, so there is nothing to wait for. Asynchronous generators
+     are never waited on, since blocking the main queue on one that completes on the main queue would deadlock.
+     */
     [self matchRouteForUrl:url 
            completionBlock:^(BOOL matched, 
                              BOOL isNativeScheme, 
                              FSQRouteContentGenerator * _Nullable contentGenerator, 
                              FSQRouteUrlData * _Nullable urlData) {
+               if (contentGenerator.asyncGeneratorBlock != nil) {
+                   NSAssert(NO, @"generateRouteContentFromUrl: can't generate content from an asynchronous generator, use generateRouteContentFromUrl:notificationUserInfo:completion: instead. url = %@", url);
+                   return;
+               }
+               
                if (matched && contentGenerator != nil) {
                    urlData.notificationUserInfo = notificationUserInfo;
                    content = [contentGenerator generateRouteContentFromUrlData:urlData];
-                   if (content.defaultPresentation == nil) {
-                       content.defaultPresentation = self.defaultRoutedUrlPresentation;
-                   }
+                   [self applyRouterDefaultsToContent:content];
                }
-               dispatch_semaphore_signal(semaphore);
            }];
-    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);   
     return content;
 }
 
+- (FSQRouteCancellationToken *)generateRouteContentFromUrl:(NSURL *)url
+                                      notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
+                                                completion:(void (^)(FSQRouteContent *_Nullable routeContent))completion {
+    FSQRouteCancellationToken *cancellationToken = [FSQRouteCancellationToken new];
+    
+    [self matchRouteForUrl:url
+           completionBlock:^(BOOL matched,
+                             BOOL isNativeScheme,
+                             FSQRouteContentGenerator * _Nullable contentGenerator,
+                             FSQRouteUrlData * _Nullable urlData) {
+               if (matched && contentGenerator != nil) {
+                   urlData.notificationUserInfo = notificationUserInfo;
+                   [contentGenerator generateRouteContentFromUrlData:urlData
+                                                   cancellationToken:cancellationToken
+                                                          completion:^(FSQRouteContent *_Nullable routeContent) {
+                       if (cancellationToken.isCancelled) {
+                           completion(nil);
+                           return;
+                       }
+                       
+                       [self applyRouterDefaultsToContent:routeContent];
+                       completion(routeContent);
+                   }];
+               }
+               else {
+                   completion(nil);
+               }
+           }];
+    
+    return cancellationToken;
+}
+
+#pragma mark - Prewarming -
+
+- (void)prewarmUrl:(NSURL *)url {
+    [self prewarmUrl:url notificationUserInfo:nil];
+}
+
+- (void)prewarmUrl:(NSURL *)url notificationUserInfo:(nullable NSDictionary *)notificationUserInfo {
+    FSQPrewarmedRouteContentCache *prewarmedContentCache = self.prewarmedContentCache;
+    
+    if (url == nil
+        || prewarmedContentCache.capacity == 0) {
+        return;
+    }
+    
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), ^{
+        FSQRouteTable *routeTable = self.routeTable;
+        
+        /**
+         Urls which are already prewarmed for the current routes are not generated again.
+         */
+        if ([prewarmedContentCache hasContentForUrl:url
+                               notificationUserInfo:notificationUserInfo
+                                         generation:routeTable.generation]) {
+            return;
+        }
+        
+        FSQParsedRouteUrl *parsedUrl = [[FSQParsedRouteUrl alloc] initWithUrl:url];
+        FSQRouteMatch *match = [self routeMatchForParsedUrl:parsedUrl inRouteTable:routeTable metrics:nil];
+        
+        if (!match.matched) {
+            return;
+        }
+        
+        /**
+         Only matching happens in the background. Generators are called on the main queue, just like when a url is
+         routed from the main queue, so synchronous generators never have to be thread safe.
+         */
+        dispatch_async(dispatch_get_main_queue(), ^{
+            FSQRouteUrlData *urlData = match.urlData;
+            urlData.notificationUserInfo = notificationUserInfo;
+            
+            [match.contentGenerator generateRouteContentFromUrlData:urlData
+                                                  cancellationToken:[FSQRouteCancellationToken new]
+                                                         completion:^(FSQRouteContent *_Nullable routeContent) {
+                if (routeContent == nil) {
+                    return;
+                }
+                
+                [self applyRouterDefaultsToContent:routeContent];
+                
+                /**
+                 View controllers have to be created on the main queue, and async generators may complete on any
+                 thread. Presentation also happens on the main queue, so content which is routed before this runs
+                 just creates its view controller then as usual. Content with a reuse identifier is left alone, so a
+                 pooled view controller isn't taken for a url which may never be routed.
+                 */
+                if (routeContent.contentBlock == nil
+                    && routeContent.viewController == nil
+                    && routeContent.viewControllerClass != Nil
+                    && routeContent.reuseIdentifier == nil) {
+                    dispatch_async(dispatch_get_main_queue(), ^{
+                        [routeContent viewControllerToPresent];
+                    });
+                }
+                
+                [prewarmedContentCache addContent:[[FSQPrewarmedRouteContent alloc] initWithMatch:match
+                                                                                      routeContent:routeContent
+                                                                              notificationUserInfo:notificationUserInfo]];
+            }];
+        });
+    });
+}
+
+- (void)setPrewarmedContentCapacity:(NSUInteger)prewarmedContentCapacity {
+    self.prewarmedContentCache.capacity = prewarmedContentCapacity;
+}
+
+- (NSUInteger)prewarmedContentCapacity {
+    return self.prewarmedContentCache.capacity;
+}
+
+- (void)clearPrewarmedContent {
+    [self.prewarmedContentCache removeAllContent];
+}
+
 #pragma mark - Test-only methods - 
 
 - (NSDictionary<NSString *, NSString *> *)parametersForUrlString:(NSString *)urlString matchingAgainstRoute:(NSString *)routeString {
-    NSArray<FSQRouteUrlToken *> *tokens = [self tokenizedRouteString:routeString];
+    FSQCompiledRoute *route = [[FSQCompiledRoute alloc] initWithTokens:FSQTokenizedRouteString(routeString)
+                                                      contentGenerator:[FSQRouteContentGenerator new]
+                                                            routeIndex:0];
+    FSQParsedRouteUrl *parsedUrl = [[FSQParsedRouteUrl alloc] initWithUrl:[NSURL URLWithString:urlString]];
+    
+    NSMutableDictionary<NSString *, NSString *> *parameters = [route pathParametersForParsedUrl:parsedUrl];
+    [parameters addEntriesFromDictionary:parsedUrl.queryParameters];
+    return parameters;
+}
+
+- (NSInteger)indexOfRouteMatchingUrlString:(NSString *)urlString inRouteStrings:(NSArray<NSString *> *)routeStrings {
+    FSQRouteContentGenerator *generator = [FSQRouteContentGenerator new];
+    NSMutableArray<NSArray *> *map = [NSMutableArray new];
+    for (NSString *routeString in routeStrings) {
+        [map addObject:@[routeString, generator]];
+    }
+    
+    FSQCompiledRouteMap *compiledMap = [[FSQCompiledRouteMap alloc] initWithTokenizedRouteMap:[self tokenizeRouteMap:map options:FSQRouteMatchingOptionsNone]];
+    FSQParsedRouteUrl *parsedUrl = [[FSQParsedRouteUrl alloc] initWithUrl:[NSURL URLWithString:urlString]];
+    
+    FSQCompiledRoute *route = [compiledMap routeMatchingParsedUrl:parsedUrl pathParameters:NULL numberOfRoutesTried:NULL];
+    
+    return (route != nil) ? route.routeIndex : NSNotFound;
+}
+
+- (NSUInteger)numberOfInternedRouteStrings {
+    return [FSQRouteStringPool sharedPool].count;
+}
+
+- (NSArray<NSArray *> *)tokenizedRouteMapForRouteStrings:(NSArray<NSString *> *)routeStrings {
+    FSQRouteContentGenerator *generator = [FSQRouteContentGenerator new];
+    NSMutableArray<NSArray *> *map = [NSMutableArray new];
+    for (NSString *routeString in routeStrings) {
+        [map addObject:@[routeString, generator]];
+    }
+    return [self tokenizeRouteMap:map options:FSQRouteMatchingOptionsNone];
+}
+
+- (NSUInteger)numberOfRoutesInTokenizedRouteMap:(NSArray<NSArray *> *)tokenizedRouteMap 
+                              matchingUrlString:(NSString *)urlString {
+    return [self numberOfRoutesInTokenizedRouteMap:tokenizedRouteMap matchingUrlString:urlString parsingUrlPerRoute:NO];
+}
+
+- (NSUInteger)numberOfRoutesInTokenizedRouteMap:(NSArray<NSArray *> *)tokenizedRouteMap
+                              matchingUrlString:(NSString *)urlString
+                             parsingUrlPerRoute:(BOOL)parsingUrlPerRoute {
+    /**
+     Matches every route individually (skipping the trie) so that tests can measure the per-route matching cost.
+     Parsing the url again for each route is how the matcher used to work, and gives the tests a baseline.
+     */
+    NSMutableArray<FSQCompiledRoute *> *routes = [NSMutableArray arrayWithCapacity:tokenizedRouteMap.count];
+    for (NSArray *pair in tokenizedRouteMap) {
+        [routes addObject:[[FSQCompiledRoute alloc] initWithTokens:[pair firstObject]
+                                                  contentGenerator:[pair lastObject]
+                                                        routeIndex:routes.count]];
+    }
     
-    return [self parametersForUrl:[NSURL URLWithString:urlString] ifMatchingPath:tokens];
+    NSURL *url = [NSURL URLWithString:urlString];
+    FSQParsedRouteUrl *parsedUrl = [[FSQParsedRouteUrl alloc] initWithUrl:url];
+    NSUInteger numberOfMatches = 0;
+    for (FSQCompiledRoute *route in routes) {
+        if (parsingUrlPerRoute) {
+            parsedUrl = [[FSQParsedRouteUrl alloc] initWithUrl:url];
+        }
+        if ([route pathParametersForParsedUrl:parsedUrl] != nil) {
+            numberOfMatches++;
+        }
+    }
+    return numberOfMatches;
 }
 
 @end
 
 
-@implementation FSQRouteUrlToken
+@implementation FSQRouteTable
 
-+ (instancetype)withString:(NSString *)string {
-    FSQRouteUrlToken *token = [self new];
-    token->_type = FSQRouteUrlTokenTypeString;
-    token->_stringOrParameterName = [string copy];
-    return token;
+- (instancetype)initWithNativeSchemeRouteMaps:(NSDictionary<NSString *, FSQCompiledRouteMap *> *)nativeSchemeRouteMaps
+                            httpHostRouteMaps:(NSDictionary<NSString *, FSQCompiledRouteMap *> *)httpHostRouteMaps
+                              hostPatternTrie:(nullable FSQHostPatternTrieNode *)hostPatternTrie
+                                   generation:(NSUInteger)generation {
+    self = [super init];
+    if (self) {
+        _nativeSchemeRouteMaps = [nativeSchemeRouteMaps copy];
+        _httpHostRouteMaps = [httpHostRouteMaps copy];
+        _hostPatternTrie = hostPatternTrie;
+        _generation = generation;
+    }
+    return self;
+}
+
+- (nullable FSQCompiledRouteMap *)routeMapForParsedUrl:(FSQParsedRouteUrl *)parsedUrl {
+    if (parsedUrl.isNativeScheme) {
+        return self.nativeSchemeRouteMaps[parsedUrl.scheme];
+    }
+    
+    /**
+     Exact hosts are a single dictionary lookup. The host is only split into labels when that fails and there are
+     patterns to check. Hosts are registered in lowercase, so both lookups use the lowercased host.
+     */
+    NSString *host = parsedUrl.lowercaseHost;
+    FSQCompiledRouteMap *routeMap = (host != nil) ? self.httpHostRouteMaps[host] : nil;
+    if (routeMap == nil
+        && self.hostPatternTrie != nil
+        && host.length > 0) {
+        routeMap = [self.hostPatternTrie routeMapForReversedHostLabels:parsedUrl.reversedHostLabels];
+    }
+    return routeMap;
 }
 
-+ (instancetype)withParameterName:(NSString *)parameterName {
-    FSQRouteUrlToken *token = [self new];
-    token->_type = FSQRouteUrlTokenTypeParameter;
-    token->_stringOrParameterName = [parameterName copy];
-    return token;
+- (nullable FSQCompiledRouteMap *)routeMapForUniversalLinkHost:(NSString *)host {
+    host = host.lowercaseString;
+    FSQCompiledRouteMap *routeMap = self.httpHostRouteMaps[host];
+    if (routeMap == nil
+        && self.hostPatternTrie != nil
+        && host.length > 0) {
+        routeMap = [self.hostPatternTrie routeMapForReversedHostLabels:FSQReversedHostLabels(host)];
+    }
+    return routeMap;
 }
 
-+ (instancetype)singleComponentWildCard {
-    static FSQRouteUrlToken *token;
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        token = [self new];
-        token->_type = FSQRouteUrlTokenTypeSingleComponentWildcard;
-    });
+@end
+
+
+@implementation FSQHostPatternTrieNode
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _children = [NSMutableDictionary new];
+    }
+    return self;
+}
+
++ (nullable instancetype)trieWithHttpHostRouteMaps:(NSDictionary<NSString *, FSQCompiledRouteMap *> *)httpHostRouteMaps {
+    FSQHostPatternTrieNode *root = nil;
     
-    return token;
+    for (NSString *host in httpHostRouteMaps) {
+        if (![host hasPrefix:@"*."]
+            || host.length <= 2) {
+            continue;
+        }
+        
+        if (root == nil) {
+            root = [self new];
+        }
+        
+        FSQHostPatternTrieNode *node = root;
+        for (NSString *label in FSQReversedHostLabels([host substringFromIndex:2])) {
+            FSQHostPatternTrieNode *child = node.children[label];
+            if (child == nil) {
+                child = [self new];
+                node.children[label] = child;
+            }
+            node = child;
+        }
+        node.subdomainRouteMap = httpHostRouteMaps[host];
+    }
+    
+    return root;
 }
 
-+ (instancetype)unlimitedComponentWildCard {
-    static FSQRouteUrlToken *token;
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        token = [self new];
-        token->_type = FSQRouteUrlTokenTypeUnlimitedComponentWildcard;
-    });
+- (nullable FSQCompiledRouteMap *)routeMapForReversedHostLabels:(NSArray<NSString *> *)reversedHostLabels {
+    FSQCompiledRouteMap *routeMap = nil;
+    FSQHostPatternTrieNode *node = self;
+    NSUInteger numberOfLabels = reversedHostLabels.count;
+    
+    for (NSUInteger labelIndex = 0; labelIndex < numberOfLabels && node != nil; labelIndex++) {
+        node = node.children[reversedHostLabels[labelIndex]];
+        
+        /**
+         A pattern only matches hosts which have at least one more label in place of its "*".
+         */
+        if (node.subdomainRouteMap != nil
+            && labelIndex + 1 < numberOfLabels) {
+            routeMap = node.subdomainRouteMap;
+        }
+    }
+    
+    return routeMap;
+}
+
+@end
+
+
+@implementation FSQRouteMatchCacheKey {
+    BOOL _isNativeScheme;
+    NSString *_routeMapKey;
+    NSArray<NSString *> *_pathComponents;
+    NSUInteger _hash;
+}
+
+- (instancetype)initWithParsedUrl:(FSQParsedRouteUrl *)parsedUrl {
+    self = [super init];
+    if (self) {
+        _isNativeScheme = parsedUrl.isNativeScheme;
+        _routeMapKey = (parsedUrl.isNativeScheme ? parsedUrl.scheme : parsedUrl.lowercaseHost) ?: @"";
+        _pathComponents = parsedUrl.pathComponents;
+        
+        /**
+         NSArray's own hash is just its count, so the component hashes are combined here instead.
+         */
+        NSUInteger hash = _routeMapKey.hash;
+        for (NSString *component in _pathComponents) {
+            hash = (hash * 31) + component.hash;
+        }
+        _hash = hash;
+    }
+    return self;
+}
+
+- (id)copyWithZone:(nullable NSZone *)zone {
+    return self;
+}
+
+- (NSUInteger)hash {
+    return _hash;
+}
+
+- (BOOL)isEqual:(id)object {
+    if (object == self) {
+        return YES;
+    }
+    if (![object isKindOfClass:[FSQRouteMatchCacheKey class]]) {
+        return NO;
+    }
+    
+    FSQRouteMatchCacheKey *key = object;
+    return (key->_hash == _hash
+            && key->_isNativeScheme == _isNativeScheme
+            && [key->_routeMapKey isEqualToString:_routeMapKey]
+            && [key->_pathComponents isEqualToArray:_pathComponents]);
+}
+
+@end
+
+
+@implementation FSQRouteMatchCacheEntry
+
+- (instancetype)initWithKey:(FSQRouteMatchCacheKey *)key
+                      route:(nullable FSQCompiledRoute *)route
+             pathParameters:(nullable NSDictionary<NSString *, NSString *> *)pathParameters {
+    self = [super init];
+    if (self) {
+        _key = key;
+        _route = route;
+        _pathParameters = [pathParameters copy];
+    }
+    return self;
+}
+
+@end
+
+
+@implementation FSQRouteMatchCache {
+    NSLock *_lock;
+    NSMutableDictionary<FSQRouteMatchCacheKey *, FSQRouteMatchCacheEntry *> *_entries;
+    FSQRouteMatchCacheEntry *_newestEntry;
+    FSQRouteMatchCacheEntry *_oldestEntry;
+    NSUInteger _generation;
+    NSUInteger _capacity;
+    NSUInteger _hitCount;
+    NSUInteger _missCount;
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self) {
+        _lock = [NSLock new];
+        _entries = [NSMutableDictionary new];
+        _capacity = capacity;
+    }
+    return self;
+}
+
+- (NSUInteger)capacity {
+    [_lock lock];
+    NSUInteger capacity = _capacity;
+    [_lock unlock];
+    return capacity;
+}
+
+- (void)setCapacity:(NSUInteger)capacity {
+    [_lock lock];
+    _capacity = capacity;
+    [self trimToCapacity];
+    [_lock unlock];
+}
+
+- (NSUInteger)hitCount {
+    [_lock lock];
+    NSUInteger hitCount = _hitCount;
+    [_lock unlock];
+    return hitCount;
+}
+
+- (NSUInteger)missCount {
+    [_lock lock];
+    NSUInteger missCount = _missCount;
+    [_lock unlock];
+    return missCount;
+}
+
+- (nullable FSQRouteMatchCacheEntry *)entryForKey:(FSQRouteMatchCacheKey *)key generation:(NSUInteger)generation {
+    [_lock lock];
+    
+    [self invalidateIfNeededForGeneration:generation];
+    
+    FSQRouteMatchCacheEntry *entry = _entries[key];
+    if (entry != nil) {
+        _hitCount++;
+        [self unlinkEntry:entry];
+        [self linkNewestEntry:entry];
+    }
+    else {
+        _missCount++;
+    }
+    
+    [_lock unlock];
+    
+    return entry;
+}
+
+- (void)addEntry:(FSQRouteMatchCacheEntry *)entry generation:(NSUInteger)generation {
+    [_lock lock];
+    
+    /**
+     A match made against an older table than the cache has already seen must not be stored, it may no longer
+     be correct.
+     */
+    if (generation >= _generation) {
+        [self invalidateIfNeededForGeneration:generation];
+        
+        FSQRouteMatchCacheEntry *existingEntry = _entries[entry.key];
+        if (existingEntry != nil) {
+            [self unlinkEntry:existingEntry];
+        }
+        
+        _entries[entry.key] = entry;
+        [self linkNewestEntry:entry];
+        [self trimToCapacity];
+    }
+    
+    [_lock unlock];
+}
+
+/**
+ The methods below must be called with the lock held.
+ */
+
+- (void)invalidateIfNeededForGeneration:(NSUInteger)generation {
+    if (generation > _generation) {
+        [_entries removeAllObjects];
+        _newestEntry = nil;
+        _oldestEntry = nil;
+        _generation = generation;
+    }
+}
+
+- (void)trimToCapacity {
+    while (_entries.count > _capacity
+           && _oldestEntry != nil) {
+        FSQRouteMatchCacheEntry *entry = _oldestEntry;
+        [self unlinkEntry:entry];
+        [_entries removeObjectForKey:entry.key];
+    }
+}
+
+- (void)unlinkEntry:(FSQRouteMatchCacheEntry *)entry {
+    if (entry.newerEntry != nil) {
+        entry.newerEntry.olderEntry = entry.olderEntry;
+    }
+    else {
+        _newestEntry = entry.olderEntry;
+    }
+    
+    if (entry.olderEntry != nil) {
+        entry.olderEntry.newerEntry = entry.newerEntry;
+    }
+    else {
+        _oldestEntry = entry.newerEntry;
+    }
     
-    return token;
+    entry.newerEntry = nil;
+    entry.olderEntry = nil;
 }
 
-- (NSString *)stringForType:(FSQRouteUrlTokenType)type {
-    switch (type) {
-        case FSQRouteUrlTokenTypeString:
-            return @"string";
-        case FSQRouteUrlTokenTypeParameter:
-            return @"parameter";
-        case FSQRouteUrlTokenTypeSingleComponentWildcard:
-            return @"*";
-        case FSQRouteUrlTokenTypeUnlimitedComponentWildcard:
-            return  @"**";
+- (void)linkNewestEntry:(FSQRouteMatchCacheEntry *)entry {
+    entry.olderEntry = _newestEntry;
+    _newestEntry.newerEntry = entry;
+    _newestEntry = entry;
+    
+    if (_oldestEntry == nil) {
+        _oldestEntry = entry;
     }
 }
 
-- (NSString *)debugDescription {
-    return [NSString stringWithFormat:@"%@, (%@)", [self stringForType:self.type], self.stringOrParameterName];
+@end
+
+@implementation FSQPendingRoute
+
+- (instancetype)initWithUrl:(nullable NSURL *)url
+       notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
+                routingPass:(FSQRoutingPassBlock)routingPass {
+    self = [super init];
+    if (self) {
+        _url = url;
+        _notificationUserInfo = [notificationUserInfo copy];
+        _routingPass = [routingPass copy];
+    }
+    return self;
+}
+
+@end
+
+@implementation FSQPrewarmedRouteContent
+
+- (instancetype)initWithMatch:(FSQRouteMatch *)match
+                 routeContent:(FSQRouteContent *)routeContent
+         notificationUserInfo:(nullable NSDictionary *)notificationUserInfo {
+    self = [super init];
+    if (self) {
+        _match = match;
+        _routeContent = routeContent;
+        _notificationUserInfo = [notificationUserInfo copy];
+    }
+    return self;
+}
+
+@end
+
+
+static BOOL FSQNotificationUserInfosAreEqual(NSDictionary *_Nullable userInfo, NSDictionary *_Nullable otherUserInfo) {
+    return (userInfo == otherUserInfo || [userInfo isEqualToDictionary:(NSDictionary *)otherUserInfo]);
+}
+
+@implementation FSQPrewarmedRouteContentCache {
+    NSLock *_lock;
+    /**
+     Oldest first. The cache is small, so it is searched linearly.
+     */
+    NSMutableArray<FSQPrewarmedRouteContent *> *_contents;
+    NSUInteger _capacity;
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self) {
+        _lock = [NSLock new];
+        _contents = [NSMutableArray new];
+        _capacity = capacity;
+    }
+    return self;
+}
+
+- (NSUInteger)capacity {
+    [_lock lock];
+    NSUInteger capacity = _capacity;
+    [_lock unlock];
+    return capacity;
+}
+
+- (void)setCapacity:(NSUInteger)capacity {
+    [_lock lock];
+    _capacity = capacity;
+    [self trimToCapacity];
+    [_lock unlock];
+}
+
+- (BOOL)hasContentForUrl:(NSURL *)url
+    notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
+              generation:(NSUInteger)generation {
+    [_lock lock];
+    NSUInteger index = [self indexOfContentForUrl:url generation:generation];
+    BOOL hasContent = (index != NSNotFound
+                       && FSQNotificationUserInfosAreEqual(_contents[index].notificationUserInfo, notificationUserInfo));
+    [_lock unlock];
+    
+    return hasContent;
+}
+
+/**
+ Content for the url which was prewarmed with a different userInfo is discarded, since its generator may have used
+ the userInfo.
+ */
+- (nullable FSQPrewarmedRouteContent *)takeContentForUrl:(NSURL *)url
+                                    notificationUserInfo:(nullable NSDictionary *)notificationUserInfo
+                                              generation:(NSUInteger)generation {
+    FSQPrewarmedRouteContent *content = nil;
+    
+    [_lock lock];
+    NSUInteger index = [self indexOfContentForUrl:url generation:generation];
+    if (index != NSNotFound) {
+        content = _contents[index];
+        [_contents removeObjectAtIndex:index];
+    }
+    [_lock unlock];
+    
+    if (content != nil
+        && !FSQNotificationUserInfosAreEqual(content.notificationUserInfo, notificationUserInfo)) {
+        content = nil;
+    }
+    
+    return content;
+}
+
+- (void)addContent:(FSQPrewarmedRouteContent *)content {
+    [_lock lock];
+    
+    NSUInteger index = [self indexOfContentForUrl:content.match.url generation:content.match.routeTableGeneration];
+    if (index != NSNotFound) {
+        [_contents removeObjectAtIndex:index];
+    }
+    
+    [_contents addObject:content];
+    [self trimToCapacity];
+    
+    [_lock unlock];
+}
+
+- (void)removeAllContent {
+    [_lock lock];
+    [_contents removeAllObjects];
+    [_lock unlock];
+}
+
+/**
+ The methods below must be called with the lock held.
+ */
+
+/**
+ Also discards any content prewarmed against an older generation, since the routes it matched may have changed.
+ */
+- (NSUInteger)indexOfContentForUrl:(NSURL *)url generation:(NSUInteger)generation {
+    NSUInteger matchingIndex = NSNotFound;
+    
+    for (NSUInteger index = _contents.count; index > 0; index--) {
+        FSQPrewarmedRouteContent *content = _contents[index - 1];
+        
+        if (content.match.routeTableGeneration < generation) {
+            [_contents removeObjectAtIndex:index - 1];
+            if (matchingIndex != NSNotFound) {
+                matchingIndex--;
+            }
+        }
+        else if (matchingIndex == NSNotFound
+                 && [content.match.url isEqual:url]) {
+            matchingIndex = index - 1;
+        }
+    }
+    
+    return matchingIndex;
+}
+
+- (void)trimToCapacity {
+    while (_contents.count > _capacity) {
+        [_contents removeObjectAtIndex:0];
+    }
 }
 
 @end
@@ -0,0 +1,528 @@
+//
+//  FSQRoutesBenchmarks.m
+//  FSQRoutesTests
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <mach/mach.h>
+#import <mach/mach_time.h>
+#import <pthread.h>
+
+#import "FSQRoutes.h"
+
+/**
+ Matching benchmarks over synthetic route maps of 10, 100, 1,000 and 10,000 routes.
+
+ Each route map cycles through four route shapes (static, `:param`, `*` and `**`) and is matched against three sets
+ of urls: urls which hit a route, urls which miss every route, and long urls which can only be matched by an
+ unlimited wildcard route (the worst case for the matcher). For each set the benchmark logs matches per second,
+ p50 and p99 latency, and the number of heap allocations per match. It also logs how much the process's memory
+ footprint grew when the route map was registered.
+
+ Results can be compared against a saved baseline by setting these environment variables on the test scheme:
+
+ * FSQROUTES_BENCHMARK_BASELINE - Path to a baseline plist. If the file exists, each result is compared against it
+                                  and the test fails if throughput drops or allocations grow past the tolerance.
+ * FSQROUTES_BENCHMARK_RECORD   - If set to 1, results are written to the baseline plist instead of compared.
+ * FSQROUTES_BENCHMARK_TOLERANCE - Allowed throughput regression as a fraction. Defaults to 0.2 (20%).
+
+ Traces recorded in the field with FSQRouteTraceRecorder can be replayed as an extra scenario, so matcher changes
+ are measured against a real distribution of urls:
+
+ * FSQROUTES_BENCHMARK_TRACE        - Path to a trace file.
+ * FSQROUTES_BENCHMARK_TRACE_ROUTES - Path to the route strings of the map the trace was recorded with, one per
+                                      line. The map is registered for every scheme and host in the trace.
+ */
+@interface FSQRoutesBenchmarks : XCTestCase <FSQUrlRouterDelegate>
+@property (nonatomic, strong) FSQUrlRouter *urlRouter;
+@end
+
+/**
+ Number of urls timed for each scenario, after a warm up pass.
+ */
+static const NSUInteger kFSQBenchmarkIterations = 5000;
+
+/**
+ Number of components the unlimited wildcard in worst case urls has to consume.
+ */
+static const NSUInteger kFSQBenchmarkWildcardDepth = 64;
+
+typedef NS_ENUM(NSUInteger, FSQBenchmarkRouteShape) {
+    FSQBenchmarkRouteShapeStatic,
+    FSQBenchmarkRouteShapeParameter,
+    FSQBenchmarkRouteShapeSingleComponentWildcard,
+    FSQBenchmarkRouteShapeUnlimitedComponentWildcard,
+    FSQBenchmarkRouteShapeCount,
+};
+
+#pragma mark - Allocation counting -
+
+/**
+ libmalloc calls this hook (if set) for every allocation and free. It is what malloc stack logging is built on.
+ Only allocations made on the benchmarking thread are counted.
+ */
+typedef void (FSQMallocLogger)(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t numberOfHotFramesToSkip);
+extern FSQMallocLogger *malloc_logger;
+
+static const uint32_t kFSQMallocLogTypeAllocate = 2;
+
+static FSQMallocLogger *previousMallocLogger = NULL;
+static pthread_t countedThread = NULL;
+static uint64_t allocationCount = 0;
+
+static void FSQCountingMallocLogger(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t numberOfHotFramesToSkip) {
+    if ((type & kFSQMallocLogTypeAllocate)
+        && pthread_equal(pthread_self(), countedThread)) {
+        allocationCount++;
+    }
+
+    if (previousMallocLogger != NULL) {
+        previousMallocLogger(type, arg1, arg2, arg3, result, numberOfHotFramesToSkip);
+    }
+}
+
+static void FSQStartCountingAllocations(void) {
+    allocationCount = 0;
+    countedThread = pthread_self();
+    previousMallocLogger = malloc_logger;
+    malloc_logger = FSQCountingMallocLogger;
+}
+
+static uint64_t FSQStopCountingAllocations(void) {
+    malloc_logger = previousMallocLogger;
+    previousMallocLogger = NULL;
+    countedThread = NULL;
+    return allocationCount;
+}
+
+/**
+ The process's physical memory footprint, which is what the system counts against the app's memory limit.
+ */
+static uint64_t FSQMemoryFootprint(void) {
+    task_vm_info_data_t vmInfo;
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+    if (task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&vmInfo, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return vmInfo.phys_footprint;
+}
+
+static int FSQCompareDurations(const void *duration1, const void *duration2) {
+    uint64_t value1 = *(const uint64_t *)duration1;
+    uint64_t value2 = *(const uint64_t *)duration2;
+    return (value1 < value2) ? -1 : ((value1 > value2) ? 1 : 0);
+}
+
+@implementation FSQRoutesBenchmarks
+
+- (void)setUp {
+    [super setUp];
+    self.urlRouter = [[FSQUrlRouter alloc] initWithDelegate:self];
+}
+
+- (void)testBenchmark10Routes {
+    [self runBenchmarksWithNumberOfRoutes:10];
+}
+
+- (void)testBenchmark100Routes {
+    [self runBenchmarksWithNumberOfRoutes:100];
+}
+
+- (void)testBenchmark1000Routes {
+    [self runBenchmarksWithNumberOfRoutes:1000];
+}
+
+- (void)testBenchmark10000Routes {
+    [self runBenchmarksWithNumberOfRoutes:10000];
+}
+
+/**
+ Replays a recorded trace through a router with the route map it was recorded against. Skipped unless
+ FSQROUTES_BENCHMARK_TRACE and FSQROUTES_BENCHMARK_TRACE_ROUTES are set.
+ */
+- (void)testBenchmarkTraceReplay {
+    NSDictionary<NSString *, NSString *> *environment = [NSProcessInfo processInfo].environment;
+    NSString *tracePath = environment[@"FSQROUTES_BENCHMARK_TRACE"];
+    NSString *routesPath = environment[@"FSQROUTES_BENCHMARK_TRACE_ROUTES"];
+
+    if (tracePath.length == 0
+        || routesPath.length == 0) {
+        return;
+    }
+
+    NSError *error = nil;
+    NSArray<FSQRouteTraceRecord *> *records = [FSQRouteTraceRecord recordsFromTraceAtUrl:[NSURL fileURLWithPath:tracePath] error:&error];
+    NSString *routeStrings = [NSString stringWithContentsOfFile:routesPath encoding:NSUTF8StringEncoding error:&error];
+    XCTAssertNotNil(records, @"%@", error);
+    XCTAssertNotNil(routeStrings, @"%@", error);
+    if (records.count == 0
+        || routeStrings == nil) {
+        return;
+    }
+
+    FSQRouteContentGenerator *generator = [FSQRouteContentGenerator new];
+    NSMutableArray<NSArray *> *routeMap = [NSMutableArray new];
+    for (NSString *line in [routeStrings componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]]) {
+        NSString *routeString = [line stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        if (routeString.length > 0) {
+            [routeMap addObject:@[routeString, generator]];
+        }
+    }
+
+    NSMutableSet<NSString *> *schemes = [NSMutableSet new];
+    NSMutableSet<NSString *> *hosts = [NSMutableSet new];
+    for (FSQRouteTraceRecord *record in records) {
+        NSString *scheme = record.url.scheme.lowercaseString;
+        if ([scheme isEqualToString:@"https"]) {
+            if (record.url.host != nil) {
+                [hosts addObject:record.url.host];
+            }
+        }
+        else if (scheme != nil) {
+            [schemes addObject:scheme];
+        }
+    }
+    [self.urlRouter registerNativeSchemes:schemes.allObjects forRouteMap:routeMap];
+    [self.urlRouter registerUniversalLinkHosts:hosts.allObjects forRouteMap:routeMap];
+
+    /**
+     Warm up once, then time the whole trace until at least kFSQBenchmarkIterations urls have been matched.
+     */
+    @autoreleasepool {
+        [self.urlRouter replayTraceRecords:records];
+    }
+
+    NSUInteger numberOfPasses = MAX((NSUInteger)1, (kFSQBenchmarkIterations + records.count - 1) / records.count);
+    NSUInteger numberOfMatches = numberOfPasses * records.count;
+    uint64_t *durations = malloc(numberOfMatches * sizeof(uint64_t));
+    uint64_t totalDuration = 0;
+    NSUInteger numberOfChangedMatches = 0;
+
+    /**
+     Allocations include the metrics object replaying makes for each url, which is the same for every run.
+     */
+    FSQStartCountingAllocations();
+
+    for (NSUInteger pass = 0; pass < numberOfPasses; pass++) {
+        @autoreleasepool {
+            NSArray<FSQRoutingMetrics *> *replayedMetrics = [self.urlRouter replayTraceRecords:records];
+
+            for (NSUInteger recordIndex = 0; recordIndex < records.count; recordIndex++) {
+                FSQRoutingMetrics *metrics = replayedMetrics[recordIndex];
+                uint64_t duration = ([metrics durationOfStage:FSQRoutingStageUrlParsing]
+                                     + [metrics durationOfStage:FSQRoutingStageRouteMapLookup]
+                                     + [metrics durationOfStage:FSQRoutingStagePathMatching]);
+                durations[pass * records.count + recordIndex] = duration;
+                totalDuration += duration;
+
+                /**
+                 Only passes which were matched in the field say anything about which route the url should match.
+                 */
+                FSQRouteTraceRecord *record = records[recordIndex];
+                if (pass == 0
+                    && (record.routeIndex != NSNotFound || record.outcome == FSQRoutingOutcomeFailedToMatch)
+                    && metrics.routeIndex != record.routeIndex) {
+                    numberOfChangedMatches++;
+                }
+            }
+        }
+    }
+
+    uint64_t numberOfAllocations = FSQStopCountingAllocations();
+
+    qsort(durations, numberOfMatches, sizeof(uint64_t), FSQCompareDurations);
+
+    double p50Microseconds = durations[numberOfMatches / 2] / 1000.0;
+    double p99Microseconds = durations[MIN(numberOfMatches - 1, (numberOfMatches * 99) / 100)] / 1000.0;
+    double totalSeconds = (double)totalDuration / NSEC_PER_SEC;
+
+    free(durations);
+
+    NSDictionary<NSString *, NSNumber *> *result = @{@"matchesPerSecond" : @(numberOfMatches / MAX(totalSeconds, DBL_MIN)),
+                                                     @"p50Microseconds" : @(p50Microseconds),
+                                                     @"p99Microseconds" : @(p99Microseconds),
+                                                     @"allocationsPerMatch" : @((double)numberOfAllocations / numberOfMatches)};
+
+    NSLog(@"[FSQRoutesBenchmarks] %-14@ %10.0f matches/sec  p50 %8.2fus  p99 %8.2fus  %6.1f allocations/match  (%lu urls)",
+          @"trace",
+          result[@"matchesPerSecond"].doubleValue,
+          result[@"p50Microseconds"].doubleValue,
+          result[@"p99Microseconds"].doubleValue,
+          result[@"allocationsPerMatch"].doubleValue,
+          (unsigned long)records.count);
+
+    XCTAssertEqual(numberOfChangedMatches, (NSUInteger)0, @"Urls in the trace matched different routes than when they were recorded");
+    [self compareResult:result named:@"trace"];
+}
+
+#pragma mark - Synthetic route maps -
+
+/**
+ Routes are grouped into sections of eight so that the trie has some fan out at every level, and the routes in a
+ section share prefixes the way real route maps do.
+ */
+- (NSString *)routeStringAtIndex:(NSUInteger)routeIndex {
+    NSUInteger section = routeIndex / 8;
+
+    switch ((FSQBenchmarkRouteShape)(routeIndex % FSQBenchmarkRouteShapeCount)) {
+        case FSQBenchmarkRouteShapeStatic:
+            return [NSString stringWithFormat:@"/section%lu/static/leaf%lu", (unsigned long)section, (unsigned long)routeIndex];
+        case FSQBenchmarkRouteShapeParameter:
+            return [NSString stringWithFormat:@"/section%lu/:itemId/detail%lu", (unsigned long)section, (unsigned long)routeIndex];
+        case FSQBenchmarkRouteShapeSingleComponentWildcard:
+            return [NSString stringWithFormat:@"/section%lu/*/item%lu", (unsigned long)section, (unsigned long)routeIndex];
+        case FSQBenchmarkRouteShapeUnlimitedComponentWildcard:
+        case FSQBenchmarkRouteShapeCount:
+            return [NSString stringWithFormat:@"/section%lu/**/tail%lu", (unsigned long)section, (unsigned long)routeIndex];
+    }
+}
+
+- (NSURL *)hitUrlForRouteAtIndex:(NSUInteger)routeIndex {
+    NSUInteger section = routeIndex / 8;
+    NSString *path = nil;
+
+    switch ((FSQBenchmarkRouteShape)(routeIndex % FSQBenchmarkRouteShapeCount)) {
+        case FSQBenchmarkRouteShapeStatic:
+            path = [NSString stringWithFormat:@"section%lu/static/leaf%lu", (unsigned long)section, (unsigned long)routeIndex];
+            break;
+        case FSQBenchmarkRouteShapeParameter:
+            path = [NSString stringWithFormat:@"section%lu/%lu/detail%lu", (unsigned long)section, (unsigned long)(routeIndex * 7919), (unsigned long)routeIndex];
+            break;
+        case FSQBenchmarkRouteShapeSingleComponentWildcard:
+            path = [NSString stringWithFormat:@"section%lu/anything/item%lu", (unsigned long)section, (unsigned long)routeIndex];
+            break;
+        case FSQBenchmarkRouteShapeUnlimitedComponentWildcard:
+        case FSQBenchmarkRouteShapeCount:
+            path = [NSString stringWithFormat:@"section%lu/a/b/c/tail%lu", (unsigned long)section, (unsigned long)routeIndex];
+            break;
+    }
+
+    return [NSURL URLWithString:[NSString stringWithFormat:@"bench://%@?ref=benchmark", path]];
+}
+
+- (NSURL *)missUrlForRouteAtIndex:(NSUInteger)routeIndex {
+    return [NSURL URLWithString:[NSString stringWithFormat:@"bench://section%lu/static/missing%lu?ref=benchmark",
+                                 (unsigned long)(routeIndex / 8), (unsigned long)routeIndex]];
+}
+
+- (NSURL *)worstCaseWildcardUrlForRouteAtIndex:(NSUInteger)unlimitedWildcardRouteIndex {
+    NSMutableArray<NSString *> *components = [NSMutableArray new];
+    [components addObject:[NSString stringWithFormat:@"section%lu", (unsigned long)(unlimitedWildcardRouteIndex / 8)]];
+    for (NSUInteger i = 0; i < kFSQBenchmarkWildcardDepth; i++) {
+        [components addObject:@"static"];
+    }
+    [components addObject:[NSString stringWithFormat:@"tail%lu", (unsigned long)unlimitedWildcardRouteIndex]];
+
+    return [NSURL URLWithString:[@"bench://" stringByAppendingString:[components componentsJoinedByString:@"/"]]];
+}
+
+#pragma mark - Running benchmarks -
+
+- (void)runBenchmarksWithNumberOfRoutes:(NSUInteger)numberOfRoutes {
+    FSQRouteContentGenerator *generator = [FSQRouteContentGenerator new];
+    NSMutableArray<NSArray *> *routeMap = [NSMutableArray arrayWithCapacity:numberOfRoutes];
+    NSMutableArray<NSURL *> *hitUrls = [NSMutableArray arrayWithCapacity:numberOfRoutes];
+    NSMutableArray<NSURL *> *missUrls = [NSMutableArray arrayWithCapacity:numberOfRoutes];
+    NSMutableArray<NSURL *> *worstCaseUrls = [NSMutableArray new];
+
+    for (NSUInteger routeIndex = 0; routeIndex < numberOfRoutes; routeIndex++) {
+        [routeMap addObject:@[[self routeStringAtIndex:routeIndex], generator]];
+        [hitUrls addObject:[self hitUrlForRouteAtIndex:routeIndex]];
+        [missUrls addObject:[self missUrlForRouteAtIndex:routeIndex]];
+
+        if ((routeIndex % FSQBenchmarkRouteShapeCount) == FSQBenchmarkRouteShapeUnlimitedComponentWildcard) {
+            [worstCaseUrls addObject:[self worstCaseWildcardUrlForRouteAtIndex:routeIndex]];
+        }
+    }
+
+    uint64_t footprintBeforeRegistration = FSQMemoryFootprint();
+    [self.urlRouter registerNativeSchemes:@[@"bench"] forRouteMap:routeMap];
+    uint64_t footprintAfterRegistration = FSQMemoryFootprint();
+
+    /**
+     The footprint only moves in whole pages and includes anything else the process allocated meanwhile, so this
+     is logged for comparison between runs but not checked against the baseline.
+     */
+    NSLog(@"[FSQRoutesBenchmarks] %lu routes registered, footprint grew %.1f KB",
+          (unsigned long)numberOfRoutes,
+          (footprintAfterRegistration > footprintBeforeRegistration ? footprintAfterRegistration - footprintBeforeRegistration : 0) / 1024.0);
+
+    /**
+     Check the synthetic urls match the way the scenarios assume before timing anything.
+     */
+    NSArray<FSQRouteMatch *> *hitMatches = [self.urlRouter matchUrls:hitUrls];
+    for (NSUInteger routeIndex = 0; routeIndex < numberOfRoutes; routeIndex++) {
+        XCTAssertEqual(hitMatches[routeIndex].routeIndex, routeIndex, @"%@", hitUrls[routeIndex]);
+    }
+    for (FSQRouteMatch *match in [self.urlRouter matchUrls:missUrls]) {
+        XCTAssertFalse(match.matched, @"%@", match.url);
+    }
+    for (FSQRouteMatch *match in [self.urlRouter matchUrls:worstCaseUrls]) {
+        XCTAssertTrue(match.matched, @"%@", match.url);
+    }
+
+    NSDictionary<NSString *, NSArray<NSURL *> *> *scenarios = @{@"hit" : hitUrls,
+                                                               @"miss" : missUrls,
+                                                               @"wildcard" : worstCaseUrls};
+
+    for (NSString *scenario in @[@"hit", @"miss", @"wildcard"]) {
+        NSDictionary<NSString *, NSNumber *> *result = [self measureMatchingUrls:scenarios[scenario]];
+        NSString *resultName = [NSString stringWithFormat:@"%@-%lu", scenario, (unsigned long)numberOfRoutes];
+
+        NSLog(@"[FSQRoutesBenchmarks] %-14@ %10.0f matches/sec  p50 %8.2fus  p99 %8.2fus  %6.1f allocations/match",
+              resultName,
+              result[@"matchesPerSecond"].doubleValue,
+              result[@"p50Microseconds"].doubleValue,
+              result[@"p99Microseconds"].doubleValue,
+              result[@"allocationsPerMatch"].doubleValue);
+
+        [self compareResult:result named:resultName];
+    }
+}
+
+/**
+ Matches urls one at a time (cycling through the array until kFSQBenchmarkIterations matches have been made) and
+ returns the throughput, latency percentiles and allocations per match.
+ */
+- (NSDictionary<NSString *, NSNumber *> *)measureMatchingUrls:(NSArray<NSURL *> *)urls {
+    /**
+     The single url arrays passed to the router are built up front so they aren't counted as part of matching.
+     */
+    NSMutableArray<NSArray<NSURL *> *> *urlArrays = [NSMutableArray arrayWithCapacity:urls.count];
+    for (NSURL *url in urls) {
+        [urlArrays addObject:@[url]];
+    }
+
+    for (NSUInteger i = 0; i < MIN(urlArrays.count, (NSUInteger)500); i++) {
+        @autoreleasepool {
+            [self.urlRouter matchUrls:urlArrays[i]];
+        }
+    }
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+
+    uint64_t *durations = malloc(kFSQBenchmarkIterations * sizeof(uint64_t));
+    uint64_t totalDuration = 0;
+
+    FSQStartCountingAllocations();
+
+    for (NSUInteger i = 0; i < kFSQBenchmarkIterations; i++) {
+        NSArray<NSURL *> *urlArray = urlArrays[i % urlArrays.count];
+
+        @autoreleasepool {
+            uint64_t startTime = mach_absolute_time();
+            [self.urlRouter matchUrls:urlArray];
+            uint64_t duration = mach_absolute_time() - startTime;
+
+            durations[i] = duration;
+            totalDuration += duration;
+        }
+    }
+
+    uint64_t numberOfAllocations = FSQStopCountingAllocations();
+
+    qsort(durations, kFSQBenchmarkIterations, sizeof(uint64_t), FSQCompareDurations);
+
+    double nanosecondsPerTick = (double)timebase.numer / (double)timebase.denom;
+    double p50Microseconds = durations[kFSQBenchmarkIterations / 2] * nanosecondsPerTick / 1000.0;
+    double p99Microseconds = durations[MIN(kFSQBenchmarkIterations - 1, (kFSQBenchmarkIterations * 99) / 100)] * nanosecondsPerTick / 1000.0;
+    double totalSeconds = totalDuration * nanosecondsPerTick / NSEC_PER_SEC;
+
+    free(durations);
+
+    return @{@"matchesPerSecond" : @(kFSQBenchmarkIterations / MAX(totalSeconds, DBL_MIN)),
+             @"p50Microseconds" : @(p50Microseconds),
+             @"p99Microseconds" : @(p99Microseconds),
+             @"allocationsPerMatch" : @((double)numberOfAllocations / kFSQBenchmarkIterations)};
+}
+
+#pragma mark - Baselines -
+
+- (void)compareResult:(NSDictionary<NSString *, NSNumber *> *)result named:(NSString *)resultName {
+    NSDictionary<NSString *, NSString *> *environment = [NSProcessInfo processInfo].environment;
+    NSString *baselinePath = environment[@"FSQROUTES_BENCHMARK_BASELINE"];
+
+    if (baselinePath.length == 0) {
+        return;
+    }
+
+    NSDictionary<NSString *, NSDictionary<NSString *, NSNumber *> *> *baseline = [NSDictionary dictionaryWithContentsOfFile:baselinePath];
+
+    if ([environment[@"FSQROUTES_BENCHMARK_RECORD"] isEqualToString:@"1"]) {
+        NSMutableDictionary *updatedBaseline = [baseline mutableCopy] ?: [NSMutableDictionary new];
+        updatedBaseline[resultName] = result;
+        XCTAssertTrue([updatedBaseline writeToFile:baselinePath atomically:YES], @"Could not write baseline to %@", baselinePath);
+        return;
+    }
+
+    NSDictionary<NSString *, NSNumber *> *baselineResult = baseline[resultName];
+    if (baselineResult == nil) {
+        return;
+    }
+
+    double tolerance = 0.2;
+    if (environment[@"FSQROUTES_BENCHMARK_TOLERANCE"] != nil) {
+        tolerance = environment[@"FSQROUTES_BENCHMARK_TOLERANCE"].doubleValue;
+    }
+
+    double baselineMatchesPerSecond = baselineResult[@"matchesPerSecond"].doubleValue;
+    XCTAssertGreaterThanOrEqual(result[@"matchesPerSecond"].doubleValue, baselineMatchesPerSecond * (1.0 - tolerance),
+                                @"%@ throughput regressed (baseline %.0f matches/sec)", resultName, baselineMatchesPerSecond);
+
+    /**
+     Allocation counts are deterministic, so they are allowed half an allocation per match of slack for rounding
+     rather than a percentage.
+     */
+    double baselineAllocationsPerMatch = baselineResult[@"allocationsPerMatch"].doubleValue;
+    XCTAssertLessThanOrEqual(result[@"allocationsPerMatch"].doubleValue, baselineAllocationsPerMatch + 0.5,
+                             @"%@ allocates more per match (baseline %.1f)", resultName, baselineAllocationsPerMatch);
+}
+
+#pragma mark - FSQUrlRouterDelegate -
+
+/**
+ Mandatory delegate callbacks that the benchmarks don't use
+ */
+
+- (FSQUrlRoutingControl)urlRouter:(FSQUrlRouter *)urlRouter
+       shouldGenerateRouteContent:(FSQRouteContentGenerator *)routeContentGenerator
+                      withUrlData:(FSQRouteUrlData *)urlData {
+    return FSQUrlRouterAllowRouting;
+}
+
+- (FSQUrlRoutingControl)urlRouter:(FSQUrlRouter *)urlRouter
+               shouldPresentRoute:(FSQRouteContent *)routeContent {
+    return FSQUrlRouterAllowRouting;
+}
+
+- (UIViewController *)urlRouter:(FSQUrlRouter *)urlRouter viewControllerToPresentRoutedUrlFrom:(FSQRouteContent *)routeContent {
+    return nil;
+}
+
+- (void)urlRouter:(FSQUrlRouter *)urlRouter
+routedUrlWillBePresented:(FSQRouteContent *)routeContent
+completionHandler:(void (^)())completionHandler {
+    completionHandler();
+}
+
+- (void)urlRouter:(FSQUrlRouter *)urlRouter routedUrlDidGetPresented:(FSQRouteContent *)routeContent {
+
+}
+
+- (void)urlRouter:(FSQUrlRouter *)urlRouter
+ failedToRouteUrl:(NSURL *)url
+notificationUserInfo:(nullable NSDictionary *)notificationUserInfo {
+
+}
+
+- (void)urlRouter:(FSQUrlRouter *)urlRouter
+failedToGenerateContent:(FSQRouteContentGenerator *)routeContentGenerator
+          urlData:(FSQRouteUrlData *)urlData {
+
+}
+
+@end
@@ -8,14 +8,48 @@
 
 #import <XCTest/XCTest.h>
 
+#include <errno.h>
+
 #import "FSQRoutes.h"
 
-@interface FSQRoutesTests : XCTestCase <FSQUrlRouterDelegate>
+@interface FSQRoutesTests : XCTestCase <FSQUrlRouterDelegate, FSQRoutingMetricsObserver>
 @property (nonatomic, strong) FSQUrlRouter *urlRouter;
+@property (nonatomic, strong) NSMutableArray<NSNumber *> *endedRoutingStages;
+@property (nonatomic, strong) FSQRoutingMetrics *finishedRoutingMetrics;
+@property (nonatomic, strong) XCTestExpectation *routingMetricsExpectation;
+@property (nonatomic, strong) NSMutableArray<NSURL *> *finishedRoutingUrls;
+@property (atomic, assign) BOOL delegateWasCalledOffMainQueue;
+@end
+
+@interface FSQReusableTestViewController : UIViewController <FSQRouteContentViewControllerProtocol>
+@property (nonatomic, strong) FSQRouteUrlData *urlData;
+@property (nonatomic, assign) NSUInteger numberOfReuses;
+@end
+
+@implementation FSQReusableTestViewController
+
++ (UIViewController *)viewControllerForFSQRouteUrlData:(FSQRouteUrlData *)urlData {
+    FSQReusableTestViewController *viewController = [self new];
+    viewController.urlData = urlData;
+    return viewController;
+}
+
+- (void)prepareForReuseWithFSQRouteUrlData:(FSQRouteUrlData *)urlData {
+    self.urlData = urlData;
+    self.numberOfReuses++;
+}
+
 @end
 
 @interface FSQUrlRouter (SecretTestMethods)
 - (NSDictionary<NSString *, NSString *> *)parametersForUrlString:(NSString *)urlString matchingAgainstRoute:(NSString *)routeString;
+- (NSInteger)indexOfRouteMatchingUrlString:(NSString *)urlString inRouteStrings:(NSArray<NSString *> *)routeStrings;
+- (NSArray<NSArray *> *)tokenizedRouteMapForRouteStrings:(NSArray<NSString *> *)routeStrings;
+- (NSUInteger)numberOfRoutesInTokenizedRouteMap:(NSArray<NSArray *> *)tokenizedRouteMap matchingUrlString:(NSString *)urlString;
+- (NSUInteger)numberOfRoutesInTokenizedRouteMap:(NSArray<NSArray *> *)tokenizedRouteMap
+                              matchingUrlString:(NSString *)urlString
+                             parsingUrlPerRoute:(BOOL)parsingUrlPerRoute;
+- (NSUInteger)numberOfInternedRouteStrings;
 @end
 
 #define TEST_URLS_MATCH(testName, urlString, routeString) \
@@ -40,6 +74,12 @@ for (NSString *validateKey in validationDict) { \
 } \
 }\
 
+#define TEST_URL_MATCHES_ROUTE_AT_INDEX(testName, urlString, routeStrings, expectedIndex) \
+- (void)test##testName { \
+XCTAssertEqual([self.urlRouter indexOfRouteMatchingUrlString:urlString inRouteStrings:routeStrings], (NSInteger)expectedIndex, \
+@"Match %@ against route map %@", urlString, routeStrings); \
+}
+
 
 @implementation FSQRoutesTests
 
@@ -89,6 +129,1244 @@ TEST_URLS_MATCH_AND_PARAMS_MATCH(UnlimitedWildcardMatch11, @"test://c/a/a/b", @"
 TEST_URLS_MATCH_AND_PARAMS_MATCH(UnlimitedWildcardMatch12, @"test://d/c/a/b/a/b", @"/**/:param/a/b/**", @{@"param" : @"c"});
 TEST_URLS_MATCH_AND_PARAMS_MATCH(UnlimitedWildcardMatch14, @"test://a/b/c/d", @"/**/:param", @{@"param" : @"d"});
 TEST_URLS_MATCH_AND_PARAMS_MATCH(UnlimitedWildcardMatch15, @"test://a", @"/**/:param", @{@"param" : @"a"});
+TEST_URLS_MATCH_AND_PARAMS_MATCH(UnlimitedWildcardMatch16, @"test://c/a/d/a/b", @"/**/:param/a/b/**", @{@"param" : @"d"});
+TEST_URLS_MATCH_AND_PARAMS_MATCH(UnlimitedWildcardMatch17, @"test://a/b/c/d/e", @"/**/b/*/:param/**", @{@"param" : @"d"});
+TEST_URLS_DONT_MATCH(UnlimitedWildcardMatch18, @"test://a/b/a/b", @"/**/a/**/c/**")
+
+TEST_URL_MATCHES_ROUTE_AT_INDEX(RouteMapPrecedence1, @"test://foo/bar", (@[@"/foo/:param", @"/foo/bar"]), 0)
+TEST_URL_MATCHES_ROUTE_AT_INDEX(RouteMapPrecedence2, @"test://foo/bar", (@[@"/foo/bar", @"/foo/:param"]), 0)
+TEST_URL_MATCHES_ROUTE_AT_INDEX(RouteMapPrecedence3, @"test://foo/bar", (@[@"/baz", @"/**/bar", @"/foo/bar"]), 1)
+TEST_URL_MATCHES_ROUTE_AT_INDEX(RouteMapPrecedence4, @"test://a/b/c", (@[@"/a/*", @"/a/**/c", @"/a/b/c"]), 1)
+TEST_URL_MATCHES_ROUTE_AT_INDEX(RouteMapPrecedence5, @"test://a/b/c", (@[@"/a/*/d", @"/*/b/*", @"/a/**"]), 1)
+TEST_URL_MATCHES_ROUTE_AT_INDEX(RouteMapPrecedence6, @"test://foo", (@[@"/bar", @"/foo/*"]), NSNotFound)
+TEST_URL_MATCHES_ROUTE_AT_INDEX(RouteMapPrecedence7, @"test://", (@[@"/"]), NSNotFound)
+TEST_URL_MATCHES_ROUTE_AT_INDEX(RouteMapPrecedence8, @"test://?param=a", (@[@"/a", @"/"]), 1)
+
+/**
+ Capture ranges for routes with many tokens don't fit in the matcher's stack buffer.
+ */
+- (void)testMatchingRouteWithManyTokens {
+    NSMutableArray<NSString *> *routeComponents = [NSMutableArray new];
+    NSMutableArray<NSString *> *urlComponents = [NSMutableArray new];
+    for (NSInteger i = 0; i < 40; i++) {
+        [routeComponents addObject:((i % 10 == 9) ? [NSString stringWithFormat:@":param%ld", (long)i] : @"*")];
+        [urlComponents addObject:[NSString stringWithFormat:@"c%ld", (long)i]];
+    }
+    NSString *routeString = [@"/**/" stringByAppendingString:[routeComponents componentsJoinedByString:@"/"]];
+    NSString *urlString = [@"test://a/b/" stringByAppendingString:[urlComponents componentsJoinedByString:@"/"]];
+    
+    NSDictionary *expectedParameters = @{@"param9" : @"c9", @"param19" : @"c19", @"param29" : @"c29", @"param39" : @"c39"};
+    XCTAssertEqualObjects([self.urlRouter parametersForUrlString:urlString matchingAgainstRoute:routeString], expectedParameters);
+    
+    FSQRouteContentGenerator *generator = [FSQRouteContentGenerator new];
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:@[@[@"/a/b", generator], @[routeString, generator]]];
+    FSQRouteMatch *match = [[self.urlRouter matchUrls:@[[NSURL URLWithString:urlString]]] firstObject];
+    XCTAssertEqual(match.routeIndex, (NSUInteger)1);
+    XCTAssertEqualObjects(match.urlData.parameters, expectedParameters);
+}
+
+- (void)testBatchMatching {
+    FSQRouteContentGenerator *generator = [FSQRouteContentGenerator new];
+    [self.urlRouter registerNativeSchemes:@[@"test"] 
+                              forRouteMap:@[@[@"/venues/:venueId", generator],
+                                            @[@"/users/:userId/**", generator]]];
+    
+    NSArray<NSURL *> *urls = @[[NSURL URLWithString:@"test://users/1/lists?ref=push"],
+                               [NSURL URLWithString:@"test://nothing/here"],
+                               [NSURL URLWithString:@"test://venues/2"],
+                               [NSURL URLWithString:@"other://venues/2"],
+                               [NSURL URLWithString:@"test://users/1/lists?ref=push"]];
+    
+    for (NSNumber *concurrently in @[@NO, @YES]) {
+        NSArray<FSQRouteMatch *> *matches = [self.urlRouter matchUrls:urls concurrently:concurrently.boolValue];
+        XCTAssertEqual(matches.count, urls.count);
+        
+        XCTAssertTrue(matches[0].matched);
+        XCTAssertEqual(matches[0].routeIndex, (NSUInteger)1);
+        XCTAssertEqualObjects(matches[0].urlData.parameters, (@{@"userId" : @"1", @"ref" : @"push"}));
+        
+        XCTAssertFalse(matches[1].matched);
+        XCTAssertEqual(matches[1].routeIndex, (NSUInteger)NSNotFound);
+        
+        XCTAssertTrue(matches[2].matched);
+        XCTAssertEqual(matches[2].routeIndex, (NSUInteger)0);
+        XCTAssertEqualObjects(matches[2].urlData.parameters[@"venueId"], @"2");
+        
+        XCTAssertFalse(matches[3].matched);
+        
+        XCTAssertTrue(matches[4].matched);
+        XCTAssertEqual(matches[4].routeIndex, (NSUInteger)1);
+        XCTAssertEqualObjects(matches[4].urlData.parameters, matches[0].urlData.parameters);
+        XCTAssertNotEqual(matches[4].urlData, matches[0].urlData);
+    }
+}
+
+- (void)testConcurrentMatchingDuringRegistration {
+    FSQRouteContentGenerator *generator = [[FSQRouteContentGenerator alloc] initWithBlock:^FSQRouteContent *(FSQRouteUrlData *urlData) {
+        return [[FSQRouteContent alloc] initWithViewControllerClass:[UIViewController class]];
+    }];
+    NSArray<NSArray *> *routeMap1 = @[@[@"/venues/:venueId", generator], @[@"/users/:userId", generator]];
+    NSArray<NSArray *> *routeMap2 = @[@[@"/users/:userId", generator], @[@"/venues/:venueId/**", generator]];
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:routeMap1];
+    
+    NSURL *url = [NSURL URLWithString:@"test://venues/123"];
+    NSLock *failureLock = [NSLock new];
+    __block NSInteger numberOfFailures = 0;
+    
+    dispatch_group_t registrationGroup = dispatch_group_create();
+    dispatch_queue_t registrationQueue = dispatch_queue_create("com.foursquare.FSQRoutesTests.registration", DISPATCH_QUEUE_SERIAL);
+    dispatch_group_async(registrationGroup, registrationQueue, ^{
+        for (NSInteger i = 0; i < 2000; i++) {
+            [self.urlRouter registerNativeSchemes:@[@"test", @"test2"] forRouteMap:((i % 2) ? routeMap1 : routeMap2)];
+            [self.urlRouter registerUniversalLinkHosts:@[@"example.com"] forRouteMap:((i % 2) ? routeMap2 : routeMap1)];
+        }
+    });
+    
+    dispatch_apply(16, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t iteration) {
+        for (NSInteger i = 0; i < 500; i++) {
+            FSQRouteMatch *match = [[self.urlRouter matchUrls:@[url]] firstObject];
+            FSQRouteContent *content = [self.urlRouter generateRouteContentFromUrl:url];
+            
+            if (!match.matched
+                || ![match.urlData.parameters[@"venueId"] isEqualToString:@"123"]
+                || ![content.urlData.parameters[@"venueId"] isEqualToString:@"123"]) {
+                [failureLock lock];
+                numberOfFailures++;
+                [failureLock unlock];
+            }
+        }
+    });
+    
+    dispatch_group_wait(registrationGroup, DISPATCH_TIME_FOREVER);
+    XCTAssertEqual(numberOfFailures, 0);
+}
+
+- (void)testIndividualRouteUpdates {
+    FSQRouteContentGenerator *generator1 = [FSQRouteContentGenerator new];
+    FSQRouteContentGenerator *generator2 = [FSQRouteContentGenerator new];
+    NSURL *venueUrl = [NSURL URLWithString:@"test://venues/123"];
+    NSURL *userUrl = [NSURL URLWithString:@"test2://users/456"];
+
+    XCTAssertEqual(self.urlRouter.routeTableGeneration, (NSUInteger)0);
+
+    [self.urlRouter registerNativeSchemes:@[@"test", @"test2"]
+                              forRouteMap:@[@[@"/venues/:venueId/**", generator1],
+                                            @[@"/venues/:venueId", generator1]]];
+    XCTAssertEqual(self.urlRouter.routeTableGeneration, (NSUInteger)1);
+    XCTAssertFalse([[self.urlRouter matchUrls:@[userUrl]] firstObject].matched);
+
+    [self.urlRouter addRoute:@"/users/:userId" generator:generator2 forNativeSchemes:@[@"test", @"test2"]];
+    FSQRouteMatch *userMatch = [[self.urlRouter matchUrls:@[userUrl]] firstObject];
+    XCTAssertEqual(userMatch.routeIndex, (NSUInteger)2);
+    XCTAssertEqual(userMatch.contentGenerator, generator2);
+    XCTAssertEqual(userMatch.routeTableGeneration, (NSUInteger)2);
+
+    XCTAssertEqual([[self.urlRouter matchUrls:@[venueUrl]] firstObject].routeIndex, (NSUInteger)0);
+    XCTAssertTrue([self.urlRouter removeRoute:@"/venues/:venueId/**" forNativeSchemes:@[@"test", @"test2"]]);
+    XCTAssertEqual([[self.urlRouter matchUrls:@[venueUrl]] firstObject].routeIndex, (NSUInteger)1);
+    XCTAssertEqual([[self.urlRouter matchUrls:@[userUrl]] firstObject].routeIndex, (NSUInteger)2);
+    XCTAssertEqual(self.urlRouter.routeTableGeneration, (NSUInteger)3);
+
+    XCTAssertFalse([self.urlRouter removeRoute:@"/venues/:venueId/**" forNativeSchemes:@[@"test"]]);
+    XCTAssertFalse([self.urlRouter removeRoute:@"/venues/:otherName" forNativeSchemes:@[@"test"]]);
+    XCTAssertEqual(self.urlRouter.routeTableGeneration, (NSUInteger)3);
+
+    XCTAssertTrue([self.urlRouter replaceGeneratorForRoute:@"/venues/:venueId" withGenerator:generator2 forNativeSchemes:@[@"test"]]);
+    FSQRouteMatch *venueMatch = [[self.urlRouter matchUrls:@[venueUrl]] firstObject];
+    XCTAssertEqual(venueMatch.contentGenerator, generator2);
+    XCTAssertEqual(venueMatch.routeIndex, (NSUInteger)1);
+    XCTAssertEqual([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test2://venues/123"]]] firstObject].contentGenerator, generator1);
+
+    [self.urlRouter addRoute:@"/new" generator:generator1 forUniversalLinkHosts:@[@"example.com"]];
+    XCTAssertTrue([self.urlRouter urlSchemeOrDomainIsRegistered:[NSURL URLWithString:@"https://example.com/new"]]);
+    XCTAssertEqual([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"https://example.com/new"]]] firstObject].routeIndex, (NSUInteger)0);
+}
+
+- (void)testCompiledRouteMaps {
+    NSArray<NSString *> *routeStrings = @[@"/venues/:venueId/**", @"/venues/:venueId", @"/users/%3Aself", @"/*/:name", @"/"];
+    NSMutableArray<FSQRouteContentGenerator *> *generators = [NSMutableArray new];
+    NSMutableArray<NSArray *> *routeMap = [NSMutableArray new];
+    for (NSString *routeString in routeStrings) {
+        FSQRouteContentGenerator *generator = [FSQRouteContentGenerator new];
+        [generators addObject:generator];
+        [routeMap addObject:@[routeString, generator]];
+    }
+
+    NSURL *fileUrl = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]]];
+    XCTAssertTrue([[FSQUrlRouter compiledRouteMapDataWithRouteStrings:routeStrings] writeToURL:fileUrl atomically:YES]);
+
+    NSError *error = nil;
+    XCTAssertTrue([self.urlRouter registerNativeSchemes:@[@"compiled"] forCompiledRouteMapAtUrl:fileUrl generators:generators error:&error]);
+    XCTAssertNil(error);
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:routeMap];
+
+    for (NSString *urlPath in @[@"venues/1", @"venues/1/photos", @"users/:self", @"users/2", @"?param=a", @"", @"a/b/c"]) {
+        FSQRouteMatch *compiledMatch = [[self.urlRouter matchUrls:@[[NSURL URLWithString:[@"compiled://" stringByAppendingString:urlPath]]]] firstObject];
+        FSQRouteMatch *match = [[self.urlRouter matchUrls:@[[NSURL URLWithString:[@"test://" stringByAppendingString:urlPath]]]] firstObject];
+        XCTAssertEqual(compiledMatch.matched, match.matched, @"%@", urlPath);
+        XCTAssertEqual(compiledMatch.routeIndex, match.routeIndex, @"%@", urlPath);
+        XCTAssertEqual(compiledMatch.contentGenerator, match.contentGenerator, @"%@", urlPath);
+        XCTAssertEqualObjects(compiledMatch.urlData.parameters, match.urlData.parameters, @"%@", urlPath);
+    }
+
+    /**
+     Compiled maps can be updated like any other map.
+     */
+    [self.urlRouter addRoute:@"/new" generator:generators[0] forNativeSchemes:@[@"compiled"]];
+    XCTAssertEqual([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"compiled://new"]]] firstObject].routeIndex, (NSUInteger)5);
+
+    XCTAssertFalse([self.urlRouter registerNativeSchemes:@[@"compiled"] forCompiledRouteMapAtUrl:fileUrl generators:@[generators[0]] error:&error]);
+    XCTAssertEqualObjects(error.domain, FSQUrlRouterErrorDomain);
+    XCTAssertEqual(error.code, FSQUrlRouterErrorCodeGeneratorCountMismatch);
+
+    NSMutableData *truncatedData = [[NSData dataWithContentsOfURL:fileUrl] mutableCopy];
+    truncatedData.length -= 1;
+    XCTAssertTrue([truncatedData writeToURL:fileUrl atomically:YES]);
+    error = nil;
+    XCTAssertFalse([self.urlRouter registerUniversalLinkHosts:@[@"example.com"] forCompiledRouteMapAtUrl:fileUrl generators:generators error:&error]);
+    XCTAssertEqual(error.code, FSQUrlRouterErrorCodeInvalidCompiledRouteMap);
+    XCTAssertFalse([self.urlRouter urlSchemeOrDomainIsRegistered:[NSURL URLWithString:@"https://example.com/"]]);
+
+    [[NSFileManager defaultManager] removeItemAtURL:fileUrl error:nil];
+}
+
+/**
+ Strings from compiled route map data are only interned when the map's trie is built, which has to happen before
+ the first url's components are looked up.
+ */
+- (void)testCompiledRouteMapStringsOnlyInData {
+    NSString *uniqueString = [[NSUUID UUID] UUIDString];
+    NSArray<NSString *> *routeStrings = @[[NSString stringWithFormat:@"/%@/:id", uniqueString], @"/*/:name"];
+    NSData *data = [FSQUrlRouter compiledRouteMapDataWithRouteStrings:routeStrings];
+    NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"compiled://%@/1", uniqueString]];
+
+    FSQRouteMatcher *matcher = [[FSQRouteMatcher alloc] initWithCompiledRouteMapData:data error:NULL];
+    XCTAssertEqual([matcher indexOfRouteMatchingUrl:url parameters:NULL], (NSUInteger)0);
+
+    NSString *otherUniqueString = [[NSUUID UUID] UUIDString];
+    NSURL *fileUrl = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]]];
+    XCTAssertTrue([[FSQUrlRouter compiledRouteMapDataWithRouteStrings:@[[NSString stringWithFormat:@"/%@", otherUniqueString]]]
+                   writeToURL:fileUrl atomically:YES]);
+    XCTAssertTrue([self.urlRouter registerNativeSchemes:@[@"compiled"]
+                               forCompiledRouteMapAtUrl:fileUrl
+                                             generators:@[[FSQRouteContentGenerator new]]
+                                                  error:NULL]);
+
+    NSURL *otherUrl = [NSURL URLWithString:[NSString stringWithFormat:@"compiled://%@", otherUniqueString]];
+    XCTAssertEqual([[self.urlRouter matchUrls:@[otherUrl]] firstObject].routeIndex, (NSUInteger)0);
+
+    [[NSFileManager defaultManager] removeItemAtURL:fileUrl error:nil];
+}
+
+- (void)testCompiledRouteMapEmptyRouteStringsNeverMatch {
+    NSData *data = [FSQUrlRouter compiledRouteMapDataWithRouteStrings:@[@"", @"/venues/:venueId", @""]];
+    NSError *error = nil;
+    FSQRouteMatcher *matcher = [[FSQRouteMatcher alloc] initWithCompiledRouteMapData:data error:&error];
+    XCTAssertNotNil(matcher, @"%@", error);
+    XCTAssertEqual(matcher.numberOfRoutes, (NSUInteger)3);
+
+    XCTAssertEqual([matcher indexOfRouteMatchingUrl:[NSURL URLWithString:@"test://venues/1"] parameters:NULL], (NSUInteger)1);
+    XCTAssertEqual([matcher indexOfRouteMatchingUrl:[NSURL URLWithString:@"test://"] parameters:NULL], (NSUInteger)NSNotFound);
+    XCTAssertEqual([matcher indexOfRouteMatchingUrl:[NSURL URLWithString:@"test:///"] parameters:NULL], (NSUInteger)NSNotFound);
+    XCTAssertEqual([matcher indexOfRouteMatchingUrl:[NSURL URLWithString:@"test://?venueId=1"] parameters:NULL], (NSUInteger)NSNotFound);
+
+    /**
+     Matchers made from route strings treat empty strings the same way.
+     */
+    matcher = [[FSQRouteMatcher alloc] initWithRouteStrings:@[@"", @"/venues/:venueId", @""]];
+    XCTAssertEqual(matcher.numberOfRoutes, (NSUInteger)3);
+    XCTAssertEqual([matcher indexOfRouteMatchingUrl:[NSURL URLWithString:@"test://venues/1"] parameters:NULL], (NSUInteger)1);
+    XCTAssertEqual([matcher indexOfRouteMatchingUrl:[NSURL URLWithString:@"test://"] parameters:NULL], (NSUInteger)NSNotFound);
+    XCTAssertEqual([matcher indexOfRouteMatchingUrl:[NSURL URLWithString:@"test://?venueId=1"] parameters:NULL], (NSUInteger)NSNotFound);
+    XCTAssertEqual([matcher routeAnalyses].count, (NSUInteger)1);
+}
+
+- (void)testRouteMatcher {
+    NSArray<NSString *> *routeStrings = @[@"/venues/:venueId/**", @"/venues/:venueId", @"/users/%3Aself", @"/*/:name", @"/"];
+    NSMutableArray<NSArray *> *routeMap = [NSMutableArray new];
+    for (NSString *routeString in routeStrings) {
+        [routeMap addObject:@[routeString, [FSQRouteContentGenerator new]]];
+    }
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:routeMap];
+
+    FSQRouteMatcher *matcher = [[FSQRouteMatcher alloc] initWithRouteStrings:routeStrings];
+    NSError *error = nil;
+    FSQRouteMatcher *compiledMatcher = [[FSQRouteMatcher alloc] initWithCompiledRouteMapData:[FSQUrlRouter compiledRouteMapDataWithRouteStrings:routeStrings]
+                                                                                        error:&error];
+    XCTAssertNotNil(compiledMatcher);
+    XCTAssertEqual(matcher.numberOfRoutes, routeStrings.count);
+    XCTAssertEqual(compiledMatcher.numberOfRoutes, routeStrings.count);
+
+    /**
+     Matchers ignore the scheme, so they should agree with the router for any url it has a map for.
+     */
+    for (NSString *urlPath in @[@"venues/1", @"venues/1/photos?a=b", @"users/:self", @"users/2", @"?param=a", @"", @"a/b/c"]) {
+        NSURL *url = [NSURL URLWithString:[@"test://" stringByAppendingString:urlPath]];
+        FSQRouteMatch *match = [[self.urlRouter matchUrls:@[url]] firstObject];
+
+        for (FSQRouteMatcher *routeMatcher in @[matcher, compiledMatcher]) {
+            NSDictionary<NSString *, NSString *> *parameters = nil;
+            XCTAssertEqual([routeMatcher indexOfRouteMatchingUrl:url parameters:&parameters], match.routeIndex, @"%@", urlPath);
+            XCTAssertEqualObjects(parameters, match.urlData.parameters, @"%@", urlPath);
+        }
+    }
+
+    XCTAssertNil([[FSQRouteMatcher alloc] initWithCompiledRouteMapData:[NSData data] error:&error]);
+    XCTAssertEqual(error.code, FSQUrlRouterErrorCodeInvalidCompiledRouteMap);
+}
+
+- (void)testAllMatchesAndRouteAnalysis {
+    NSArray<NSString *> *routeStrings = @[@"/venues/*", @"/venues/:venueId", @"/venues/:venueId/photos", @"/**/photos",
+                                          @"/users/:userId/photos", @"/users/self", @"/", @"/**", @"/venues/**", @"/users/%3Aself"];
+    NSMutableArray<NSArray *> *routeMap = [NSMutableArray new];
+    for (NSString *routeString in routeStrings) {
+        [routeMap addObject:@[routeString, [FSQRouteContentGenerator new]]];
+    }
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:routeMap];
+    FSQRouteMatcher *matcher = [[FSQRouteMatcher alloc] initWithRouteStrings:routeStrings];
+
+    NSDictionary<NSString *, NSArray<NSNumber *> *> *expectedRouteIndexes = @{@"test://venues/1/photos" : @[@2, @3, @7, @8],
+                                                                              @"test://venues/1" : @[@0, @1, @7, @8],
+                                                                              @"test://?a=b" : @[@6, @7],
+                                                                              @"test://" : @[@7],
+                                                                              @"other://venues/1" : @[]};
+    for (NSString *urlString in expectedRouteIndexes) {
+        NSURL *url = [NSURL URLWithString:urlString];
+        NSArray<FSQRouteMatch *> *matches = [self.urlRouter allMatchesForUrl:url];
+        XCTAssertEqualObjects([matches valueForKey:@"routeIndex"], expectedRouteIndexes[urlString], @"%@", urlString);
+
+        FSQRouteMatch *match = [[self.urlRouter matchUrls:@[url]] firstObject];
+        XCTAssertEqual((matches.firstObject != nil ? matches.firstObject.routeIndex : NSNotFound), match.routeIndex, @"%@", urlString);
+        XCTAssertEqualObjects(matches.firstObject.urlData.parameters, match.urlData.parameters, @"%@", urlString);
+
+        if ([url.scheme isEqualToString:@"test"]) {
+            NSMutableIndexSet *indexes = [NSMutableIndexSet new];
+            for (NSNumber *routeIndex in expectedRouteIndexes[urlString]) {
+                [indexes addIndex:routeIndex.unsignedIntegerValue];
+            }
+            XCTAssertEqualObjects([matcher indexesOfRoutesMatchingUrl:url], indexes, @"%@", urlString);
+        }
+    }
+    XCTAssertEqualObjects([self.urlRouter allMatchesForUrl:[NSURL URLWithString:@"test://venues/1/photos"]][1].urlData.parameters, @{});
+
+    NSArray<FSQRouteAnalysis *> *analyses = [self.urlRouter routeAnalysesForNativeScheme:@"test"];
+    XCTAssertEqual(analyses.count, routeStrings.count);
+    XCTAssertEqual([matcher routeAnalyses].count, routeStrings.count);
+    XCTAssertNil([self.urlRouter routeAnalysesForNativeScheme:@"other"]);
+
+    NSDictionary<NSNumber *, NSNumber *> *expectedShadowingRouteIndexes = @{@1 : @0, @4 : @3, @8 : @7, @9 : @7};
+    for (FSQRouteAnalysis *analysis in analyses) {
+        NSNumber *shadowingRouteIndex = expectedShadowingRouteIndexes[@(analysis.routeIndex)];
+        XCTAssertEqual(analysis.shadowingRouteIndex, (shadowingRouteIndex != nil ? shadowingRouteIndex.unsignedIntegerValue : NSNotFound),
+                       @"%@", analysis.routeString);
+        XCTAssertEqual(analysis.isRedundant, (BOOL)(analysis.routeIndex == 1), @"%@", analysis.routeString);
+    }
+
+    XCTAssertEqualObjects(analyses[2].routeString, @"/venues/:venueId/photos");
+    XCTAssertEqualObjects(analyses[9].routeString, @"/users/%3Aself");
+    XCTAssertEqualObjects(analyses[6].routeString, @"/");
+
+    XCTAssertEqual(analyses[2].minimumPathLength, (NSUInteger)3);
+    XCTAssertEqual(analyses[2].maximumPathLength, (NSUInteger)3);
+    XCTAssertEqual(analyses[2].worstCaseMatchingCost, (NSUInteger)16);
+    XCTAssertEqual([analyses[2] matchingCostForPathLength:2], (NSUInteger)0);
+
+    XCTAssertEqual(analyses[3].minimumPathLength, (NSUInteger)1);
+    XCTAssertEqual(analyses[3].maximumPathLength, NSUIntegerMax);
+    XCTAssertEqual(analyses[3].worstCaseMatchingCost, NSUIntegerMax);
+    XCTAssertEqual([analyses[3] matchingCostForPathLength:3], (NSUInteger)12);
+    XCTAssertEqual([analyses[3] matchingCostForPathLength:0], (NSUInteger)0);
+}
+
+- (void)testMatchingOptions {
+    FSQRouteContentGenerator *generator = [FSQRouteContentGenerator new];
+    NSArray<NSArray *> *routeMap = @[@[@"/Venues/:venueId", generator], @[@"/caf\u00e9", generator]];
+    FSQRouteMatchingOptions options = (FSQRouteMatchingOptionsCaseInsensitive | FSQRouteMatchingOptionsUnicodeNormalized);
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:routeMap options:options];
+    [self.urlRouter registerNativeSchemes:@[@"exact"] forRouteMap:routeMap];
+
+    FSQRouteMatcher *matcher = [[FSQRouteMatcher alloc] initWithRouteStrings:[routeMap valueForKey:@"firstObject"] options:options];
+
+    NSDictionary<NSString *, NSNumber *> *expectedRouteIndexes = @{@"test://venues/AbC" : @0,
+                                                                   @"test://VENUES/AbC" : @0,
+                                                                   @"test://CAF%C3%89" : @1,
+                                                                   @"test://cafe%CC%81" : @1,
+                                                                   @"test://CAFE%CC%81" : @1,
+                                                                   @"test://cafe" : @(NSNotFound)};
+    for (NSString *urlString in expectedRouteIndexes) {
+        NSURL *url = [NSURL URLWithString:urlString];
+        FSQRouteMatch *match = [[self.urlRouter matchUrls:@[url]] firstObject];
+        XCTAssertEqual(match.routeIndex, expectedRouteIndexes[urlString].unsignedIntegerValue, @"%@", urlString);
+        XCTAssertEqual([matcher indexOfRouteMatchingUrl:url parameters:NULL], match.routeIndex, @"%@", urlString);
+    }
+
+    /**
+     Parameters keep the url's own case.
+     */
+    XCTAssertEqualObjects([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://VENUES/AbC"]]] firstObject].urlData.parameters,
+                          @{@"venueId" : @"AbC"});
+    XCTAssertEqual([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"exact://Venues/1"]]] firstObject].routeIndex, (NSUInteger)0);
+    XCTAssertFalse([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"exact://venues/1"]]] firstObject].matched);
+
+    [self.urlRouter addRoute:@"/Users/:userId" generator:generator forNativeSchemes:@[@"test"]];
+    XCTAssertEqual([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://users/1"]]] firstObject].routeIndex, (NSUInteger)2);
+    XCTAssertTrue([self.urlRouter removeRoute:@"/Users/:userId" forNativeSchemes:@[@"test"]]);
+    XCTAssertFalse([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://users/1"]]] firstObject].matched);
+
+    FSQRouteUrlTemplate *template = [self.urlRouter urlTemplateForRoute:@"/Venues/:venueId" nativeScheme:@"test"];
+    XCTAssertEqualObjects([template urlWithParameters:@{@"venueId" : @"1"}].absoluteString, @"test://Venues/1");
+}
+
+- (void)testIntegerParameters {
+    NSArray<NSString *> *routeStrings = @[@"/venues/:venueId<int>", @"/venues/:venueSlug", @"/venues/:id", @"/venues/7",
+                                          @"/users/:userId<int>", @"/users/:id<int>"];
+    NSMutableArray<NSArray *> *routeMap = [NSMutableArray new];
+    for (NSString *routeString in routeStrings) {
+        [routeMap addObject:@[routeString, [FSQRouteContentGenerator new]]];
+    }
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:routeMap];
+    FSQRouteMatcher *matcher = [[FSQRouteMatcher alloc] initWithCompiledRouteMapData:[FSQUrlRouter compiledRouteMapDataWithRouteStrings:routeStrings]
+                                                                               error:NULL];
+
+    NSDictionary<NSString *, NSNumber *> *expectedRouteIndexes = @{@"test://venues/123" : @0,
+                                                                   @"test://venues/-5" : @0,
+                                                                   @"test://venues/7" : @0,
+                                                                   @"test://venues/abc" : @1,
+                                                                   @"test://venues/12a" : @1,
+                                                                   @"test://venues/-" : @1,
+                                                                   @"test://venues/99999999999999999999" : @1,
+                                                                   @"test://users/me" : @(NSNotFound)};
+    for (NSString *urlString in expectedRouteIndexes) {
+        NSURL *url = [NSURL URLWithString:urlString];
+        FSQRouteMatch *match = [[self.urlRouter matchUrls:@[url]] firstObject];
+        XCTAssertEqual(match.routeIndex, expectedRouteIndexes[urlString].unsignedIntegerValue, @"%@", urlString);
+        XCTAssertEqual([matcher indexOfRouteMatchingUrl:url parameters:NULL], match.routeIndex, @"%@", urlString);
+    }
+
+    FSQRouteUrlData *urlData = [[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://venues/-5"]]] firstObject].urlData;
+    XCTAssertEqualObjects([urlData integerParameterForKey:@"venueId"], @(-5));
+    XCTAssertEqualObjects(urlData.parameters, @{@"venueId" : @"-5"});
+
+    NSArray<FSQRouteAnalysis *> *analyses = [self.urlRouter routeAnalysesForNativeScheme:@"test"];
+    NSDictionary<NSNumber *, NSNumber *> *expectedShadowingRouteIndexes = @{@2 : @1, @3 : @0, @5 : @4};
+    for (FSQRouteAnalysis *analysis in analyses) {
+        NSNumber *shadowingRouteIndex = expectedShadowingRouteIndexes[@(analysis.routeIndex)];
+        XCTAssertEqual(analysis.shadowingRouteIndex, (shadowingRouteIndex != nil ? shadowingRouteIndex.unsignedIntegerValue : NSNotFound),
+                       @"%@", analysis.routeString);
+        XCTAssertEqual(analysis.isRedundant, (BOOL)(analysis.routeIndex == 2 || analysis.routeIndex == 5), @"%@", analysis.routeString);
+    }
+    XCTAssertEqualObjects(analyses[0].routeString, @"/venues/:venueId<int>");
+
+    FSQRouteUrlTemplate *template = [self.urlRouter urlTemplateForRoute:@"/venues/:venueId<int>" nativeScheme:@"test"];
+    XCTAssertEqualObjects(template.parameterNames, @[@"venueId"]);
+    XCTAssertNil([self.urlRouter urlTemplateForRoute:@"/venues/:venueId" nativeScheme:@"test"]);
+}
+
+- (void)testLazyQueryParameters {
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:@[@[@"/venues/:venueId<int>", [FSQRouteContentGenerator new]]]];
+
+    NSURL *url = [NSURL URLWithString:@"test://venues/12?q=caf%C3%A9+au+lait&utm_source=feed&venueId=34&empty"];
+    NSArray<FSQRouteMatch *> *matches = [self.urlRouter matchUrls:@[url, url]];
+    FSQRouteUrlData *urlData = matches[0].urlData;
+
+    XCTAssertEqualObjects([urlData parameterForKey:@"q"], @"caf\u00e9 au lait");
+    XCTAssertEqualObjects([urlData integerParameterForKey:@"venueId"], @34);
+    XCTAssertNil([urlData integerParameterForKey:@"q"]);
+    XCTAssertNil([urlData parameterForKey:@"empty"]);
+    XCTAssertNil([urlData parameterForKey:@"missing"]);
+
+    NSDictionary<NSString *, NSString *> *expectedParameters = @{@"venueId" : @"34", @"q" : @"caf\u00e9 au lait", @"utm_source" : @"feed"};
+    XCTAssertEqualObjects(urlData.parameters, expectedParameters);
+    XCTAssertEqualObjects(matches[1].urlData.parameters, expectedParameters);
+    XCTAssertEqualObjects([matches[1].urlData parameterForKey:@"utm_source"], @"feed");
+
+    urlData.parameters = @{@"a" : @"1"};
+    XCTAssertEqualObjects([urlData integerParameterForKey:@"a"], @1);
+    XCTAssertNil([urlData parameterForKey:@"q"]);
+    XCTAssertEqualObjects([matches[1].urlData parameterForKey:@"q"], @"caf\u00e9 au lait");
+}
+
+- (void)testUniversalLinkHostPatterns {
+    FSQRouteContentGenerator *exactGenerator = [FSQRouteContentGenerator new];
+    FSQRouteContentGenerator *patternGenerator = [FSQRouteContentGenerator new];
+    FSQRouteContentGenerator *longerPatternGenerator = [FSQRouteContentGenerator new];
+
+    [self.urlRouter registerUniversalLinkHosts:@[@"www.example.com"] forRouteMap:@[@[@"/venues/:venueId", exactGenerator]]];
+    [self.urlRouter registerUniversalLinkHosts:@[@"*.example.com", @"*.Example.org"] forRouteMap:@[@[@"/venues/:venueId", patternGenerator]]];
+    [self.urlRouter registerUniversalLinkHosts:@[@"*.api.example.com"] forRouteMap:@[@[@"/venues/:venueId", longerPatternGenerator]]];
+
+    NSDictionary<NSString *, id> *expectedGenerators = @{@"www.example.com" : exactGenerator,
+                                                         @"eu.example.com" : patternGenerator,
+                                                         @"a.b.example.com" : patternGenerator,
+                                                         @"WWW.EXAMPLE.ORG" : patternGenerator,
+                                                         @"eu.api.example.com" : longerPatternGenerator,
+                                                         @"api.example.com" : patternGenerator};
+    for (NSString *host in expectedGenerators) {
+        NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"https://%@/venues/1", host]];
+        FSQRouteMatch *match = [[self.urlRouter matchUrls:@[url]] firstObject];
+        XCTAssertEqual(match.contentGenerator, expectedGenerators[host], @"%@", host);
+        XCTAssertEqualObjects(match.urlData.parameters[@"venueId"], @"1", @"%@", host);
+    }
+
+    /**
+     A pattern doesn't match its own suffix, and the labels have to line up.
+     */
+    for (NSString *host in @[@"example.com", @"badexample.com", @"example.com.evil.net"]) {
+        NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"https://%@/venues/1", host]];
+        XCTAssertFalse([self.urlRouter urlSchemeOrDomainIsRegistered:url], @"%@", host);
+    }
+
+    XCTAssertNotNil([self.urlRouter urlTemplateForRoute:@"/venues/:venueId" universalLinkHost:@"eu.example.com"]);
+    XCTAssertNil([self.urlRouter urlTemplateForRoute:@"/venues/:venueId" universalLinkHost:@"example.com"]);
+
+    /**
+     Exact hosts are case insensitive too, both when registering and when matching.
+     */
+    [self.urlRouter registerUniversalLinkHosts:@[@"Exact.Example.net"] forRouteMap:@[@[@"/venues/:venueId", exactGenerator]]];
+    for (NSString *host in @[@"exact.example.net", @"EXACT.example.NET"]) {
+        NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"https://%@/venues/1", host]];
+        XCTAssertEqual([[self.urlRouter matchUrls:@[url]] firstObject].contentGenerator, exactGenerator, @"%@", host);
+    }
+    XCTAssertNotNil([self.urlRouter urlTemplateForRoute:@"/venues/:venueId" universalLinkHost:@"EXACT.example.net"]);
+}
+
+- (void)testRouteStringsAreInterned {
+    FSQRouteContentGenerator *generator = [FSQRouteContentGenerator new];
+    NSArray<NSArray *> *routeMap = @[@[@"/interntest/:interntestId", generator],
+                                     @[@"/interntest/:interntestId/interntest-photos", generator],
+                                     @[@"/interntest/*/interntest-photos/:interntestId", generator]];
+    NSUInteger numberOfStrings = [self.urlRouter numberOfInternedRouteStrings];
+
+    [self.urlRouter registerNativeSchemes:@[@"test", @"test2"] forRouteMap:routeMap];
+    [self.urlRouter registerUniversalLinkHosts:@[@"example.com"] forRouteMap:routeMap];
+    XCTAssertEqual([self.urlRouter numberOfInternedRouteStrings], numberOfStrings + 3);
+
+    FSQRouteMatch *match = [[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test2://interntest/1/interntest-photos"]]] firstObject];
+    XCTAssertEqual(match.routeIndex, (NSUInteger)1);
+    XCTAssertEqualObjects(match.urlData.parameters, @{@"interntestId" : @"1"});
+
+    /**
+     Url path components are only looked up in the pool, never added to it.
+     */
+    XCTAssertFalse([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://interntest/1/interntest-unknown"]]] firstObject].matched);
+    XCTAssertEqual([self.urlRouter numberOfInternedRouteStrings], numberOfStrings + 3);
+
+    /**
+     Maps registered later look urls up in a newer pool snapshot, which has their strings.
+     */
+    [self.urlRouter registerNativeSchemes:@[@"test3"] forRouteMap:@[@[@"/interntest/:interntestId/interntest-late", generator]]];
+    XCTAssertEqual([self.urlRouter numberOfInternedRouteStrings], numberOfStrings + 4);
+    XCTAssertFalse([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://interntest/1/interntest-late"]]] firstObject].matched);
+
+    match = [[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test3://interntest/2/interntest-late"]]] firstObject];
+    XCTAssertEqual(match.routeIndex, (NSUInteger)0);
+    XCTAssertEqualObjects(match.urlData.parameters, @{@"interntestId" : @"2"});
+}
+
+- (void)testMatchCache {
+    FSQRouteContentGenerator *generator = [FSQRouteContentGenerator new];
+    [self.urlRouter registerNativeSchemes:@[@"test"]
+                              forRouteMap:@[@[@"/venues/:venueId", generator],
+                                            @[@"/", generator]]];
+    self.urlRouter.matchCacheCapacity = 2;
+
+    FSQRouteMatch *match = [[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://venues/1?ref=push"]]] firstObject];
+    XCTAssertEqualObjects(match.urlData.parameters, (@{@"venueId" : @"1", @"ref" : @"push"}));
+    XCTAssertEqual(self.urlRouter.matchCacheMissCount, (NSUInteger)1);
+
+    match = [[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://venues//1?ref=email"]]] firstObject];
+    XCTAssertEqualObjects(match.urlData.parameters, (@{@"venueId" : @"1", @"ref" : @"email"}));
+    XCTAssertEqual(match.routeIndex, (NSUInteger)0);
+    XCTAssertEqual(self.urlRouter.matchCacheHitCount, (NSUInteger)1);
+
+    /**
+     Misses are cached too. Empty paths skip the cache since their match depends on the query.
+     */
+    XCTAssertFalse([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://missing"]]] firstObject].matched);
+    XCTAssertFalse([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://missing"]]] firstObject].matched);
+    XCTAssertTrue([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://?param=a"]]] firstObject].matched);
+    XCTAssertFalse([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://"]]] firstObject].matched);
+    XCTAssertEqual(self.urlRouter.matchCacheHitCount, (NSUInteger)2);
+    XCTAssertEqual(self.urlRouter.matchCacheMissCount, (NSUInteger)2);
+
+    /**
+     venues/1 was used least recently, so it is evicted to make room.
+     */
+    [self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://venues/2"]]];
+    [self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://venues/1"]]];
+    XCTAssertEqual(self.urlRouter.matchCacheHitCount, (NSUInteger)2);
+    XCTAssertEqual(self.urlRouter.matchCacheMissCount, (NSUInteger)4);
+
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:@[@[@"/venues/:otherId", generator]]];
+    match = [[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://venues/1"]]] firstObject];
+    XCTAssertEqualObjects(match.urlData.parameters, (@{@"otherId" : @"1"}));
+    XCTAssertEqual(self.urlRouter.matchCacheMissCount, (NSUInteger)5);
+
+    self.urlRouter.matchCacheCapacity = 0;
+    XCTAssertEqual(self.urlRouter.matchCacheHitCount, (NSUInteger)0);
+    XCTAssertTrue([[self.urlRouter matchUrls:@[[NSURL URLWithString:@"test://venues/1"]]] firstObject].matched);
+}
+
+- (void)testRoutingMetrics {
+    FSQRouteContentGenerator *generator = [[FSQRouteContentGenerator alloc] initWithBlock:^FSQRouteContent *(FSQRouteUrlData *urlData) {
+        return [[FSQRouteContent alloc] initWithViewControllerClass:[UIViewController class]];
+    }];
+    [self.urlRouter registerNativeSchemes:@[@"test"]
+                              forRouteMap:@[@[@"/users/:userId", generator],
+                                            @[@"/venues/:venueId", generator]]];
+
+    self.urlRouter.metricsObserver = self;
+    self.endedRoutingStages = [NSMutableArray new];
+    self.routingMetricsExpectation = [self expectationWithDescription:@"Routing pass finished"];
+
+    [self.urlRouter routeUrl:[NSURL URLWithString:@"test://venues/1"]];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+
+    FSQRoutingMetrics *metrics = self.finishedRoutingMetrics;
+    XCTAssertEqual(metrics.outcome, FSQRoutingOutcomeNoPresentingViewController);
+    XCTAssertEqual(metrics.routeIndex, (NSUInteger)1);
+    XCTAssertEqual(metrics.numberOfRoutesTried, (NSUInteger)1);
+
+    NSMutableArray<NSNumber *> *expectedStages = [NSMutableArray new];
+    for (FSQRoutingStage stage = 0; stage < FSQRoutingStageCount; stage++) {
+        [expectedStages addObject:@(stage)];
+        XCTAssertGreaterThan([metrics startTimeForStage:stage], (uint64_t)0);
+        XCTAssertGreaterThanOrEqual([metrics endTimeForStage:stage], [metrics startTimeForStage:stage]);
+        if (stage > 0) {
+            XCTAssertGreaterThanOrEqual([metrics startTimeForStage:stage], [metrics endTimeForStage:stage - 1]);
+        }
+    }
+    XCTAssertEqualObjects(self.endedRoutingStages, expectedStages);
+
+    self.routingMetricsExpectation = nil;
+    [self.urlRouter routeUrl:[NSURL URLWithString:@"test://missing"]];
+    XCTAssertEqual(self.finishedRoutingMetrics.outcome, FSQRoutingOutcomeFailedToMatch);
+    XCTAssertEqual(self.finishedRoutingMetrics.routeIndex, (NSUInteger)NSNotFound);
+    XCTAssertEqual([self.finishedRoutingMetrics endTimeForStage:FSQRoutingStageShouldGenerateRouteContent], (uint64_t)0);
+}
+
+- (void)testViewControllerReusePool {
+    FSQRouteViewControllerPool *pool = [[FSQRouteViewControllerPool alloc] initWithCapacity:2];
+    UIViewController *presentingViewController = [UIViewController new];
+    __block UIViewController *presentedViewController = nil;
+    FSQRoutePresentation presentation = ^(UIViewController *controllerToPresent, UIViewController *presentingController, FSQRouteUrlData *urlData) {
+        presentedViewController = controllerToPresent;
+    };
+
+    FSQRouteContent *(^contentForVenue)(NSString *) = ^(NSString *venueId) {
+        FSQRouteUrlData *urlData = [FSQRouteUrlData new];
+        urlData.parameters = @{@"venueId" : venueId};
+        FSQRouteContent *content = [[FSQRouteContent alloc] initWithViewControllerClass:[FSQReusableTestViewController class]
+                                                                            presentation:presentation];
+        content.urlData = urlData;
+        content.reuseIdentifier = venueId;
+        content.reusePool = pool;
+        return content;
+    };
+
+    FSQRouteContent *firstContent = contentForVenue(@"1");
+    [firstContent presentFromViewController:presentingViewController];
+    FSQReusableTestViewController *firstViewController = (FSQReusableTestViewController *)presentedViewController;
+    XCTAssertEqual(pool.count, (NSUInteger)1);
+
+    FSQRouteContent *secondContent = contentForVenue(@"1");
+    [secondContent presentFromViewController:presentingViewController];
+    XCTAssertEqual(presentedViewController, firstViewController);
+    XCTAssertEqual(firstViewController.numberOfReuses, (NSUInteger)1);
+    XCTAssertEqual(firstViewController.urlData, secondContent.urlData);
+
+    [contentForVenue(@"2") presentFromViewController:presentingViewController];
+    XCTAssertNotEqual(presentedViewController, firstViewController);
+    XCTAssertEqual(pool.count, (NSUInteger)2);
+
+    /**
+     View controllers which are still in use are not handed out again.
+     */
+    UINavigationController *navigationController = [[UINavigationController alloc] initWithRootViewController:firstViewController];
+    [contentForVenue(@"1") presentFromViewController:presentingViewController];
+    XCTAssertNotEqual(presentedViewController, firstViewController);
+    XCTAssertEqual(pool.count, (NSUInteger)2);
+    XCTAssertEqual(navigationController.viewControllers.firstObject, firstViewController);
+
+    /**
+     Content without a reuse identifier always gets a new view controller.
+     */
+    FSQRouteContent *unidentifiedContent = contentForVenue(@"2");
+    unidentifiedContent.reuseIdentifier = nil;
+    [unidentifiedContent presentFromViewController:presentingViewController];
+    XCTAssertEqual(((FSQReusableTestViewController *)presentedViewController).numberOfReuses, (NSUInteger)0);
+
+    [[NSNotificationCenter defaultCenter] postNotificationName:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+    XCTAssertEqual(pool.count, (NSUInteger)0);
+
+    /**
+     The router hands its pool to the content its generators make.
+     */
+    FSQRouteContentGenerator *generator = [[FSQRouteContentGenerator alloc] initWithBlock:^FSQRouteContent *(FSQRouteUrlData *urlData) {
+        FSQRouteContent *content = [[FSQRouteContent alloc] initWithViewControllerClass:[FSQReusableTestViewController class]];
+        content.reuseIdentifier = urlData.parameters[@"venueId"];
+        return content;
+    }];
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:@[@[@"/venues/:venueId", generator]]];
+    self.urlRouter.viewControllerReusePool = pool;
+    XCTAssertEqual([self.urlRouter generateRouteContentFromUrl:[NSURL URLWithString:@"test://venues/1"]].reusePool, pool);
+}
+
+- (void)testTraceRecordingAndReplay {
+    FSQRouteContentGenerator *generator = [[FSQRouteContentGenerator alloc] initWithBlock:^FSQRouteContent *(FSQRouteUrlData *urlData) {
+        return [[FSQRouteContent alloc] initWithViewControllerClass:[UIViewController class]];
+    }];
+    NSArray<NSArray *> *routeMap = @[@[@"/users/:userId", generator],
+                                     @[@"/venues/:venueId", generator]];
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:routeMap];
+
+    NSURL *fileUrl = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]]];
+    NSError *error = nil;
+    FSQRouteTraceRecorder *recorder = [[FSQRouteTraceRecorder alloc] initWithFileUrl:fileUrl error:&error];
+    XCTAssertNotNil(recorder, @"%@", error);
+    self.urlRouter.traceRecorder = recorder;
+    self.urlRouter.metricsObserver = self;
+
+    self.routingMetricsExpectation = [self expectationWithDescription:@"Routing pass finished"];
+    [self.urlRouter routeUrl:[NSURL URLWithString:@"test://venues/1"] notificationUserInfo:@{@"aps" : @{@"alert" : @"Hi"}}];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+
+    self.routingMetricsExpectation = nil;
+    [self.urlRouter routeUrl:[NSURL URLWithString:@"test://missing"]];
+    [recorder flush];
+    XCTAssertEqual(recorder.numberOfDroppedRecords, (NSUInteger)0);
+
+    NSArray<FSQRouteTraceRecord *> *records = [FSQRouteTraceRecord recordsFromTraceAtUrl:fileUrl error:&error];
+    XCTAssertEqual(records.count, (NSUInteger)2, @"%@", error);
+    XCTAssertEqualObjects(records[0].url, [NSURL URLWithString:@"test://venues/1"]);
+    XCTAssertEqualObjects(records[0].notificationUserInfo, (@{@"aps" : @{@"alert" : @"Hi"}}));
+    XCTAssertEqual(records[0].routeIndex, (NSUInteger)1);
+    XCTAssertEqual(records[0].outcome, FSQRoutingOutcomeNoPresentingViewController);
+    XCTAssertGreaterThan([records[0] durationOfStage:FSQRoutingStagePathMatching], (uint64_t)0);
+    XCTAssertGreaterThan(records[0].timestamp, (NSTimeInterval)0);
+    XCTAssertEqual(records[1].routeIndex, (NSUInteger)NSNotFound);
+    XCTAssertEqual(records[1].outcome, FSQRoutingOutcomeFailedToMatch);
+    XCTAssertEqual([records[1] durationOfStage:FSQRoutingStageContentGeneration], (uint64_t)0);
+
+    /**
+     Only one recorder can have a trace open at a time.
+     */
+    self.urlRouter.traceRecorder = nil;
+    XCTAssertNil([[FSQRouteTraceRecorder alloc] initWithFileUrl:fileUrl error:&error]);
+    XCTAssertEqualObjects(error.domain, NSPOSIXErrorDomain);
+    XCTAssertEqual(error.code, (NSInteger)EWOULDBLOCK);
+
+    /**
+     Once it is gone, a new recorder appends to the existing trace, and the trace replays headlessly through a fresh
+     router.
+     */
+    recorder = nil;
+    recorder = [[FSQRouteTraceRecorder alloc] initWithFileUrl:fileUrl error:&error];
+    XCTAssertNotNil(recorder, @"%@", error);
+    FSQRoutingMetrics *lastMetrics = self.finishedRoutingMetrics;
+    [recorder recordRoutingMetrics:lastMetrics];
+    [recorder flush];
+    records = [FSQRouteTraceRecord recordsFromTraceAtUrl:fileUrl error:&error];
+    XCTAssertEqual(records.count, (NSUInteger)3);
+
+    /**
+     A record cut short at the end of the file is dropped when the trace is reopened, instead of swallowing the
+     records appended after it.
+     */
+    recorder = nil;
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:fileUrl.path];
+    unsigned long long fileLength = [fileHandle seekToEndOfFile];
+    [fileHandle truncateFileAtOffset:fileLength - 3];
+    [fileHandle closeFile];
+    recorder = [[FSQRouteTraceRecorder alloc] initWithFileUrl:fileUrl error:&error];
+    XCTAssertNotNil(recorder, @"%@", error);
+    [recorder recordRoutingMetrics:lastMetrics];
+    [recorder flush];
+    records = [FSQRouteTraceRecord recordsFromTraceAtUrl:fileUrl error:&error];
+    XCTAssertEqual(records.count, (NSUInteger)3, @"%@", error);
+    XCTAssertEqualObjects(records[2].url, lastMetrics.url);
+
+    FSQUrlRouter *replayRouter = [[FSQUrlRouter alloc] initWithDelegate:self];
+    [replayRouter registerNativeSchemes:@[@"test"] forRouteMap:routeMap];
+    self.finishedRoutingMetrics = nil;
+    replayRouter.metricsObserver = self;
+
+    NSArray<FSQRoutingMetrics *> *replayedMetrics = [replayRouter replayTraceRecords:records];
+    XCTAssertEqual(replayedMetrics.count, records.count);
+    for (NSUInteger recordIndex = 0; recordIndex < records.count; recordIndex++) {
+        XCTAssertEqualObjects(replayedMetrics[recordIndex].url, records[recordIndex].url);
+        XCTAssertEqual(replayedMetrics[recordIndex].routeIndex, records[recordIndex].routeIndex);
+        XCTAssertGreaterThan([replayedMetrics[recordIndex] endTimeForStage:FSQRoutingStagePathMatching], (uint64_t)0);
+        XCTAssertEqual([replayedMetrics[recordIndex] endTimeForStage:FSQRoutingStageContentGeneration], (uint64_t)0);
+    }
+    XCTAssertNil(self.finishedRoutingMetrics);
+
+    /**
+     Files which aren't traces are rejected rather than appended to.
+     */
+    XCTAssertTrue([[@"not a trace" dataUsingEncoding:NSUTF8StringEncoding] writeToURL:fileUrl atomically:YES]);
+    XCTAssertNil([[FSQRouteTraceRecorder alloc] initWithFileUrl:fileUrl error:&error]);
+    XCTAssertEqual(error.code, FSQUrlRouterErrorCodeInvalidTrace);
+    XCTAssertNil([FSQRouteTraceRecord recordsFromTraceAtUrl:fileUrl error:NULL]);
+
+    [[NSFileManager defaultManager] removeItemAtURL:fileUrl error:nil];
+}
+
+- (void)testAsyncContentGenerationIsCancelledByNewerRoutes {
+    __block FSQRouteCancellationToken *slowCancellationToken = nil;
+    __block FSQRoutesContentGeneratorCompletionBlock slowCompletion = nil;
+    __block BOOL cancellationHandlerWasCalled = NO;
+    FSQRouteContentGenerator *slowGenerator = [[FSQRouteContentGenerator alloc] initWithAsyncBlock:^(FSQRouteUrlData *urlData,
+                                                                                                     FSQRouteCancellationToken *cancellationToken,
+                                                                                                     FSQRoutesContentGeneratorCompletionBlock completion) {
+        slowCancellationToken = cancellationToken;
+        slowCompletion = completion;
+        [cancellationToken addCancellationHandler:^{
+            cancellationHandlerWasCalled = YES;
+        }];
+    }];
+    FSQRouteContentGenerator *generator = [[FSQRouteContentGenerator alloc] initWithBlock:^FSQRouteContent *(FSQRouteUrlData *urlData) {
+        return [[FSQRouteContent alloc] initWithViewControllerClass:[UIViewController class]];
+    }];
+    [self.urlRouter registerNativeSchemes:@[@"test"]
+                              forRouteMap:@[@[@"/venues/:venueId", slowGenerator],
+                                            @[@"/users/:userId", generator]]];
+    self.urlRouter.metricsObserver = self;
+
+    NSURL *slowUrl = [NSURL URLWithString:@"test://venues/1"];
+    [self.urlRouter routeUrl:slowUrl];
+    XCTAssertNotNil(slowCompletion);
+    XCTAssertFalse(slowCancellationToken.isCancelled);
+    XCTAssertNil(self.finishedRoutingMetrics);
+
+    [self.urlRouter routeUrl:[NSURL URLWithString:@"test://users/2"]];
+    XCTAssertTrue(slowCancellationToken.isCancelled);
+    XCTAssertTrue(cancellationHandlerWasCalled);
+
+    slowCompletion([[FSQRouteContent alloc] initWithViewControllerClass:[UIViewController class]]);
+    XCTAssertEqualObjects(self.finishedRoutingMetrics.url, slowUrl);
+    XCTAssertEqual(self.finishedRoutingMetrics.outcome, FSQRoutingOutcomeCancelled);
+
+    self.routingMetricsExpectation = [self expectationWithDescription:@"Newer route finished"];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    XCTAssertEqualObjects(self.finishedRoutingMetrics.url, [NSURL URLWithString:@"test://users/2"]);
+    XCTAssertEqual(self.finishedRoutingMetrics.outcome, FSQRoutingOutcomeNoPresentingViewController);
+}
+
+- (void)testNonBlockingContentGeneration {
+    FSQRouteContentGenerator *generator = [[FSQRouteContentGenerator alloc] initWithAsyncBlock:^(FSQRouteUrlData *urlData,
+                                                                                                 FSQRouteCancellationToken *cancellationToken,
+                                                                                                 FSQRoutesContentGeneratorCompletionBlock completion) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            completion([[FSQRouteContent alloc] initWithViewControllerClass:[UIViewController class]]);
+        });
+    }];
+    FSQRouteContentGenerator *generatorWaitingForCancellation = [[FSQRouteContentGenerator alloc] initWithAsyncBlock:^(FSQRouteUrlData *urlData,
+                                                                                                                       FSQRouteCancellationToken *cancellationToken,
+                                                                                                                       FSQRoutesContentGeneratorCompletionBlock completion) {
+        [cancellationToken addCancellationHandler:^{
+            completion([[FSQRouteContent alloc] initWithViewControllerClass:[UIViewController class]]);
+        }];
+    }];
+    [self.urlRouter registerNativeSchemes:@[@"test"]
+                              forRouteMap:@[@[@"/venues/:venueId", generator],
+                                            @[@"/users/:userId", generatorWaitingForCancellation]]];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Content generated"];
+    [self.urlRouter generateRouteContentFromUrl:[NSURL URLWithString:@"test://venues/1"]
+                           notificationUserInfo:@{@"key" : @"value"}
+                                     completion:^(FSQRouteContent *routeContent) {
+                                         XCTAssertEqualObjects(routeContent.urlData.parameters, @{@"venueId" : @"1"});
+                                         XCTAssertEqualObjects(routeContent.urlData.notificationUserInfo, @{@"key" : @"value"});
+                                         [expectation fulfill];
+                                     }];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+
+    expectation = [self expectationWithDescription:@"Cancelled generation finished"];
+    FSQRouteCancellationToken *cancellationToken = [self.urlRouter generateRouteContentFromUrl:[NSURL URLWithString:@"test://users/2"]
+                                                                          notificationUserInfo:nil
+                                                                                    completion:^(FSQRouteContent *routeContent) {
+                                                                                        XCTAssertNil(routeContent);
+                                                                                        [expectation fulfill];
+                                                                                    }];
+    [cancellationToken cancel];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+
+    // Routing continues on the main queue even though the generator completes on a background queue
+    self.urlRouter.metricsObserver = self;
+    self.routingMetricsExpectation = [self expectationWithDescription:@"Routed url finished"];
+    [self.urlRouter routeUrl:[NSURL URLWithString:@"test://venues/1"]];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    self.routingMetricsExpectation = nil;
+    XCTAssertEqual(self.finishedRoutingMetrics.outcome, FSQRoutingOutcomeNoPresentingViewController);
+    XCTAssertFalse(self.delegateWasCalledOffMainQueue);
+
+    expectation = [self expectationWithDescription:@"Unmatched url finished"];
+    [self.urlRouter generateRouteContentFromUrl:[NSURL URLWithString:@"test://missing"]
+                           notificationUserInfo:nil
+                                     completion:^(FSQRouteContent *routeContent) {
+                                         XCTAssertNil(routeContent);
+                                         [expectation fulfill];
+                                     }];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+}
+
+- (void)testPrewarmedContentIsUsedWhenRouted {
+    __block NSUInteger numberOfGenerations = 0;
+    __block XCTestExpectation *generationExpectation = nil;
+    FSQRouteContentGenerator *generator = [[FSQRouteContentGenerator alloc] initWithAsyncBlock:^(FSQRouteUrlData *urlData,
+                                                                                                 FSQRouteCancellationToken *cancellationToken,
+                                                                                                 FSQRoutesContentGeneratorCompletionBlock completion) {
+        numberOfGenerations++;
+        completion([[FSQRouteContent alloc] initWithViewControllerClass:[UIViewController class]]);
+        [generationExpectation fulfill];
+    }];
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:@[@[@"/venues/:venueId", generator]]];
+    self.urlRouter.metricsObserver = self;
+    NSURL *url = [NSURL URLWithString:@"test://venues/1"];
+
+    generationExpectation = [self expectationWithDescription:@"Url prewarmed"];
+    [self.urlRouter prewarmUrl:url];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    generationExpectation = nil;
+
+    self.routingMetricsExpectation = [self expectationWithDescription:@"Prewarmed route finished"];
+    [self.urlRouter routeUrl:url];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    XCTAssertEqual(numberOfGenerations, (NSUInteger)1);
+    XCTAssertTrue(self.finishedRoutingMetrics.usedPrewarmedContent);
+    XCTAssertEqual(self.finishedRoutingMetrics.routeIndex, (NSUInteger)0);
+    XCTAssertEqual([self.finishedRoutingMetrics endTimeForStage:FSQRoutingStageContentGeneration], (uint64_t)0);
+    XCTAssertEqual(self.finishedRoutingMetrics.outcome, FSQRoutingOutcomeNoPresentingViewController);
+
+    // Prewarmed content is only used once
+    self.routingMetricsExpectation = [self expectationWithDescription:@"Second route finished"];
+    [self.urlRouter routeUrl:url];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    XCTAssertEqual(numberOfGenerations, (NSUInteger)2);
+    XCTAssertFalse(self.finishedRoutingMetrics.usedPrewarmedContent);
+
+    // Content prewarmed before the routes change is discarded
+    generationExpectation = [self expectationWithDescription:@"Url prewarmed again"];
+    [self.urlRouter prewarmUrl:url];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    generationExpectation = nil;
+    [self.urlRouter addRoute:@"/users/:userId" generator:generator forNativeSchemes:@[@"test"]];
+
+    self.routingMetricsExpectation = [self expectationWithDescription:@"Route after update finished"];
+    [self.urlRouter routeUrl:url];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    XCTAssertEqual(numberOfGenerations, (NSUInteger)4);
+    XCTAssertFalse(self.finishedRoutingMetrics.usedPrewarmedContent);
+}
+
+- (void)testPrewarmingGeneratesOnMainQueueAndMatchesUserInfo {
+    __block NSUInteger numberOfGenerations = 0;
+    __block BOOL generatedOffMainQueue = NO;
+    __block XCTestExpectation *generationExpectation = nil;
+    FSQRouteContentGenerator *generator = [[FSQRouteContentGenerator alloc] initWithBlock:^FSQRouteContent *(FSQRouteUrlData *urlData) {
+        numberOfGenerations++;
+        generatedOffMainQueue = generatedOffMainQueue || ![NSThread isMainThread];
+        // Fulfilled after the prewarmed content has been cached
+        XCTestExpectation *expectation = generationExpectation;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [expectation fulfill];
+        });
+        return [[FSQRouteContent alloc] initWithViewControllerClass:[UIViewController class]];
+    }];
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:@[@[@"/venues/:venueId", generator]]];
+    self.urlRouter.metricsObserver = self;
+    NSURL *url = [NSURL URLWithString:@"test://venues/1"];
+
+    generationExpectation = [self expectationWithDescription:@"Url prewarmed"];
+    [self.urlRouter prewarmUrl:url notificationUserInfo:@{@"id" : @"1"}];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    generationExpectation = nil;
+    XCTAssertFalse(generatedOffMainQueue);
+
+    // Content prewarmed for another notification is not used
+    self.routingMetricsExpectation = [self expectationWithDescription:@"Route with other userInfo finished"];
+    [self.urlRouter routeUrl:url notificationUserInfo:@{@"id" : @"2"}];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    XCTAssertEqual(numberOfGenerations, (NSUInteger)2);
+    XCTAssertFalse(self.finishedRoutingMetrics.usedPrewarmedContent);
+
+    generationExpectation = [self expectationWithDescription:@"Url prewarmed again"];
+    [self.urlRouter prewarmUrl:url notificationUserInfo:@{@"id" : @"1"}];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    generationExpectation = nil;
+
+    self.routingMetricsExpectation = [self expectationWithDescription:@"Route with same userInfo finished"];
+    [self.urlRouter routeUrl:url notificationUserInfo:@{@"id" : @"1"}];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    XCTAssertEqual(numberOfGenerations, (NSUInteger)3);
+    XCTAssertTrue(self.finishedRoutingMetrics.usedPrewarmedContent);
+    XCTAssertFalse(generatedOffMainQueue);
+}
+
+- (void)testRoutingQueuePolicies {
+    FSQRouteContentGenerator *generator = [[FSQRouteContentGenerator alloc] initWithBlock:^FSQRouteContent *(FSQRouteUrlData *urlData) {
+        return [[FSQRouteContent alloc] initWithViewControllerClass:[UIViewController class]];
+    }];
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:@[@[@"/venues/:venueId", generator]]];
+    self.urlRouter.metricsObserver = self;
+    self.finishedRoutingUrls = [NSMutableArray new];
+    NSURL *firstUrl = [NSURL URLWithString:@"test://venues/1"];
+    NSURL *secondUrl = [NSURL URLWithString:@"test://venues/2"];
+
+    // Routes wait for the main queue hop before presenting, so later urls are queued behind them
+    self.urlRouter.routingQueuePolicy = FSQRoutingQueuePolicyFirstInFirstOut;
+    [self.urlRouter routeUrl:firstUrl];
+    [self.urlRouter routeUrl:secondUrl];
+    [self.urlRouter routeUrl:firstUrl];
+    XCTAssertEqual(self.urlRouter.numberOfQueuedRoutes, (NSUInteger)2);
+    XCTAssertEqual(self.finishedRoutingUrls.count, (NSUInteger)0);
+
+    [self expectationForPredicate:[NSPredicate predicateWithFormat:@"count == 3"] evaluatedWithObject:self.finishedRoutingUrls handler:nil];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    XCTAssertEqualObjects(self.finishedRoutingUrls, (@[firstUrl, secondUrl, firstUrl]));
+    XCTAssertEqual(self.finishedRoutingMetrics.outcome, FSQRoutingOutcomeNoPresentingViewController);
+
+    // Repeated urls are dropped before they are matched
+    [self.finishedRoutingUrls removeAllObjects];
+    self.urlRouter.routingQueuePolicy = FSQRoutingQueuePolicyDedupeWithinInterval;
+    self.urlRouter.routingQueueDedupeInterval = 60;
+    [self.urlRouter routeUrl:firstUrl];
+    [self.urlRouter routeUrl:secondUrl];
+    [self.urlRouter routeUrl:firstUrl];
+    XCTAssertEqual(self.urlRouter.numberOfQueuedRoutes, (NSUInteger)1);
+    XCTAssertEqual(self.finishedRoutingMetrics.outcome, FSQRoutingOutcomeDropped);
+    XCTAssertEqual(self.finishedRoutingMetrics.numberOfRoutesTried, (NSUInteger)0);
+
+    [self expectationForPredicate:[NSPredicate predicateWithFormat:@"count == 3"] evaluatedWithObject:self.finishedRoutingUrls handler:nil];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    XCTAssertEqualObjects(self.finishedRoutingUrls, (@[firstUrl, firstUrl, secondUrl]));
+
+    // Newer urls cancel older ones and nothing is queued
+    [self.finishedRoutingUrls removeAllObjects];
+    self.urlRouter.routingQueuePolicy = FSQRoutingQueuePolicyLatestWins;
+    [self.urlRouter routeUrl:firstUrl];
+    [self.urlRouter routeUrl:secondUrl];
+    XCTAssertEqual(self.urlRouter.numberOfQueuedRoutes, (NSUInteger)0);
+
+    [self expectationForPredicate:[NSPredicate predicateWithFormat:@"count == 2"] evaluatedWithObject:self.finishedRoutingUrls handler:nil];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    XCTAssertEqualObjects(self.finishedRoutingUrls, (@[firstUrl, secondUrl]));
+    XCTAssertEqual(self.finishedRoutingMetrics.outcome, FSQRoutingOutcomeNoPresentingViewController);
+}
+
+- (void)testRoutingQueueDoesNotStallOnUnfinishedRoutes {
+    FSQRouteContentGenerator *neverCompletingGenerator = [[FSQRouteContentGenerator alloc] initWithAsyncBlock:^(FSQRouteUrlData *urlData,
+                                                                                                                FSQRouteCancellationToken *cancellationToken,
+                                                                                                                FSQRoutesContentGeneratorCompletionBlock completion) {
+    }];
+    FSQRouteContentGenerator *generator = [[FSQRouteContentGenerator alloc] initWithBlock:^FSQRouteContent *(FSQRouteUrlData *urlData) {
+        return [[FSQRouteContent alloc] initWithViewControllerClass:[UIViewController class]];
+    }];
+    [self.urlRouter registerNativeSchemes:@[@"test"]
+                              forRouteMap:@[@[@"/stuck/:id", neverCompletingGenerator],
+                                            @[@"/venues/:venueId", generator]]];
+    self.urlRouter.metricsObserver = self;
+    self.urlRouter.routingQueuePolicy = FSQRoutingQueuePolicyFirstInFirstOut;
+
+    // A pass whose generator never completes is given up on after the timeout
+    self.urlRouter.routingPassTimeout = 0.1;
+    [self.urlRouter routeUrl:[NSURL URLWithString:@"test://stuck/1"]];
+    [self.urlRouter routeUrl:[NSURL URLWithString:@"test://venues/1"]];
+    XCTAssertEqual(self.urlRouter.numberOfQueuedRoutes, (NSUInteger)1);
+
+    self.routingMetricsExpectation = [self expectationWithDescription:@"Queued route finished"];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    XCTAssertEqualObjects(self.finishedRoutingMetrics.url, [NSURL URLWithString:@"test://venues/1"]);
+    XCTAssertEqual(self.urlRouter.numberOfQueuedRoutes, (NSUInteger)0);
+
+    // Without a delegate, passes finish without waiting for a completion handler
+    self.urlRouter.routingPassTimeout = 0;
+    self.urlRouter.delegate = nil;
+    self.finishedRoutingUrls = [NSMutableArray new];
+    self.routingMetricsExpectation = nil;
+    [self.urlRouter routeUrl:[NSURL URLWithString:@"test://venues/2"]];
+    [self.urlRouter routeUrl:[NSURL URLWithString:@"test://venues/3"]];
+    XCTAssertEqual(self.urlRouter.numberOfQueuedRoutes, (NSUInteger)0);
+    XCTAssertEqualObjects(self.finishedRoutingUrls, (@[[NSURL URLWithString:@"test://venues/2"], [NSURL URLWithString:@"test://venues/3"]]));
+    XCTAssertEqual(self.finishedRoutingMetrics.outcome, FSQRoutingOutcomeNoPresentingViewController);
+}
+
+- (void)testLatestWinsSkipsSupersededUrls {
+    __block NSUInteger numberOfGeneratorCalls = 0;
+    FSQRouteContentGenerator *generator = [[FSQRouteContentGenerator alloc] initWithBlock:^FSQRouteContent *(FSQRouteUrlData *urlData) {
+        numberOfGeneratorCalls++;
+        return [[FSQRouteContent alloc] initWithViewControllerClass:[UIViewController class]];
+    }];
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:@[@[@"/venues/:venueId", generator]]];
+    self.urlRouter.metricsObserver = self;
+    self.finishedRoutingUrls = [NSMutableArray new];
+    NSArray<NSURL *> *urls = @[[NSURL URLWithString:@"test://venues/1"],
+                               [NSURL URLWithString:@"test://venues/2"],
+                               [NSURL URLWithString:@"test://venues/3"],
+                               [NSURL URLWithString:@"test://venues/4"]];
+
+    // The first url starts right away, the middle ones are replaced before they are matched
+    for (NSURL *url in urls) {
+        [self.urlRouter routeUrl:url];
+    }
+    XCTAssertEqual(numberOfGeneratorCalls, (NSUInteger)1);
+    XCTAssertEqualObjects(self.finishedRoutingUrls, (@[urls[1], urls[2]]));
+    XCTAssertEqual(self.finishedRoutingMetrics.outcome, FSQRoutingOutcomeDropped);
+    XCTAssertEqual(self.finishedRoutingMetrics.numberOfRoutesTried, (NSUInteger)0);
+
+    [self expectationForPredicate:[NSPredicate predicateWithFormat:@"count == 4"] evaluatedWithObject:self.finishedRoutingUrls handler:nil];
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    XCTAssertEqual(numberOfGeneratorCalls, (NSUInteger)2);
+    XCTAssertEqualObjects(self.finishedRoutingUrls, (@[urls[1], urls[2], urls[0], urls[3]]));
+    XCTAssertEqual(self.finishedRoutingMetrics.outcome, FSQRoutingOutcomeNoPresentingViewController);
+}
+
+- (void)testRoutingWithGeneratorKeepsRawQueryValues {
+    __block FSQRouteUrlData *generatedUrlData = nil;
+    FSQRouteContentGenerator *generator = [[FSQRouteContentGenerator alloc] initWithBlock:^FSQRouteContent *(FSQRouteUrlData *urlData) {
+        generatedUrlData = urlData;
+        return nil;
+    }];
+
+    [self.urlRouter routeUrl:[NSURL URLWithString:@"test://anything?q=a+b&name=%C3%A9&q=c+d"] notificationUserInfo:nil usingGenerator:generator];
+    XCTAssertEqualObjects([generatedUrlData parameterForKey:@"q"], @"c+d");
+    XCTAssertEqualObjects([generatedUrlData parameterForKey:@"name"], @"\u00e9");
+    XCTAssertNil([generatedUrlData parameterForKey:@"missing"]);
+    XCTAssertEqualObjects(generatedUrlData.parameters, (@{@"q" : @"c+d", @"name" : @"\u00e9"}));
+}
+
+- (void)testReverseRouting {
+    FSQRouteContentGenerator *generator = [FSQRouteContentGenerator new];
+    [self.urlRouter registerNativeSchemes:@[@"test"]
+                              forRouteMap:@[@[@"/venues/:venueId/photos/:photoId", generator],
+                                            @[@"/users/*", generator]]];
+    [self.urlRouter registerUniversalLinkHosts:@[@"example.com"] forRouteMap:@[@[@"/users/:userId", generator]]];
+
+    FSQRouteUrlTemplate *template = [self.urlRouter urlTemplateForRoute:@"/venues/:venueId/photos/:photoId" nativeScheme:@"test"];
+    XCTAssertEqualObjects(template.parameterNames, (@[@"venueId", @"photoId"]));
+
+    NSURL *url = [template urlWithParameters:@{@"venueId" : @"a b", @"photoId" : @42, @"ref" : @"share&feed"}];
+    XCTAssertEqualObjects(url.absoluteString, @"test://venues/a%20b/photos/42?ref=share%26feed");
+    XCTAssertEqualObjects([self.urlRouter matchUrls:@[url]].firstObject.urlData.parameters,
+                          (@{@"venueId" : @"a b", @"photoId" : @"42", @"ref" : @"share&feed"}));
+    XCTAssertEqualObjects([template urlWithParameters:@{@"venueId" : @"a/b", @"photoId" : @"1"}].absoluteString,
+                          @"test://venues/a%2Fb/photos/1");
+    XCTAssertNil([template urlWithParameters:@{@"venueId" : @"1"}]);
+
+    FSQRouteUrlTemplate *universalLinkTemplate = [self.urlRouter urlTemplateForRoute:@"/users/:userId" universalLinkHost:@"example.com"];
+    XCTAssertEqualObjects([universalLinkTemplate urlWithParameters:@{@"userId" : @"1"}], [NSURL URLWithString:@"https://example.com/users/1"]);
+
+    // Only registered routes without wildcards can be used as templates
+    XCTAssertNil([self.urlRouter urlTemplateForRoute:@"/venues/:id/photos/:photoId" nativeScheme:@"test"]);
+    XCTAssertNil([self.urlRouter urlTemplateForRoute:@"/users/:userId" nativeScheme:@"test"]);
+    XCTAssertNil([self.urlRouter urlTemplateForRoute:@"/users/*" nativeScheme:@"test"]);
+
+    NSMutableArray<NSDictionary *> *parameterDictionaries = [NSMutableArray new];
+    for (NSUInteger i = 0; i < 1000; i++) {
+        [parameterDictionaries addObject:@{@"venueId" : @(i), @"photoId" : @(i * 2)}];
+    }
+    [parameterDictionaries addObject:@{@"venueId" : @"1"}];
+
+    NSArray *urls = [template urlsWithParameterDictionaries:parameterDictionaries];
+    XCTAssertEqual(urls.count, (NSUInteger)1001);
+    XCTAssertEqualObjects(urls[7], [NSURL URLWithString:@"test://venues/7/photos/14"]);
+    XCTAssertEqualObjects(urls.lastObject, [NSNull null]);
+}
+
+/**
+ Replacing one route's generator in a large map should only copy the trie nodes on that route's path.
+ */
+- (void)testPerformanceReplacingRouteIn1000RouteMap {
+    FSQRouteContentGenerator *generator = [FSQRouteContentGenerator new];
+    NSMutableArray<NSArray *> *routeMap = [NSMutableArray new];
+    for (NSInteger i = 0; i < 1000; i++) {
+        [routeMap addObject:@[[NSString stringWithFormat:@"/section%ld/:itemId", (long)i], generator]];
+    }
+    [self.urlRouter registerNativeSchemes:@[@"test"] forRouteMap:routeMap];
+
+    [self measureBlock:^{
+        for (NSInteger i = 0; i < 100; i++) {
+            XCTAssertTrue([self.urlRouter replaceGeneratorForRoute:@"/section500/:itemId"
+                                                     withGenerator:[FSQRouteContentGenerator new]
+                                                  forNativeSchemes:@[@"test"]]);
+        }
+    }];
+}
+
+/**
+ Unlimited wildcard routes used to backtrack from every occurrence of the next static component, which got very slow
+ on long paths with many repeated components.
+ */
+- (void)testPerformanceUnlimitedWildcardLongPath {
+    NSMutableArray<NSString *> *components = [NSMutableArray new];
+    for (NSInteger i = 0; i < 200; i++) {
+        [components addObject:@"a"];
+    }
+    [components addObjectsFromArray:@[@"c", @"a", @"b"]];
+    NSString *urlString = [@"test://" stringByAppendingString:[components componentsJoinedByString:@"/"]];
+    
+    [self measureBlock:^{
+        for (NSInteger i = 0; i < 100; i++) {
+            NSDictionary<NSString *, NSString *> *result = [self.urlRouter parametersForUrlString:urlString 
+                                                                             matchingAgainstRoute:@"/**/:param/a/b/**"];
+            XCTAssertEqualObjects(result[@"param"], @"c");
+        }
+    }];
+}
+
+/**
+ Matches a url that misses every route in a 500 route map, one route at a time. The url is only parsed once, so this
+ measures the per-route cost of the matcher itself.
+ */
+- (void)testPerformancePerRouteMatchingOn500RouteMap {
+    NSMutableArray<NSString *> *routeStrings = [NSMutableArray new];
+    for (NSInteger i = 0; i < 500; i++) {
+        [routeStrings addObject:[NSString stringWithFormat:@"/venues/:venueId/section%ld/**", (long)i]];
+    }
+    NSArray<NSArray *> *tokenizedRouteMap = [self.urlRouter tokenizedRouteMapForRouteStrings:routeStrings];
+    
+    [self measureBlock:^{
+        for (NSInteger i = 0; i < 100; i++) {
+            NSUInteger numberOfMatches = [self.urlRouter numberOfRoutesInTokenizedRouteMap:tokenizedRouteMap 
+                                                                         matchingUrlString:@"test://venues/123/missing%20section/a/b?foo=bar"];
+            XCTAssertEqual(numberOfMatches, (NSUInteger)0);
+        }
+    }];
+}
+
+/**
+ The baseline for testPerformancePerRouteMatchingOn500RouteMap: the same misses, but with the url parsed again for
+ every route like the matcher used to do. The two should be compared on the same device.
+ */
+- (void)testPerformancePerRouteMatchingOn500RouteMapParsingUrlPerRoute {
+    NSMutableArray<NSString *> *routeStrings = [NSMutableArray new];
+    for (NSInteger i = 0; i < 500; i++) {
+        [routeStrings addObject:[NSString stringWithFormat:@"/venues/:venueId/section%ld/**", (long)i]];
+    }
+    NSArray<NSArray *> *tokenizedRouteMap = [self.urlRouter tokenizedRouteMapForRouteStrings:routeStrings];
+    
+    [self measureBlock:^{
+        for (NSInteger i = 0; i < 100; i++) {
+            NSUInteger numberOfMatches = [self.urlRouter numberOfRoutesInTokenizedRouteMap:tokenizedRouteMap
+                                                                         matchingUrlString:@"test://venues/123/missing%20section/a/b?foo=bar"
+                                                                        parsingUrlPerRoute:YES];
+            XCTAssertEqual(numberOfMatches, (NSUInteger)0);
+        }
+    }];
+}
+
+#pragma mark - FSQRoutingMetricsObserver -
+
+- (void)routingMetrics:(FSQRoutingMetrics *)metrics didEndStage:(FSQRoutingStage)stage {
+    [self.endedRoutingStages addObject:@(stage)];
+}
+
+- (void)routingMetricsDidFinish:(FSQRoutingMetrics *)metrics {
+    self.finishedRoutingMetrics = metrics;
+    [self.finishedRoutingUrls addObject:metrics.url];
+    [self.routingMetricsExpectation fulfill];
+}
 
 /**
  Mandatory delegate callbacks that we don't actually use in tests
@@ -102,6 +1380,7 @@ TEST_URLS_MATCH_AND_PARAMS_MATCH(UnlimitedWildcardMatch15, @"test://a", @"/**/:p
 
 - (FSQUrlRoutingControl)urlRouter:(FSQUrlRouter *)urlRouter 
                shouldPresentRoute:(FSQRouteContent *)routeContent {
+    self.delegateWasCalledOffMainQueue = self.delegateWasCalledOffMainQueue || ![NSThread isMainThread];
     return FSQUrlRouterAllowRouting;
 }
 
@@ -112,6 +1391,7 @@ TEST_URLS_MATCH_AND_PARAMS_MATCH(UnlimitedWildcardMatch15, @"test://a", @"/**/:p
 - (void)urlRouter:(FSQUrlRouter *)urlRouter 
 routedUrlWillBePresented:(FSQRouteContent *)routeContent 
 completionHandler:(void (^)())completionHandler {
+    self.delegateWasCalledOffMainQueue = self.delegateWasCalledOffMainQueue || ![NSThread isMainThread];
     completionHandler();
 }
 
@@ -0,0 +1,228 @@
+//
+//  main.m
+//  fsqroutes-match
+//
+//  Copyright © 2016 Foursquare. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "FSQRouteMatcher.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ Matches urls read from stdin, one per line, against a route map and writes one tab separated line per url to
+ stdout:
+
+     url <TAB> route index <TAB> route string <TAB> parameters
+
+ Parameters are written as name=value pairs joined by "&", sorted by name and percent-encoded. Urls which don't
+ match any route (or can't be parsed) get a route index of -1 and empty route string and parameters.
+
+ usage: fsqroutes-match [-c] [-a] <route map file>
+
+ The route map file has one route string per line, blank lines are skipped. With -c it is compiled route map data
+ instead (see `+[FSQUrlRouter compiledRouteMapDataWithRouteStrings:]`), which doesn't keep the route strings, so
+ that field is left empty.
+
+ With -a no urls are read. Instead the route map is analyzed (see FSQRouteAnalysis) and one line is written per
+ route:
+
+     route index <TAB> route string <TAB> status <TAB> minimum path length <TAB> maximum path length
+
+ The status is "ok", "shadowed:<index>" or "redundant:<index>", where index is the route hiding this one. The
+ maximum path length is -1 for routes with an unlimited wildcard. The exit status is 1 if any route is shadowed.
+ */
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Urls are autoreleased in batches of this many lines rather than one pool per line.
+ */
+static const NSUInteger kFSQLinesPerAutoreleasePool = 1024;
+
+static void FSQPrintUsage(void) {
+    fprintf(stderr, "usage: fsqroutes-match [-c] [-a] <route map file>\n");
+}
+
+static NSArray<NSString *> *_Nullable FSQRouteStringsFromFile(NSString *path) {
+    NSError *error = nil;
+    NSString *contents = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:&error];
+    if (contents == nil) {
+        fprintf(stderr, "fsqroutes-match: could not read %s: %s\n", path.UTF8String, error.localizedDescription.UTF8String);
+        return nil;
+    }
+
+    NSMutableArray<NSString *> *routeStrings = [NSMutableArray new];
+    NSCharacterSet *whitespace = [NSCharacterSet whitespaceAndNewlineCharacterSet];
+    for (NSString *line in [contents componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]]) {
+        NSString *routeString = [line stringByTrimmingCharactersInSet:whitespace];
+        if (routeString.length > 0) {
+            [routeStrings addObject:routeString];
+        }
+    }
+    return routeStrings;
+}
+
+/**
+ @return The number of shadowed routes.
+ */
+static NSUInteger FSQWriteRouteAnalyses(FSQRouteMatcher *matcher) {
+    NSUInteger numberOfShadowedRoutes = 0;
+    for (FSQRouteAnalysis *analysis in [matcher routeAnalyses]) {
+        fprintf(stdout, "%lu\t%s\t", (unsigned long)analysis.routeIndex, analysis.routeString.UTF8String);
+        if (analysis.isShadowed) {
+            fprintf(stdout, "%s:%lu", (analysis.isRedundant ? "redundant" : "shadowed"), (unsigned long)analysis.shadowingRouteIndex);
+            numberOfShadowedRoutes++;
+        }
+        else {
+            fputs("ok", stdout);
+        }
+        fprintf(stdout, "\t%lu\t%ld\n",
+                (unsigned long)analysis.minimumPathLength,
+                (analysis.maximumPathLength != NSUIntegerMax ? (long)analysis.maximumPathLength : -1L));
+    }
+    fflush(stdout);
+    return numberOfShadowedRoutes;
+}
+
+static void FSQWriteParameters(NSDictionary<NSString *, NSString *> *parameters, NSCharacterSet *allowedCharacters) {
+    BOOL isFirstParameter = YES;
+    for (NSString *name in [parameters.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+        NSString *encodedName = [name stringByAddingPercentEncodingWithAllowedCharacters:allowedCharacters];
+        NSString *encodedValue = [parameters[name] stringByAddingPercentEncodingWithAllowedCharacters:allowedCharacters];
+
+        fprintf(stdout, "%s%s=%s", (isFirstParameter ? "" : "&"), encodedName.UTF8String, encodedValue.UTF8String);
+        isFirstParameter = NO;
+    }
+}
+
+int main(int argc, const char *argv[]) {
+    @autoreleasepool {
+        BOOL isCompiledRouteMap = NO;
+        BOOL isAnalyzing = NO;
+        const char *routeMapPath = NULL;
+
+        for (int argumentIndex = 1; argumentIndex < argc; argumentIndex++) {
+            if (strcmp(argv[argumentIndex], "-c") == 0) {
+                isCompiledRouteMap = YES;
+            }
+            else if (strcmp(argv[argumentIndex], "-a") == 0) {
+                isAnalyzing = YES;
+            }
+            else if (routeMapPath == NULL) {
+                routeMapPath = argv[argumentIndex];
+            }
+            else {
+                FSQPrintUsage();
+                return 2;
+            }
+        }
+
+        if (routeMapPath == NULL) {
+            FSQPrintUsage();
+            return 2;
+        }
+
+        NSString *path = [NSString stringWithUTF8String:routeMapPath];
+        NSArray<NSString *> *routeStrings = nil;
+        FSQRouteMatcher *matcher = nil;
+
+        if (isCompiledRouteMap) {
+            NSError *error = nil;
+            NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:&error];
+            if (data != nil) {
+                matcher = [[FSQRouteMatcher alloc] initWithCompiledRouteMapData:data error:&error];
+            }
+            if (matcher == nil) {
+                fprintf(stderr, "fsqroutes-match: could not load %s: %s\n", routeMapPath, error.localizedDescription.UTF8String);
+                return 1;
+            }
+        }
+        else {
+            routeStrings = FSQRouteStringsFromFile(path);
+            if (routeStrings == nil) {
+                return 1;
+            }
+            matcher = [[FSQRouteMatcher alloc] initWithRouteStrings:routeStrings];
+        }
+
+        if (isAnalyzing) {
+            return (FSQWriteRouteAnalyses(matcher) > 0) ? 1 : 0;
+        }
+
+        NSMutableCharacterSet *allowedCharacters = [[NSCharacterSet URLQueryAllowedCharacterSet] mutableCopy];
+        [allowedCharacters removeCharactersInString:@"&=+#"];
+
+        /**
+         Output is fully buffered so each url costs a few memcpys rather than a write.
+         */
+        setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+
+        char *line = NULL;
+        size_t lineCapacity = 0;
+        ssize_t lineLength = 0;
+        NSUInteger numberOfUrls = 0;
+        NSUInteger numberOfMatchedUrls = 0;
+        NSTimeInterval startTime = [NSDate timeIntervalSinceReferenceDate];
+
+        while (lineLength >= 0) {
+            @autoreleasepool {
+                for (NSUInteger lineIndex = 0; lineIndex < kFSQLinesPerAutoreleasePool; lineIndex++) {
+                    lineLength = getline(&line, &lineCapacity, stdin);
+                    if (lineLength < 0) {
+                        break;
+                    }
+
+                    while (lineLength > 0
+                           && (line[lineLength - 1] == '\n' || line[lineLength - 1] == '\r')) {
+                        lineLength--;
+                    }
+                    if (lineLength == 0) {
+                        continue;
+                    }
+
+                    NSString *urlString = [[NSString alloc] initWithBytes:line
+                                                                   length:(NSUInteger)lineLength
+                                                                 encoding:NSUTF8StringEncoding];
+                    NSURL *url = (urlString != nil) ? [NSURL URLWithString:urlString] : nil;
+
+                    NSDictionary<NSString *, NSString *> *parameters = nil;
+                    NSUInteger routeIndex = (url != nil) ? [matcher indexOfRouteMatchingUrl:url parameters:&parameters] : NSNotFound;
+
+                    fwrite(line, 1, (size_t)lineLength, stdout);
+
+                    if (routeIndex != NSNotFound) {
+                        NSString *routeString = (routeIndex < routeStrings.count) ? routeStrings[routeIndex] : @"";
+                        fprintf(stdout, "\t%lu\t%s\t", (unsigned long)routeIndex, routeString.UTF8String);
+                        FSQWriteParameters(parameters ?: @{}, allowedCharacters);
+                        fputc('\n', stdout);
+                        numberOfMatchedUrls++;
+                    }
+                    else {
+                        fputs("\t-1\t\t\n", stdout);
+                    }
+
+                    numberOfUrls++;
+                }
+            }
+        }
+
+        free(line);
+        fflush(stdout);
+
+        NSTimeInterval duration = [NSDate timeIntervalSinceReferenceDate] - startTime;
+        fprintf(stderr, "fsqroutes-match: matched %lu of %lu urls against %lu routes in %.3fs (%.0f urls/s)\n",
+                (unsigned long)numberOfMatchedUrls,
+                (unsigned long)numberOfUrls,
+                (unsigned long)matcher.numberOfRoutes,
+                duration,
+                (duration > 0 ? numberOfUrls / duration : 0));
+    }
+    return 0;
+}
+
+NS_ASSUME_NONNULL_END